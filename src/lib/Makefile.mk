@@ -12,6 +12,7 @@ includesdir = $(pkgincludedir)-@VMAJ@
 src_lib_libxpost_la_SOURCES = \
 src/lib/xpost_array.c \
 src/lib/xpost_compat.c \
+src/lib/xpost_compile.c \
 src/lib/xpost_context.c \
 src/lib/xpost_dev_bgr.c \
 src/lib/xpost_dev_generic.c \
@@ -24,6 +25,7 @@ src/lib/xpost_file.c \
 src/lib/xpost_font.c \
 src/lib/xpost_free.c \
 src/lib/xpost_garbage.c \
+src/lib/xpost_image.c \
 src/lib/xpost_interpreter.c \
 src/lib/xpost_log.c \
 src/lib/xpost_main.c \
@@ -56,6 +58,7 @@ src/lib/xpost_operator.c \
 src/lib/xpost_oplib.c \
 src/lib/xpost_array.h \
 src/lib/xpost_compat.h \
+src/lib/xpost_compile.h \
 src/lib/xpost_dev_bgr.h \
 src/lib/xpost_dev_generic.h \
 src/lib/xpost_dev_jpeg.h \
@@ -67,6 +70,7 @@ src/lib/xpost_file.h \
 src/lib/xpost_font.h \
 src/lib/xpost_free.h \
 src/lib/xpost_garbage.h \
+src/lib/xpost_image.h \
 src/lib/xpost_log.h \
 src/lib/xpost_main.h \
 src/lib/xpost_matrix.h \
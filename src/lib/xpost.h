@@ -211,6 +211,37 @@ typedef enum {
     XPOST_USE_SIZE
 } Xpost_Set_Size;
 
+/**
+ * @def XPOST_STATS_TAGS
+ * @brief The number of allocation tags counted apart in #Xpost_Stats,
+ * one for each type of object. Storage which is not an object's, such
+ * as stacks and tables, is counted with tag 0.
+ */
+#define XPOST_STATS_TAGS 17
+
+/**
+ * @typedef Xpost_Stats
+ * @brief Running totals of the allocations and collections of the
+ * local or global virtual memory of a context.
+ */
+typedef struct
+{
+    unsigned long allocs[XPOST_STATS_TAGS]; /**< allocations by tag */
+    unsigned long long bytes[XPOST_STATS_TAGS]; /**< bytes allocated by tag */
+    unsigned long free_list_hits; /**< allocations which re-used free storage */
+    unsigned long free_list_misses; /**< allocations which needed fresh storage */
+    unsigned long nursery_allocs; /**< allocations in the nursery */
+    unsigned long grows; /**< times the memory was grown */
+    unsigned long collections; /**< full collections completed */
+    unsigned long minor_collections; /**< collections of the nursery */
+    unsigned long long mark_us; /**< microseconds spent marking */
+    unsigned long long sweep_us; /**< microseconds spent sweeping and compacting */
+    unsigned long long minor_us; /**< microseconds spent collecting the nursery */
+    unsigned long long reclaimed; /**< bytes reclaimed by all collections */
+    unsigned int used; /**< bytes in use now */
+    unsigned int max; /**< bytes available now */
+} Xpost_Stats;
+
 /**
  * @typedef Xpost_Output_Message
  * @brief Specify the kind of messages that the interpreter displays to output.
@@ -335,6 +366,23 @@ XPAPI int xpost_run(Xpost_Context *ctx,
  */
 XPAPI void xpost_destroy(Xpost_Context *ctx);
 
+/**
+ * @brief Retrieve the allocation statistics of a context.
+ *
+ * @param ctx The context to use.
+ * @param global Whether to retrieve those of global instead of local vm.
+ * @param stats The structure to fill.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function fills @p stats with the running totals of the
+ * allocations and collections in the local, or if @p global is non
+ * zero the global, virtual memory of @p ctx since it was created.
+ * The same figures are returned by the `.vmstatus` operator.
+ *
+ * @see xpost_create()
+ */
+XPAPI int xpost_stats_get(Xpost_Context *ctx, int global, Xpost_Stats *stats);
+
 /**
  * @brief Set quality value for compression of JPEG files.
  *
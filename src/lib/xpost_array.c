@@ -50,6 +50,7 @@
 #include "xpost_context.h"
 //#include "xpost_interpreter.h"  /* banked arrays may be in global or local mfiles */
 #include "xpost_error.h"  /* array functions may throw errors */
+#include "xpost_garbage.h"  /* stores are seen by incremental marking */
 #include "xpost_array.h"  /* double-check prototypes */
 
 
@@ -94,7 +95,8 @@ Xpost_Object xpost_array_cons_memory(Xpost_Memory_File *mem,
         xpost_memory_table_get_addr(mem,
                                     XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
         cnt = xpost_stack_count(mem, vs);
-        tab->tab[rent].mark = ( (0 << XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET)
+        xpost_memory_table_entry(tab, rent)->mark = ( (xpost_memory_table_entry(tab, rent)->mark
+                & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK) /* keep the allocator's mark */
                 | (0 << XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET)
                 | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET)
                 | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET) );
@@ -149,8 +151,8 @@ Xpost_Object xpost_array_cons(Xpost_Context *ctx,
   Put object into array with given memory file.
   (Array must be valid for this memory file)
 
-  Copy if necessary for save/restore,
-   call memory_put.
+  Copy if necessary for save/restore (just the page
+   being changed, for a large array), call memory_put.
 */
 int xpost_array_put_memory(Xpost_Memory_File *mem,
                            Xpost_Object a,
@@ -159,7 +161,8 @@ int xpost_array_put_memory(Xpost_Memory_File *mem,
 {
     int ret;
     if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(a)))
-        if (!xpost_save_save_ent(mem, arraytype, a.comp_.sz, xpost_object_get_ent(a)))
+        if (!xpost_save_save_page(mem, arraytype, a.comp_.sz, xpost_object_get_ent(a),
+                    (unsigned int)(a.comp_.off + i) * (unsigned int)sizeof(Xpost_Object)))
             return VMerror;
     if (i > a.comp_.sz)
     {
@@ -167,11 +170,17 @@ int xpost_array_put_memory(Xpost_Memory_File *mem,
         /*breakhere((Xpost_Context *)mem);*/
         return rangecheck;
     }
+    if (mem->marking)
+        xpost_garbage_shade(mem, o);
+    if (mem->nursery_limit)
+        xpost_garbage_remember(mem, xpost_object_get_ent(a), o);
     ret = xpost_memory_put(mem, xpost_object_get_ent(a),
                            (unsigned int)(a.comp_.off + i),
                            (unsigned int)sizeof(Xpost_Object), &o);
     if (!ret)
         return VMerror;
+    xpost_memory_discard_code(mem, xpost_object_get_ent(a),
+                              xpost_object_get_ent(a) + 1);
     return 0;
 }
 
@@ -195,6 +204,8 @@ int xpost_array_put(Xpost_Context *ctx,
             return invalidaccess;
     }
 
+    if (mem == ctx->gl && ctx->lo->nursery_limit)
+        (void) xpost_garbage_promote(ctx->lo, o);
     return xpost_array_put_memory(mem, a, i, o);
 }
 
@@ -126,6 +126,14 @@ long long xpost_get_realtime_ms(void);
  */
 long long xpost_get_usertime_ms(void);
 
+/**
+ * @brief return the number of microseconds since the Postscript
+ * interpreter has started.
+ *
+ * @return The number of microseconds.
+ */
+long long xpost_get_usertime_us(void);
+
 int xpost_isatty(int fd);
 
 /**
@@ -174,6 +174,30 @@ xpost_get_usertime_ms(void)
 #endif
 }
 
+long long
+xpost_get_usertime_us(void)
+{
+#if defined(__APPLE__) && defined(__MACH__)
+    return  (long long)(mach_absolute_time() - _xpost_time_start) / 1000LL;
+#elif HAVE_CLOCK_GETTIME
+    struct timespec t;
+
+    if (!clock_gettime(_xpost_time_clock_id, &t))
+        return (long long)(t.tv_sec - _xpost_time_start.tv_sec) * 1000000LL + (long long)(t.tv_nsec - _xpost_time_start.tv_nsec) / 1000LL;
+    /* very unlikely */
+    else
+        return 0;
+#else
+    time_t t;
+
+    t = time(NULL);
+    if (t == ((time_t) -1))
+        return 0;
+
+    return (t - _xpost_time_start) * 1000000LL;
+#endif
+}
+
 int
 xpost_mkstemp(char *template, int *fd)
 {
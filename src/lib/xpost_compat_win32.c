@@ -148,6 +148,15 @@ xpost_get_usertime_ms(void)
     return ((count.QuadPart - _xpost_time_start) * 1000LL) / _xpost_time_freq;
 }
 
+long long
+xpost_get_usertime_us(void)
+{
+    LARGE_INTEGER count;
+
+    QueryPerformanceCounter(&count);
+    return ((count.QuadPart - _xpost_time_start) * 1000000LL) / _xpost_time_freq;
+}
+
 int
 xpost_mkstemp(char *template, int *fd)
 {
@@ -0,0 +1,162 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h> /* malloc realloc free */
+#include <string.h>
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_memory.h"  /* code is kept per ent of the memory file */
+#include "xpost_object.h"  /* procedures are arrays of objects */
+#include "xpost_context.h"
+#include "xpost_array.h"  /* read the elements */
+#include "xpost_compile.h"  /* double-check prototypes */
+
+/* the instruction for an element, as the interpreter would execute it
+   after evalarray() took it out of the array */
+static
+Xpost_Compile_Opcode _xpost_compile_opcode(Xpost_Object o)
+{
+    if (xpost_object_get_type(o) == arraytype || !xpost_object_is_exe(o))
+        return XPOST_COMPILE_PUSH;
+    switch (xpost_object_get_type(o))
+    {
+        case operatortype:
+            /* currentobject is made again from the operator number */
+            return o.tag == operatortype ? XPOST_COMPILE_OPERATOR : XPOST_COMPILE_EXEC;
+        case nametype:
+            return XPOST_COMPILE_LOAD;
+        case nulltype:
+            return XPOST_COMPILE_NOP;
+        case marktype:
+        case integertype:
+        case realtype:
+        case dicttype:
+        case savetype:
+        case booleantype:
+        case contexttype:
+        case globtype:
+            return XPOST_COMPILE_PUSH;
+        default: /* string, file, and the ones which quit */
+            return XPOST_COMPILE_EXEC;
+    }
+}
+
+/* make room in mem->code for ent */
+static
+int _xpost_compile_reserve(Xpost_Memory_File *mem,
+                           unsigned int ent)
+{
+    void **tmp;
+    unsigned int max;
+
+    if (ent < mem->code_max)
+        return 1;
+    max = mem->code_max ? mem->code_max : 1024;
+    while (max <= ent)
+        max *= 2;
+    tmp = realloc(mem->code, max * sizeof *tmp);
+    if (!tmp)
+    {
+        XPOST_LOG_ERR("cannot grow code table");
+        return 0;
+    }
+    memset(tmp + mem->code_max, 0, (max - mem->code_max) * sizeof *tmp);
+    mem->code = tmp;
+    mem->code_max = max;
+    return 1;
+}
+
+int xpost_compile_proc(Xpost_Context *ctx,
+                       Xpost_Object proc)
+{
+    Xpost_Memory_File *mem;
+    Xpost_Compile_Code *code;
+    Xpost_Compile_Opcode op;
+    Xpost_Object o;
+    unsigned int ent;
+    unsigned int nlit;
+    unsigned int i;
+
+    if (xpost_object_get_type(proc) != arraytype || !proc.comp_.sz)
+        return 0;
+    mem = xpost_context_select_memory(ctx, proc);
+    ent = xpost_object_get_ent(proc);
+    if (!_xpost_compile_reserve(mem, ent))
+        return 0;
+
+    for (i = nlit = 0; i < proc.comp_.sz; i++)
+    {
+        op = _xpost_compile_opcode(xpost_array_get_memory(mem, proc, i));
+        if (op != XPOST_COMPILE_OPERATOR && op != XPOST_COMPILE_NOP)
+            ++nlit;
+    }
+
+    /* the pool first, so it is aligned for the objects */
+    code = malloc(sizeof *code + nlit * sizeof *code->lit + proc.comp_.sz * sizeof *code->insn);
+    if (!code)
+    {
+        XPOST_LOG_ERR("cannot allocate code of %u elements", proc.comp_.sz);
+        return 0;
+    }
+    code->off = proc.comp_.off;
+    code->sz = proc.comp_.sz;
+    code->lit = (Xpost_Object *)(code + 1);
+    code->insn = (unsigned int *)(code->lit + nlit);
+
+    for (i = code->nlit = 0; i < proc.comp_.sz; i++)
+    {
+        o = xpost_array_get_memory(mem, proc, i);
+        op = _xpost_compile_opcode(o);
+        switch (op)
+        {
+            case XPOST_COMPILE_OPERATOR:
+                code->insn[i] = XPOST_COMPILE_INSN(op, o.mark_.padw);
+                break;
+            case XPOST_COMPILE_NOP:
+                code->insn[i] = XPOST_COMPILE_INSN(op, 0);
+                break;
+            default:
+                code->lit[code->nlit] = o;
+                code->insn[i] = XPOST_COMPILE_INSN(op, code->nlit++);
+        }
+    }
+    assert(code->nlit == nlit);
+
+    xpost_memory_discard_code(mem, ent, ent + 1);
+    mem->code[ent] = code;
+    return 1;
+}
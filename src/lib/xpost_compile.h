@@ -0,0 +1,127 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef XPOST_COMPILE_H
+#define XPOST_COMPILE_H
+
+/**
+ * @file xpost_compile.h
+ * @brief compiled procedures
+ *
+ * `bind` and `.compile` translate a procedure into a compact form
+ * held in C memory beside its memory file, in mem->code indexed by
+ * the ent of the array: one instruction per element, each an opcode
+ * with an operator number or an index into a pool of the objects
+ * to push, load or execute.
+ *
+ * The array itself is not changed. The interpreter runs a procedure
+ * from its object on the exec stack, whose off and sz serve as the
+ * program counter, and takes the instruction from the code instead of
+ * fetching the element. If there is no code, the elements are
+ * executed as before. Any store into the array, a restore of it, or
+ * freeing its ent discards the code with xpost_memory_discard_code().
+ *
+ * @{
+ */
+
+/**
+ * @brief the opcodes of compiled procedures.
+ */
+typedef enum
+{
+    XPOST_COMPILE_PUSH,     /**< push lit[arg] on the operand stack */
+    XPOST_COMPILE_OPERATOR, /**< execute operator number arg */
+    XPOST_COMPILE_LOAD,     /**< look up the name lit[arg], and execute or push its value */
+    XPOST_COMPILE_EXEC,     /**< push lit[arg] on the exec stack */
+    XPOST_COMPILE_NOP       /**< an executable null does nothing */
+} Xpost_Compile_Opcode;
+
+#define XPOST_COMPILE_OPCODE_BITS 3
+
+#define XPOST_COMPILE_INSN(op, arg) \
+    ((unsigned int)(arg) << XPOST_COMPILE_OPCODE_BITS | (unsigned int)(op))
+#define XPOST_COMPILE_INSN_OPCODE(insn) \
+    ((insn) & ((1U << XPOST_COMPILE_OPCODE_BITS) - 1))
+#define XPOST_COMPILE_INSN_ARG(insn) \
+    ((insn) >> XPOST_COMPILE_OPCODE_BITS)
+
+/**
+ * @struct Xpost_Compile_Code
+ * @brief the code of a procedure, allocated in one block.
+ */
+typedef struct
+{
+    unsigned int off; /**< first element of the array which was compiled */
+    unsigned int sz; /**< number of elements, one instruction each */
+    unsigned int nlit; /**< number of objects in lit */
+    unsigned int *insn; /**< the instructions */
+    Xpost_Object *lit; /**< the objects used by the instructions */
+} Xpost_Compile_Code;
+
+/**
+ * @brief compile the procedure proc.
+ *
+ * Any code compiled before from the same array is replaced.
+ * returns 1 on success, 0 if proc is empty, not an array or the code
+ * cannot be allocated. The procedure still runs without its code.
+ */
+int xpost_compile_proc(Xpost_Context *ctx, Xpost_Object proc);
+
+/**
+ * @brief return the code to run the procedure a, which is the
+ * array in mem or a frame of it on the exec stack, or NULL.
+ *
+ * The code of a frame is that of its array if the frame is a
+ * non-empty tail of the elements which were compiled; the next
+ * instruction is insn[a.comp_.off - code->off].
+ */
+static inline
+const Xpost_Compile_Code *xpost_compile_get(Xpost_Memory_File *mem, Xpost_Object a)
+{
+    /* xpost_object_get_ent(), without the call, as a is an array */
+    unsigned int ent = (unsigned int)a.comp_.ent +
+        ((unsigned int)(a.comp_.tag >> XPOST_OBJECT_TAG_DATA_EXTRA_BITS) << (8*sizeof(word)));
+    const Xpost_Compile_Code *code;
+
+    if (ent >= mem->code_max || !(code = mem->code[ent]))
+        return NULL;
+    if (!a.comp_.sz
+        || a.comp_.off < code->off
+        || (unsigned int)a.comp_.off + a.comp_.sz != code->off + code->sz)
+        return NULL;
+    return code;
+}
+
+/**
+ * @}
+ */
+
+#endif
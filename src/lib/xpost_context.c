@@ -69,7 +69,7 @@ int xpost_context_init_ctxlist(Xpost_Memory_File *mem)
     }
     assert(ent == XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST);
     tab = &mem->table;
-    memset(mem->base + tab->tab[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST].adr, 0,
+    memset(mem->base + xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST)->adr, 0,
            MAXCONTEXT * sizeof(unsigned int));
 
     return 1;
@@ -84,7 +84,7 @@ int xpost_context_append_ctxlist(Xpost_Memory_File *mem,
     unsigned int *ctxlist;
 
     tab = &mem->table;
-    ctxlist = (void *)(mem->base + tab->tab[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST].adr);
+    ctxlist = (void *)(mem->base + xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST)->adr);
     // find first empty
     for (i=0; i < MAXCONTEXT; i++)
     {
@@ -159,6 +159,9 @@ int initglobal(Xpost_Context *ctx,
         return 0;
     }
     xpost_memory_register_garbage_collect_function(ctx->gl, garbage_collect_function);
+    /* collecting global vm traverses all of local vm too, so do it rarely */
+    ctx->gl->threshold_ratio = XPOST_GARBAGE_COLLECTION_GLOBAL_RATIO;
+    ctx->gl->threshold *= ctx->gl->threshold_ratio;
     ret = xpost_save_init(ctx->gl);
     if (!ret)
     {
@@ -238,6 +241,7 @@ int initlocal(Xpost_Context *ctx,
         xpost_memory_file_exit(ctx->lo);
         return 0;
     }
+    ctx->lo->nursery_size = XPOST_MEMORY_NURSERY_SIZE;
 #ifndef XPOST_NO_GC
     xpost_memory_register_garbage_collect_function(ctx->lo, garbage_collect_function);
 #endif
@@ -310,7 +310,7 @@ int _fillpoly(Xpost_Context *ctx,
 {
     Xpost_Object colorspace;
     int ncomp;
-    Xpost_Object comp1, comp2, comp3;
+    Xpost_Object comp[3]; /* comp1 (comp2 comp3)? */
     int numlines;
     /* Xpost_Object x1, y1, x2, y2; */
     Xpost_Object drawline;
@@ -330,20 +330,18 @@ int _fillpoly(Xpost_Context *ctx,
     if (xpost_dict_compare_objects(ctx, colorspace, nameDeviceGray) == 0)
     {
         ncomp = 1;
-        comp1 = xpost_stack_pop(ctx->lo, ctx->os);
     }
     else if (xpost_dict_compare_objects(ctx, colorspace, nameDeviceRGB) == 0)
     {
         ncomp = 3;
-        comp3 = xpost_stack_pop(ctx->lo, ctx->os);
-        comp2 = xpost_stack_pop(ctx->lo, ctx->os);
-        comp1 = xpost_stack_pop(ctx->lo, ctx->os);
     }
     else
     {
         XPOST_LOG_ERR("unimplemented device color space");
         return unregistered;
     }
+    if (!xpost_stack_pop_n(ctx->lo, ctx->os, comp, ncomp))
+        return stackunderflow;
 
     /* extract polygon vertices from ps array */
     points = malloc(poly.comp_.sz * sizeof *points);
@@ -423,10 +421,13 @@ int _fillpoly(Xpost_Context *ctx,
     /* arrange ((x1,y1),(x2,y2)) pairs */
     for (i = 0; i < numlines * 2; i += 2)
     {
-        xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons((integer)floor(intersections[i].x)));
-        xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons((integer)floor(intersections[i].y)));
-        xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons((integer)floor(intersections[i+1].x)));
-        xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons((integer)floor(intersections[i+1].y)));
+        Xpost_Object line[4];
+
+        line[0] = xpost_int_cons((integer)floor(intersections[i].x));
+        line[1] = xpost_int_cons((integer)floor(intersections[i].y));
+        line[2] = xpost_int_cons((integer)floor(intersections[i+1].x));
+        line[3] = xpost_int_cons((integer)floor(intersections[i+1].y));
+        xpost_stack_push_n(ctx->lo, ctx->os, line, 4);
     }
 
     /*call the device's DrawLine generically with continuations.
@@ -462,21 +463,9 @@ int _fillpoly(Xpost_Context *ctx,
     /*the loop body finds the 4 coordinate numbers on the stack
      and must roll the color values beneath these numbers on the stack  */
 
-    switch (ncomp)
-    {
-        case 1:
-            xpost_stack_push(ctx->lo, ctx->os, comp1);
-            xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(5)); /* total elements to roll */
-            xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(1)); /* color components to move */
-            break;
-        case 3:
-            xpost_stack_push(ctx->lo, ctx->os, comp1);
-            xpost_stack_push(ctx->lo, ctx->os, comp2);
-            xpost_stack_push(ctx->lo, ctx->os, comp3);
-            xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(7)); /* total elements to roll */
-            xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(3)); /* color components to move */
-            break;
-    }
+    xpost_stack_push_n(ctx->lo, ctx->os, comp, ncomp);
+    xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(4 + ncomp)); /* total elements to roll */
+    xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(ncomp)); /* color components to move */
     xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvx( nameroll));
 
       /*at this point (in constructing the (color-space-generic) loop-body) we have the desired stack picture:
@@ -607,15 +596,8 @@ int _fillrectgray(Xpost_Context *ctx,
 int xpost_oper_init_generic_device_ops(Xpost_Context *ctx,
                                        Xpost_Object sd)
 {
-    unsigned int optadr;
-    Xpost_Operator *optab;
     Xpost_Object n,op;
 
-    xpost_memory_table_get_addr(ctx->gl,
-                                XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE,
-                                &optadr);
-    optab = (Xpost_Operator *)(ctx->gl->base + optadr);
-
     op = xpost_operator_cons(ctx, ".yxsort", (Xpost_Op_Func)_yxsort, 0, 1, arraytype); INSTALL;
     op = xpost_operator_cons(ctx, ".fillpoly", (Xpost_Op_Func)_fillpoly, 0, 2, arraytype, dicttype); INSTALL;
     op = xpost_operator_cons(ctx, ".fillrectgray", (Xpost_Op_Func)_fillrectgray, 0, 6,
@@ -568,8 +568,6 @@ int loadpngdevicecont(Xpost_Context *ctx,
 int xpost_oper_init_png_device_ops(Xpost_Context *ctx,
                                    Xpost_Object sd)
 {
-    unsigned int optadr;
-    Xpost_Operator *optab;
     Xpost_Object n,op;
 
     /* factor-out name lookups from the operators (optimization) */
@@ -586,10 +584,6 @@ int xpost_oper_init_png_device_ops(Xpost_Context *ctx,
     if (xpost_object_get_type((nameDeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
         return VMerror;
 
-    xpost_memory_table_get_addr(ctx->gl,
-                                XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE,
-                                &optadr);
-    optab = (Xpost_Operator *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "loadpngdevice", (Xpost_Op_Func)loadpngdevice, 1, 0); INSTALL;
     op = xpost_operator_cons(ctx, "loadpngdevicecont", (Xpost_Op_Func)loadpngdevicecont, 1, 1, dicttype);
     _loadpngdevicecont_opcode = op.mark_.padw;
@@ -54,6 +54,7 @@
 #include "xpost_string.h"  /* may need string functions (convert to name) */
 #include "xpost_name.h"  /* may need name functions (create name) */
 #include "xpost_file.h"
+#include "xpost_garbage.h"  /* stores are seen by incremental marking */
 #include "xpost_dict.h"  /* double-check prototypes */
 
 
@@ -74,6 +75,8 @@ typedef struct
 } dicrec;
 */
 
+unsigned int xpost_dict_epoch = 1; /* cache entries start at 0 */
+
 /* strict-aliasing compatible poking of double */
 typedef union
 {
@@ -250,7 +253,8 @@ Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
     rent = ent;
     xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
     cnt = xpost_stack_count(mem, vs);
-    tab->tab[rent].mark = ( (0 << XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET)
+    xpost_memory_table_entry(tab, rent)->mark = ( (xpost_memory_table_entry(tab, rent)->mark
+                & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK) /* keep the allocator's mark */
             | (0 << XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET)
             | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET)
             | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET) );
@@ -316,6 +320,97 @@ unsigned int xpost_dict_max_length_memory (Xpost_Memory_File *mem,
     return dp->sz;
 }
 
+/* is d the systemdict at the bottom of the dict stack? */
+static
+int _xpost_dict_is_systemdict(Xpost_Context *ctx,
+                              Xpost_Memory_File *mem,
+                              Xpost_Object d)
+{
+    return mem == ctx->gl
+        && xpost_stack_count(ctx->lo, ctx->ds)
+        && xpost_object_get_ent(xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0))
+               == xpost_object_get_ent(d);
+}
+
+/* note that global name k is a key in a dict other than systemdict */
+static
+void _xpost_dict_shadow_name(Xpost_Memory_File *gl,
+                             Xpost_Object k)
+{
+    if (xpost_object_get_type(k) == nametype
+        && (k.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK)
+        && k.mark_.padw < gl->name_bindings_max)
+        gl->name_bindings[k.mark_.padw] = XPOST_DICT_NAME_SHADOWED;
+}
+
+void xpost_dict_bind_name(Xpost_Context *ctx,
+                          Xpost_Object k,
+                          unsigned int off)
+{
+    Xpost_Memory_File *gl = ctx->gl;
+
+    if (xpost_object_get_type(k) == nametype
+        && (k.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK)
+        && k.mark_.padw < gl->name_bindings_max
+        && gl->name_bindings[k.mark_.padw] != XPOST_DICT_NAME_SHADOWED)
+        gl->name_bindings[k.mark_.padw] = off;
+}
+
+void xpost_dict_unbind_names(Xpost_Memory_File *mem)
+{
+    unsigned int i;
+
+    for (i = 0; i < mem->name_bindings_max; i++)
+        if (mem->name_bindings[i] != XPOST_DICT_NAME_SHADOWED)
+            mem->name_bindings[i] = 0;
+}
+
+void xpost_dict_rebind_names(Xpost_Context *ctx)
+{
+    Xpost_Memory_File *mems[2];
+    unsigned int names;
+    unsigned int i, m, e;
+
+    mems[0] = ctx->gl;
+    mems[1] = ctx->lo;
+    xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &names);
+    (void) xpost_name_reserve_bindings(ctx->gl, xpost_stack_count(ctx->gl, names));
+    for (i = 0; i < ctx->gl->name_bindings_max; i++)
+        ctx->gl->name_bindings[i] = 0;
+
+    for (m = 0; m < 2; m++)
+    {
+        Xpost_Memory_File *mem = mems[m];
+
+        for (e = 0; e < mem->table.nextent; e++)
+        {
+            Xpost_Memory_Table_Entry *te = xpost_memory_table_entry(&mem->table, e);
+            dichead *dp;
+            dicrec *tp;
+            unsigned int sz;
+
+            if (te->tag != dicttype || te->sz < sizeof(dichead)
+                || (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK))
+                continue;
+            if (_xpost_dict_is_systemdict(ctx, mem, xpost_object_set_ent(null, e)))
+                continue;
+            dp = (void *)(mem->base + te->adr);
+            tp = (void *)(mem->base + te->adr + sizeof(dichead));
+            sz = DICTABN(dp->sz);
+            for (i = 0; i < sz; i++)
+                _xpost_dict_shadow_name(ctx->gl, tp[i].key);
+        }
+    }
+}
+
+static
+int _xpost_dict_put_memory(Xpost_Context *ctx,
+        Xpost_Memory_File *mem,
+        Xpost_Object d,
+        Xpost_Object k,
+        Xpost_Object v,
+        int shadow);
+
 /*
    grow a dictionary to a larger size.
 
@@ -357,7 +452,8 @@ int dicgrow(Xpost_Context *ctx,
     {
         if (xpost_object_get_type(tp[i].key) != nulltype)
         {
-            xpost_dict_put_memory(ctx, mem, n, tp[i].key, tp[i].value);
+            /* the keys were noted when they went into d */
+            _xpost_dict_put_memory(ctx, mem, n, tp[i].key, tp[i].value, 0);
         }
     }
 #ifdef DEBUGDIC
@@ -366,25 +462,32 @@ int dicgrow(Xpost_Context *ctx,
 #endif
 
     {   /* exchange entities */
-        Xpost_Memory_Table *tab = &mem->table;
-        unsigned int dent, nent;
+        Xpost_Memory_Table_Entry *de, *ne;
         unsigned int hold;
 
-        dent = xpost_object_get_ent(d);
-        nent = xpost_object_get_ent(n);
+        de = xpost_memory_table_entry(&mem->table, xpost_object_get_ent(d));
+        ne = xpost_memory_table_entry(&mem->table, xpost_object_get_ent(n));
 
         /* exchange adrs */
-        hold = tab->tab[dent].adr;
-               tab->tab[dent].adr = tab->tab[nent].adr;
-                                    tab->tab[nent].adr = hold;
+        hold = de->adr;
+               de->adr = ne->adr;
+                         ne->adr = hold;
 
         /* exchange sizes */
-        hold = tab->tab[dent].sz;
-               tab->tab[dent].sz = tab->tab[nent].sz;
-                                   tab->tab[nent].sz = hold;
+        hold = de->sz;
+               de->sz = ne->sz;
+                        ne->sz = hold;
+        xpost_memory_save_marks_spoil(mem, xpost_object_get_ent(d), de->adr);
+        ++xpost_dict_epoch; /* the keys are in new slots */
+        if (_xpost_dict_is_systemdict(ctx, mem, d))
+            xpost_dict_unbind_names(mem);
+
+        /* the contents may have left the nursery without the objects */
+        if (mem->nursery_limit)
+            xpost_garbage_remember_ent(mem, xpost_object_get_ent(d));
 
 #if 0
-        if (xpost_free_memory_ent(mem, nent) < 0)
+        if (xpost_free_memory_ent(mem, xpost_object_get_ent(n)) < 0)
         {
             XPOST_LOG_ERR("cannot free old dict");
             return 0;
@@ -576,6 +679,28 @@ int xpost_dict_known_key(Xpost_Context *ctx,
     return xpost_object_get_type(r->key) != nulltype;
 }
 
+/*
+   Find the value of key in dict with specified memory file,
+   as an offset from the start of the dict.
+
+   call diclookup,
+   return the offset of the value if the key is non-null
+   or 0 (the dichead is never a value). */
+unsigned int xpost_dict_find_value_offset(Xpost_Context *ctx,
+        /*@dependent@*/ Xpost_Memory_File *mem,
+        Xpost_Object d,
+        Xpost_Object k)
+{
+    dicrec *r;
+    unsigned int ad;
+
+    r = diclookup(ctx, mem, d, k);
+    if (r == NULL || r == invalidrec || xpost_object_get_type(r->key) == nulltype)
+        return 0;
+    xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
+    return (unsigned int)((unsigned char *)&r->value - (mem->base + ad));
+}
+
 /*
    Get value from dict+key with specified memory file
    (dict must be valid for this memory file)
@@ -630,11 +755,13 @@ Xpost_Object xpost_dict_get(Xpost_Context *ctx,
        increase nused,
        set key,
        update value. */
-int xpost_dict_put_memory(Xpost_Context *ctx,
+static
+int _xpost_dict_put_memory(Xpost_Context *ctx,
         Xpost_Memory_File *mem,
         Xpost_Object d,
         Xpost_Object k,
-        Xpost_Object v)
+        Xpost_Object v,
+        int shadow)
 {
     dicrec *r;
     dichead *dp;
@@ -689,20 +816,44 @@ int xpost_dict_put_memory(Xpost_Context *ctx,
         xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
         dp = (void *)(mem->base + ad);
         ++ dp->nused;
+        ++xpost_dict_epoch; /* may shadow the key in a dict below */
         r->key = clean_key(ctx, k);
         r->hash = hash(r->key);
         if (xpost_object_get_type(r->key) == invalidtype)
             return VMerror;
+        if (shadow && !_xpost_dict_is_systemdict(ctx, mem, d))
+            _xpost_dict_shadow_name(ctx->gl, r->key);
+        if (mem->marking)
+            xpost_garbage_shade(mem, r->key);
+        if (mem->nursery_limit)
+            xpost_garbage_remember(mem, xpost_object_get_ent(d), r->key);
+        else if (mem == ctx->gl && ctx->lo->nursery_limit)
+            (void) xpost_garbage_promote(ctx->lo, r->key);
     }
     else if (xpost_object_get_type(r->value) == magictype)
     {
         r->value.magic_.pair->put(ctx, d, k, v);
         return 0;
     }
+    if (mem->marking)
+        xpost_garbage_shade(mem, v);
+    if (mem->nursery_limit)
+        xpost_garbage_remember(mem, xpost_object_get_ent(d), v);
+    else if (mem == ctx->gl && ctx->lo->nursery_limit)
+        (void) xpost_garbage_promote(ctx->lo, v);
     r->value = v;
     return 0;
 }
 
+int xpost_dict_put_memory(Xpost_Context *ctx,
+        Xpost_Memory_File *mem,
+        Xpost_Object d,
+        Xpost_Object k,
+        Xpost_Object v)
+{
+    return _xpost_dict_put_memory(ctx, mem, d, k, v, 1);
+}
+
 /*
    Put key+value in dict.
 
@@ -819,6 +970,10 @@ int xpost_dict_undef_memory(Xpost_Context *ctx,
         }
     }
 
+    ++xpost_dict_epoch; /* the key is gone, and another may move */
+    if (_xpost_dict_is_systemdict(ctx, mem, d))
+        xpost_dict_unbind_names(mem);
+
     if (found) /* f found: move last key and value to slot */
     {
         e->key = tp[last].key;
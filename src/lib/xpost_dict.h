@@ -148,6 +148,50 @@ Xpost_Object xpost_dict_convert_extended_to_number(Xpost_Object e);
  */
 int xpost_dict_known_key(Xpost_Context *ctx, /*@dependent@*/ Xpost_Memory_File *mem, Xpost_Object d, Xpost_Object k);
 
+/**
+   count of the changes which may change the dict, and the slot in it,
+   in which a key is found by searching the dict stack.
+   incremented when a key is added to or removed from a dict,
+   when a dict grows, when dicts are restored and when the
+   dict stack is changed, so lookups cached at one count
+   are good while it stays the same.
+*/
+extern unsigned int xpost_dict_epoch;
+
+/**
+   binding slot of a global name which is a key in a dict other
+   than systemdict, and so may be shadowed on the dict stack.
+   see xpost_name_reserve_bindings().
+*/
+#define XPOST_DICT_NAME_SHADOWED (~0U)
+
+/**
+   bind the global name k to the offset off of its value in systemdict,
+   unless it is shadowed.
+*/
+void xpost_dict_bind_name(Xpost_Context *ctx, Xpost_Object k, unsigned int off);
+
+/**
+   forget the bindings of the names of mem to its systemdict, but not
+   which names are shadowed. for when the slots of systemdict move.
+*/
+void xpost_dict_unbind_names(Xpost_Memory_File *mem);
+
+/**
+   recompute which names are shadowed from all the dicts of
+   global and local vm, for a vm which was not built by
+   xpost_dict_put (a vm image).
+*/
+void xpost_dict_rebind_names(Xpost_Context *ctx);
+
+/**
+   lookup the offset of the value of key in dictionary, from the
+   start of the dictionary's allocation.
+   0 if the key is not found.
+   the offset stays good while xpost_dict_epoch is unchanged.
+*/
+unsigned int xpost_dict_find_value_offset(Xpost_Context *ctx, /*@dependent@*/ Xpost_Memory_File *mem, Xpost_Object d, Xpost_Object k);
+
 /**
    lookup value using key in dictionary
 */
@@ -783,8 +783,8 @@ int xpost_file_get_bytes_available(Xpost_Memory_File *mem,
     return 0;
 }
 
-/* close the file,
-   NULL the FILE*. */
+/* close the file, free the Xpost_File
+   and NULL the pointer in VM. */
 int xpost_file_object_close(Xpost_Memory_File *mem,
                             Xpost_Object f)
 {
@@ -799,6 +799,7 @@ int xpost_file_object_close(Xpost_Memory_File *mem,
 #endif
 
         xpost_file_close(fp);
+        free(fp);
         fp = NULL;
         ret = xpost_memory_put(mem, f.mark_.padw, 0, sizeof fp, &fp);
         if (!ret)
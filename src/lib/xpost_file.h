@@ -190,6 +190,8 @@ int xpost_file_get_bytes_available(Xpost_Memory_File *mem, Xpost_Object f, int *
 
 /**
  * @brief Close the file and deallocate the descriptor in VM.
+ *
+ * Also used by the garbage collector to finalize unreachable files.
  */
 int xpost_file_object_close(Xpost_Memory_File *mem, Xpost_Object f);
 
@@ -35,14 +35,44 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h> /* realloc */
 #include <string.h>
 
 #include "xpost.h"
 #include "xpost_log.h"
+#include "xpost_compat.h" /* xpost_get_usertime_us */
 #include "xpost_memory.h" /* Xpost_Memory_File */
 #include "xpost_object.h" /* Xpost_Object */
 #include "xpost_free.h"
 
+/* slot of the chain of ents without storage in the free list head */
+#define XPOST_FREE_EMPTY (XPOST_FREE_BINS + 1)
+
+/* read a 32bit link from vm */
+static
+unsigned int _xpost_free_get_link(Xpost_Memory_File *mem, unsigned int adr)
+{
+    unsigned int link;
+    memcpy(&link, mem->base + adr, sizeof link);
+    return link;
+}
+
+/* write a 32bit link to vm */
+static
+void _xpost_free_set_link(Xpost_Memory_File *mem, unsigned int adr, unsigned int link)
+{
+    memcpy(mem->base + adr, &link, sizeof link);
+}
+
+/* select the small bin for an allocation of sz bytes,
+   or XPOST_FREE_TREE if it belongs in the large-object tree */
+static
+unsigned int _xpost_free_bin(unsigned int sz)
+{
+    unsigned int bin = (sz - 1) / XPOST_FREE_BIN_GRAIN;
+    return bin < XPOST_FREE_BINS ? bin : XPOST_FREE_TREE;
+}
+
 /*
    initialize the free-list in the memory file.
    free list head is in slot zero
@@ -50,11 +80,10 @@
 int xpost_free_init(Xpost_Memory_File *mem)
 {
     unsigned int ent;
-    unsigned int val = 0;
     int ret;
 
-    /* allocate the free list head: 4 bytes in ent 0
-       allocate additional 1k "scratch" space to protect
+    /* allocate the free list head: bin heads and tree root in ent 0
+       the rest of the 1k is "scratch" space to protect
        interpreter data from NULL writes
      */
     ret = xpost_memory_table_alloc(mem, 1024, 0, &ent);
@@ -66,8 +95,8 @@ int xpost_free_init(Xpost_Memory_File *mem)
     /* make sure this is the correct ent */
     assert (ent == XPOST_MEMORY_TABLE_SPECIAL_FREE);
 
-    /* set to zero (== NULL == link-back-to-head) */
-    ret = xpost_memory_put(mem, ent, 0, sizeof(unsigned int), &val);
+    /* set all heads to zero (== NULL) */
+    ret = xpost_free_discard(mem);
     if (!ret)
     {
         XPOST_LOG_ERR("xpost_free_init cannot access list head");
@@ -77,26 +106,223 @@ int xpost_free_init(Xpost_Memory_File *mem)
     /* set zero size to enable guards against NULL writes */
     {
         Xpost_Memory_Table *tab = &mem->table;
-        tab->tab[XPOST_MEMORY_TABLE_SPECIAL_FREE].sz = 0;
+        xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_FREE)->sz = 0;
     }
 
     /* make free list available for general memory allocations */
     (void) xpost_memory_register_free_list_alloc_function(mem, xpost_free_alloc);
-    mem->period = XPOST_GARBAGE_COLLECTION_PERIOD;
-    mem->threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
+    mem->allocated = 0;
+    mem->vmthreshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
+    mem->threshold = mem->vmthreshold;
+    mem->reclaim_disabled = 0;
+    mem->threshold_ratio = 1;
+    mem->sweep = 0;
+    mem->sweep_limit = 0;
+    mem->marking = 0;
+    mem->mark_budget = 0;
+    mem->nursery_size = 0;
+    mem->nursery_base = 0;
+    mem->nursery_top = 0;
+    mem->nursery_limit = 0;
+    mem->nyoung = 0;
+    mem->nremembered = 0;
+    mem->nfinalize = 0;
+    memset(&mem->gc, 0, sizeof mem->gc);
+    mem->gc.scale = XPOST_GARBAGE_COLLECTION_SCALE;
+
+    return 1;
+}
+
+/* empty all bins and the large-object tree */
+int xpost_free_discard(Xpost_Memory_File *mem)
+{
+    unsigned int z;
+    int ret;
+
+    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("unable to load free list head");
+        return 0;
+    }
+    memset(mem->base + z, 0, (XPOST_FREE_TREE + 1) * sizeof(unsigned int));
+    return 1;
+}
+
+/* put an ent whose storage is gone on the chain of empty ents,
+   linked through the adr field */
+int xpost_free_release_ent(Xpost_Memory_File *mem,
+                           unsigned int ent)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int z;
+    int ret;
+
+    if (ent < mem->start)
+        return 0;
+
+    if (ent >= tab->nextent)
+    {
+        XPOST_LOG_ERR("cannot release ent %u", ent);
+        return 0;
+    }
+    xpost_memory_discard_code(mem, ent, ent + 1);
+
+    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("unable to load free list head");
+        return 0;
+    }
+    z += XPOST_FREE_EMPTY * sizeof(unsigned int);
 
+    xpost_memory_table_entry(tab, ent)->adr = _xpost_free_get_link(mem, z);
+    xpost_memory_table_entry(tab, ent)->sz = 0;
+    xpost_memory_table_entry(tab, ent)->tag = 0;
+    _xpost_free_set_link(mem, z, ent);
     return 1;
 }
 
+/* take an ent off the chain of empty ents,
+   returns the ent or 0 if there are none */
+static
+unsigned int _xpost_free_take_empty(Xpost_Memory_File *mem,
+                                    unsigned int z)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int link = z + XPOST_FREE_EMPTY * sizeof(unsigned int);
+    unsigned int e;
+
+    e = _xpost_free_get_link(mem, link);
+    if (!e || e >= tab->nextent)
+        return 0;
+    _xpost_free_set_link(mem, link, xpost_memory_table_entry(tab, e)->adr);
+    return e;
+}
+
+/* take an ent off the chain of empty ents and give it fresh storage,
+   returns the ent or 0 if there are none */
+static
+unsigned int _xpost_free_alloc_empty(Xpost_Memory_File *mem,
+                                     unsigned int z,
+                                     unsigned int sz)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int e;
+    unsigned int adr;
+
+    e = _xpost_free_take_empty(mem, z);
+    if (!e)
+        return 0;
+
+    if (!xpost_memory_file_alloc(mem, sz, &adr))
+    {
+        XPOST_LOG_ERR("unable to allocate entity data storage");
+        (void) xpost_free_release_ent(mem, e);
+        return 0;
+    }
+    xpost_memory_table_entry(tab, e)->adr = adr;
+    xpost_memory_table_entry(tab, e)->sz = sz;
+    xpost_memory_table_entry(tab, e)->mark = 0;
+    xpost_memory_save_marks_spoil(mem, e, adr);
+    return e;
+}
+
+/* insert ent into the large-object tree.
+   an ent of a size already in the tree goes on the list of that node */
+static
+void _xpost_free_tree_insert(Xpost_Memory_File *mem,
+                             unsigned int link,
+                             unsigned int ent)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int sz = xpost_memory_table_entry(tab, ent)->sz;
+    unsigned int adr = xpost_memory_table_entry(tab, ent)->adr;
+    unsigned int t;
+    unsigned int tsz;
+
+    while ((t = _xpost_free_get_link(mem, link)) != 0)
+    {
+        tsz = xpost_memory_table_entry(tab, t)->sz;
+        link = xpost_memory_table_entry(tab, t)->adr;
+        if (sz == tsz)
+        {
+            link += XPOST_FREE_TREE_SAME;
+            _xpost_free_set_link(mem, adr + XPOST_FREE_TREE_SAME, _xpost_free_get_link(mem, link));
+            _xpost_free_set_link(mem, link, ent);
+            return;
+        }
+        link += sz < tsz ? XPOST_FREE_TREE_LEFT : XPOST_FREE_TREE_RIGHT;
+    }
+    _xpost_free_set_link(mem, adr + XPOST_FREE_TREE_LEFT, 0);
+    _xpost_free_set_link(mem, adr + XPOST_FREE_TREE_RIGHT, 0);
+    _xpost_free_set_link(mem, adr + XPOST_FREE_TREE_SAME, 0);
+    _xpost_free_set_link(mem, link, ent);
+}
+
+/* take an ent of the node found at link out of the large-object tree.
+   the node stays if there are others of its size on its list,
+   otherwise it is unlinked. returns the ent */
+static
+unsigned int _xpost_free_tree_take(Xpost_Memory_File *mem,
+                                   unsigned int link)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int n = _xpost_free_get_link(mem, link);
+    unsigned int nadr = xpost_memory_table_entry(tab, n)->adr;
+    unsigned int same = _xpost_free_get_link(mem, nadr + XPOST_FREE_TREE_SAME);
+    unsigned int left;
+    unsigned int right;
+    unsigned int mlink;
+    unsigned int m;
+
+    if (same)
+    {
+        _xpost_free_set_link(mem, nadr + XPOST_FREE_TREE_SAME,
+                _xpost_free_get_link(mem, xpost_memory_table_entry(tab, same)->adr + XPOST_FREE_TREE_SAME));
+        return same;
+    }
+
+    left = _xpost_free_get_link(mem, nadr + XPOST_FREE_TREE_LEFT);
+    right = _xpost_free_get_link(mem, nadr + XPOST_FREE_TREE_RIGHT);
+    if (!left)
+    {
+        _xpost_free_set_link(mem, link, right);
+        return n;
+    }
+    if (!right)
+    {
+        _xpost_free_set_link(mem, link, left);
+        return n;
+    }
+
+    /* replace n with its successor, the leftmost node of the right subtree */
+    mlink = nadr + XPOST_FREE_TREE_RIGHT;
+    m = right;
+    while (_xpost_free_get_link(mem, xpost_memory_table_entry(tab, m)->adr + XPOST_FREE_TREE_LEFT))
+    {
+        mlink = xpost_memory_table_entry(tab, m)->adr + XPOST_FREE_TREE_LEFT;
+        m = _xpost_free_get_link(mem, mlink);
+    }
+    _xpost_free_set_link(mem, mlink,
+            _xpost_free_get_link(mem, xpost_memory_table_entry(tab, m)->adr + XPOST_FREE_TREE_RIGHT));
+    _xpost_free_set_link(mem, xpost_memory_table_entry(tab, m)->adr + XPOST_FREE_TREE_LEFT, left);
+    _xpost_free_set_link(mem, xpost_memory_table_entry(tab, m)->adr + XPOST_FREE_TREE_RIGHT,
+            _xpost_free_get_link(mem, nadr + XPOST_FREE_TREE_RIGHT));
+    _xpost_free_set_link(mem, link, m);
+    return n;
+}
+
 /* free this ent! returns reclaimed size or -1 on error */
 int xpost_free_memory_ent(Xpost_Memory_File *mem,
                           unsigned int ent)
 {
     Xpost_Memory_Table *tab;
     unsigned int rent = ent; /* relative ent index */
-    unsigned int z; /* free list pointer */
+    unsigned int z; /* free list head */
     unsigned int a; /* adr associated with ent */
     unsigned int sz; /* sz associated with adr */
+    unsigned int bin;
     int ret;
     /* return; */
 
@@ -108,43 +334,21 @@ int xpost_free_memory_ent(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot free ent %u", ent);
         return -1;
     }
+    xpost_memory_discard_code(mem, ent, ent + 1);
     tab = &mem->table;
-    a = tab->tab[rent].adr;
-    sz = tab->tab[rent].sz;
+    a = xpost_memory_table_entry(tab, rent)->adr;
+    sz = xpost_memory_table_entry(tab, rent)->sz;
     if (sz == 0) return 0; /* do not add zero-size allocations to list */
-
-    if (tab->tab[rent].tag == filetype)
+    if (xpost_memory_table_entry(tab, rent)->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK)
+        return 0; /* already on the list */
+    if (XPOST_MEMORY_IS_YOUNG(mem, a))
     {
-        FILE *fp;
-        ret = xpost_memory_get(mem, ent, 0, sizeof(FILE *), &fp);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot load FILE* from VM");
-            return -1;
-        }
-        if (fp &&
-            fp != stdin &&
-            fp != stdout &&
-            fp != stderr)
-        {
-            tab->tab[rent].tag = 0;
-#ifdef DEBUG_FILE
-            printf("gc:xpost_free_memory_ent closing FILE* %p\n", fp);
-            fflush(stdout);
-            /* if (fp < 0x1000) return 0; */
-            printf("fclose");
-#endif
-            fclose(fp);
-            fp = NULL;
-            ret = xpost_memory_put(mem, ent, 0, sizeof(FILE *), &fp);
-            if (!ret)
-            {
-                XPOST_LOG_ERR("cannot write NULL over FILE* in VM");
-                return -1;
-            }
-        }
+        /* nursery storage is reclaimed by the next minor collection */
+        (void) xpost_free_release_ent(mem, ent);
+        return sz;
     }
-    tab->tab[rent].tag = 0;
+
+    xpost_memory_table_entry(tab, rent)->tag = 0;
 
     ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z);
     if (!ret)
@@ -154,52 +358,113 @@ int xpost_free_memory_ent(Xpost_Memory_File *mem,
     }
     /* printf("freeing %d bytes\n", xpost_memory_table_get_size(mem, ent)); */
 
-    //while current node < size of ent being added
-        //load next ent in list
-    while (1)
+    bin = _xpost_free_bin(sz);
+    z += bin * sizeof(unsigned int);
+    if (bin == XPOST_FREE_TREE)
     {
-        unsigned int t;
-        unsigned int ta;
-        unsigned int tsz;
-
-        /* get the next ent from z node */
-        memcpy(&t, mem->base + z, sizeof(unsigned int));
+        _xpost_free_tree_insert(mem, z, ent);
+    }
+    else
+    {
+        /* push the ent on the front of its bin */
+        memcpy(mem->base + a, mem->base + z, sizeof(unsigned int));
+        memcpy(mem->base + z, &ent, sizeof(unsigned int));
+    }
+    xpost_memory_table_entry(tab, rent)->mark |= XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK;
 
-        if (t == 0) /* end of the list */
-            break;
+    return sz;
+}
 
-        ret = xpost_memory_table_get_size(mem, t, &tsz);
-        if (!ret)
+/* queue an unreachable file ent to be closed when the sweep is done.
+   returns 1 on success, 0 if the queue cannot grow */
+static
+int _xpost_free_finalize_add(Xpost_Memory_File *mem,
+                             unsigned int ent)
+{
+    if (mem->nfinalize == mem->finalize_max)
+    {
+        unsigned int max = mem->finalize_max ? mem->finalize_max * 2 : 64;
+        unsigned int *tmp = realloc(mem->finalize, max * sizeof *tmp);
+        if (!tmp)
         {
-            XPOST_LOG_ERR("cannot get size from ent on free list");
-            return -1;
+            XPOST_LOG_ERR("cannot grow finalization queue to %u entries", max);
+            return 0;
         }
+        mem->finalize = tmp;
+        mem->finalize_max = max;
+    }
+    mem->finalize[mem->nfinalize++] = ent;
+    return 1;
+}
 
-        if (tsz > sz) /* this is the place */
-            break;
+/* continue the sweep which follows a collection.
+   examine up to count ents from mem->sweep,
+        if element is unmarked and not zero-sized,
+            free it and add its size to reclaimed.
+        otherwise add its size to live.
+   unmarked files are queued for finalization instead,
+   and marked so they are not queued twice.
+   ents already on the free list are passed over.
+   returns 1 if the sweep is complete */
+int xpost_free_sweep(Xpost_Memory_File *mem,
+                     unsigned int count)
+{
+    Xpost_Memory_Table_Entry *te;
+    long long t;
+    unsigned int i;
+    int ret;
 
-        ret = xpost_memory_table_get_addr(mem, t, &ta);
-        if (!ret)
+    t = xpost_get_usertime_us();
+    for ( ; count && mem->sweep < mem->sweep_limit; count--)
+    {
+        i = mem->sweep++;
+        te = xpost_memory_table_entry(&mem->table, i);
+        if (te->sz == 0 || (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK))
+            continue;
+        if (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK)
         {
-            XPOST_LOG_ERR("cannot get addr from ent on free list");
-            return -1;
+            mem->gc.live += te->sz;
+            continue;
         }
-
-        z = ta;
+        if (te->tag == filetype)
+        {
+            if (_xpost_free_finalize_add(mem, i))
+                te->mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+            else
+                mem->gc.live += te->sz; /* leave it open */
+            continue;
+        }
+        ret = xpost_free_memory_ent(mem, i);
+        if (ret < 0)
+        {
+            XPOST_LOG_ERR("cannot free ent %u", i);
+            continue;
+        }
+        mem->gc.reclaimed += (unsigned int)ret;
     }
+    mem->stats.sweep_us += xpost_get_usertime_us() - t;
 
-    /* copy the current free-list node to the data area of the ent. */
-    memcpy(mem->base + a, mem->base + z, sizeof(unsigned int));
-
-    /* copy the ent number into the free-list node */
-    memcpy(mem->base + z, &ent, sizeof(unsigned int));
+    return mem->sweep >= mem->sweep_limit;
+}
 
-    return sz;
+/* print the large-object tree in order */
+static
+void _xpost_free_tree_dump(Xpost_Memory_File *mem, unsigned int e)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int f;
+    if (!e) return;
+    _xpost_free_tree_dump(mem, _xpost_free_get_link(mem, xpost_memory_table_entry(tab, e)->adr + XPOST_FREE_TREE_LEFT));
+    for (f = e; f; f = _xpost_free_get_link(mem, xpost_memory_table_entry(tab, f)->adr + XPOST_FREE_TREE_SAME))
+        printf("%u(%u) ", f, xpost_memory_table_entry(tab, f)->sz);
+    _xpost_free_tree_dump(mem,
+            _xpost_free_get_link(mem, xpost_memory_table_entry(tab, e)->adr + XPOST_FREE_TREE_RIGHT));
 }
 
 /* print a dump of the free list */
 void xpost_free_dump(Xpost_Memory_File *mem)
 {
+    unsigned int bin;
     unsigned int e;
     unsigned int z;
     int ret;
@@ -211,194 +476,375 @@ void xpost_free_dump(Xpost_Memory_File *mem)
     }
 
     printf("freelist: ");
-    memcpy(&e, mem->base + z, sizeof(unsigned int));
-    while (e)
+    for (bin = 0; bin < XPOST_FREE_BINS; bin++)
     {
-        unsigned int sz;
-        ret = xpost_memory_table_get_size(mem, e, &sz);
-        if (!ret)
+        e = _xpost_free_get_link(mem, z + bin * sizeof(unsigned int));
+        while (e)
         {
-            return;
-        }
-        printf("%u(%u) ", e, sz);
-        ret = xpost_memory_table_get_addr(mem, e, &z);
-        if (!ret)
-        {
-            return;
+            unsigned int sz;
+            ret = xpost_memory_table_get_size(mem, e, &sz);
+            if (!ret)
+            {
+                return;
+            }
+            printf("%u(%u) ", e, sz);
+            e = _xpost_free_get_link(mem, xpost_memory_table_entry(&mem->table, e)->adr);
         }
-        memcpy(&e, mem->base + z, sizeof(unsigned int));
     }
+    _xpost_free_tree_dump(mem,
+            _xpost_free_get_link(mem, z + XPOST_FREE_TREE * sizeof(unsigned int)));
 }
 
-/* scan the free list for a suitably-sized bit of memory,
-
-   if the allocator falls back to fresh memory XPOST_GARBAGE_COLLECTION_PERIOD times,
-        it triggers a collection.
-    Returns 1 on success, 0 on failure, 2 to request garbage collection and re-call.
- */
-int xpost_free_alloc(Xpost_Memory_File *mem,
-                     unsigned int sz,
-                     unsigned int tag,
-                     unsigned int *entity)
+/* take a suitably-sized ent out of one of the small bins.
+   the bin for sz may hold slightly smaller allocations, so look at
+   the first few, then take the first of any larger bin which does
+   not waste too much space.
+   returns the ent or 0 if none was found, or sets *bad if a
+   corrupted link is encountered */
+static
+unsigned int _xpost_free_alloc_small(Xpost_Memory_File *mem,
+                                     unsigned int z,
+                                     unsigned int sz,
+                                     int *bad)
 {
-    unsigned int z;
-    unsigned int e;                     /* working pointer */
-    //static int period = XPOST_GARBAGE_COLLECTION_PERIOD;
-    //static int threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
-    int ret;
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int bin = _xpost_free_bin(sz);
+    unsigned int link = z + bin * sizeof(unsigned int);
+    unsigned int e;
+    unsigned int i;
 
-    if (!mem->interpreter_get_initializing())
+    for (i = 0; i < XPOST_FREE_BIN_SEARCH; i++)
     {
-#ifdef XPOST_USE_THRESHOLD
-        //(void)period;
-        if ((mem->threshold -= sz) <= 0)
+        e = _xpost_free_get_link(mem, link);
+        if (!e)
+            break;
+        if (e >= tab->nextent)
         {
-            mem->threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
-            return 2;
+            *bad = 1;
+            return 0;
         }
-#else
-        //(void)threshold;
-        if (--mem->period == 0) /* check garbage-collection control */
+        if (xpost_memory_table_entry(tab, e)->sz >= sz)
         {
-            mem->period = XPOST_GARBAGE_COLLECTION_PERIOD;
-            return 2; /* not found, request garbage-collection and try-again */
-            /* collect(mem, 1, 0); */
-            /* goto try_again; */
+            _xpost_free_set_link(mem, link, _xpost_free_get_link(mem, xpost_memory_table_entry(tab, e)->adr));
+            return e;
         }
-#endif
+        link = xpost_memory_table_entry(tab, e)->adr;
     }
 
-    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z); /* free pointer */
-    if (!ret)
+    for (++bin; bin < XPOST_FREE_BINS; bin++)
     {
-        XPOST_LOG_ERR("unable to load free list head");
-        return 0;
+        link = z + bin * sizeof(unsigned int);
+        e = _xpost_free_get_link(mem, link);
+        if (!e)
+            continue;
+        if (e >= tab->nextent)
+        {
+            *bad = 1;
+            return 0;
+        }
+        /* if this ent is too big, so are all the rest */
+        if (xpost_memory_table_entry(tab, e)->sz * XPOST_FREE_ACCEPT_DENOM > sz * XPOST_FREE_ACCEPT_OVERSIZE)
+            return 0;
+        _xpost_free_set_link(mem, link, _xpost_free_get_link(mem, xpost_memory_table_entry(tab, e)->adr));
+        return e;
     }
 
-    memcpy(&e, mem->base+z, sizeof(unsigned int)); /* e = *z */
-    while (e) /* e is not zero */
+    return 0;
+}
+
+/* take the best-fitting ent out of the large-object tree,
+   returns the ent or 0 if none was found, or sets *bad if a
+   corrupted link is encountered */
+static
+unsigned int _xpost_free_alloc_large(Xpost_Memory_File *mem,
+                                     unsigned int z,
+                                     unsigned int sz,
+                                     int *bad)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int link = z + XPOST_FREE_TREE * sizeof(unsigned int);
+    unsigned int best = 0;
+    unsigned int e;
+
+    while ((e = _xpost_free_get_link(mem, link)) != 0)
     {
-        unsigned int tsz;
-        if (e > XPOST_OBJECT_COMP_MAX_ENT)
+        if (e >= tab->nextent)
         {
-            unsigned int zero = 0;
-            XPOST_LOG_ERR("ent number %u exceeds object storage max %u",
-                    e, XPOST_OBJECT_COMP_MAX_ENT);
-            /* bad element found: discard free list */
-            xpost_memory_put(mem, 0, 0, sizeof zero, &zero);
-            return 2; /* request collection to fill the list */
+            *bad = 1;
+            return 0;
         }
-        ret = xpost_memory_table_get_size(mem, e, &tsz);
-        if (!ret)
+        if (xpost_memory_table_entry(tab, e)->sz >= sz)
         {
-            XPOST_LOG_ERR("cannot retrieve size of ent %u", e);
-            return 0;
+            best = link;
+            if (xpost_memory_table_entry(tab, e)->sz == sz)
+                break; /* an exact fit */
+            link = xpost_memory_table_entry(tab, e)->adr + XPOST_FREE_TREE_LEFT; /* look left for a closer fit */
         }
+        else
+        {
+            link = xpost_memory_table_entry(tab, e)->adr + XPOST_FREE_TREE_RIGHT;
+        }
+    }
+    if (!best)
+        return 0;
+
+    e = _xpost_free_get_link(mem, best);
+    /* if this ent is too big */
+    if (xpost_memory_table_entry(tab, e)->sz * XPOST_FREE_ACCEPT_DENOM > sz * XPOST_FREE_ACCEPT_OVERSIZE)
+        return 0;
+    return _xpost_free_tree_take(mem, best);
+}
+
+/* take a suitably-sized ent out of the bins or the large-object tree,
+   returns the ent or 0 if none was found, or sets *bad if a
+   corrupted link is encountered */
+static
+unsigned int _xpost_free_alloc_fit(Xpost_Memory_File *mem,
+                                   unsigned int z,
+                                   unsigned int sz,
+                                   int *bad)
+{
+    unsigned int e = 0;
+
+    if (_xpost_free_bin(sz) != XPOST_FREE_TREE)
+        e = _xpost_free_alloc_small(mem, z, sz, bad);
+    if (!e && !*bad &&
+        _xpost_free_bin(sz * XPOST_FREE_ACCEPT_OVERSIZE / XPOST_FREE_ACCEPT_DENOM) == XPOST_FREE_TREE)
+        e = _xpost_free_alloc_large(mem, z, sz, bad);
+    return e;
+}
 
-        /* if this ent is sufficient to hold sz,
-           but does not waste more than sz bytes, use it */
-        if (tsz >= sz)
+/* make room in the list of ents with storage in the nursery */
+static
+int _xpost_free_young_reserve(Xpost_Memory_File *mem)
+{
+    if (mem->nyoung == mem->young_max)
+    {
+        unsigned int max = mem->young_max ? mem->young_max * 2 : 1024;
+        unsigned int *tmp = realloc(mem->young, max * sizeof *tmp);
+        if (!tmp)
         {
-            Xpost_Memory_Table *tab = &mem->table;
-            unsigned int ent;
-            unsigned int ad;
+            XPOST_LOG_ERR("cannot grow young list to %u entries", max);
+            return 0;
+        }
+        mem->young = tmp;
+        mem->young_max = max;
+    }
+    return 1;
+}
 
-            /* if this ent is too big */
-            if (tsz * XPOST_FREE_ACCEPT_DENOM > sz * XPOST_FREE_ACCEPT_OVERSIZE)
-            {
-                return 0; /* early exit to _new allocator since free list is sorted */
-            }
+/* bump-allocate sz bytes in the nursery, creating it if necessary.
+   returns 1 on success, 0 if the nursery is full */
+static
+int _xpost_free_alloc_young(Xpost_Memory_File *mem,
+                            unsigned int z,
+                            unsigned int sz,
+                            unsigned int tag,
+                            unsigned int *entity)
+{
+    Xpost_Memory_Table_Entry *te;
+    unsigned int adr;
+    unsigned int e;
 
-            ret = xpost_memory_table_get_addr(mem, e, &ad);
-            if (!ret)
-            {
-                XPOST_LOG_ERR("cannot retrieve address of ent %u", e);
-                return 0;
-            }
-            memcpy(mem->base + z, mem->base + ad, sizeof(unsigned int));
-            ent = e;
-            if (ent >= mem->table.nextent)
-            {
-                XPOST_LOG_ERR("cannot find table for ent %u", e);
-                return 0;
-            }
-            tab->tab[ent].tag = tag;
-            *entity = e;
-            return 1; /* found, return SUCCESS */
+    if (!mem->nursery_limit)
+    {
+        int bad = 0;
+        unsigned int size = mem->nursery_size;
+
+        /* re-use a large free block, or fresh memory */
+        e = _xpost_free_alloc_fit(mem, z, size, &bad);
+        if (bad)
+            (void) xpost_free_discard(mem);
+        if (e)
+        {
+            te = xpost_memory_table_entry(&mem->table, e);
+            adr = te->adr;
+            size = te->sz;
+            te->mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK;
+            (void) xpost_free_release_ent(mem, e);
         }
-        ret = xpost_memory_table_get_addr(mem, e, &z);
-        if (!ret)
+        else if (!xpost_memory_file_alloc(mem, size, &adr))
         {
-            XPOST_LOG_ERR("cannot retrieve address for ent %u", e);
+            XPOST_LOG_ERR("cannot allocate nursery, disabling it");
+            mem->nursery_size = 0;
             return 0;
         }
-        memcpy(&e, mem->base + z, sizeof(unsigned int));
+        mem->nursery_base = mem->nursery_top = adr;
+        mem->nursery_limit = adr + size;
     }
-    /* finished scanning free list */
 
-    return 0; /* not found, fall-back to _new allocator */
+    sz = (sz + 7) & ~7U;
+    if (sz > mem->nursery_limit - mem->nursery_top)
+        return 0;
+    if (!_xpost_free_young_reserve(mem))
+        return 0;
+
+    adr = mem->nursery_top;
+    e = _xpost_free_take_empty(mem, z);
+    if (e)
+    {
+        te = xpost_memory_table_entry(&mem->table, e);
+        te->adr = adr;
+        te->sz = sz;
+        te->tag = tag;
+    }
+    else
+    {
+        if (!xpost_memory_table_alloc_ent(mem, adr, sz, tag, &e))
+            return 0;
+        te = xpost_memory_table_entry(&mem->table, e);
+    }
+    mem->nursery_top += sz;
+    memset(mem->base + adr, 0, sz);
+
+    te->mark = 0;
+    /* the sweep has yet to reach this ent: allocate it marked */
+    if (e >= mem->sweep && e < mem->sweep_limit)
+        te->mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+    mem->young[mem->nyoung++] = e;
+    *entity = e;
+    return 1;
 }
 
-/*
-   use the free-list and tables to now provide a realloc for
-   "raw" vm addresses (mem->base offsets rather than ents).
+/* give ent fresh storage outside the nursery and copy its contents,
+   for a minor collection. returns 1 on success, 0 on failure */
+int xpost_free_move_ent(Xpost_Memory_File *mem,
+                        unsigned int ent)
+{
+    Xpost_Memory_Table_Entry *te;
+    unsigned int sz;
+    unsigned int nsz;
+    unsigned int adr;
+    unsigned int z;
+    unsigned int e;
+    int bad = 0;
 
-   Allocate new entry, copy data, steal its adr, stash old adr, free it.
+    if (ent < mem->start || ent >= mem->table.nextent)
+    {
+        XPOST_LOG_ERR("cannot move ent %u", ent);
+        return 0;
+    }
+    sz = nsz = xpost_memory_table_entry(&mem->table, ent)->sz;
 
-   Currently this is only used to re-size signature blocks in the operator table.
+    if (!xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z))
+    {
+        XPOST_LOG_ERR("unable to load free list head");
+        return 0;
+    }
+    e = _xpost_free_alloc_fit(mem, z, sz, &bad);
+    if (bad)
+        (void) xpost_free_discard(mem);
+    if (e)
+    {
+        te = xpost_memory_table_entry(&mem->table, e);
+        adr = te->adr;
+        nsz = te->sz;
+        te->mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK;
+        (void) xpost_free_release_ent(mem, e);
+    }
+    else if (!xpost_memory_file_alloc(mem, sz, &adr))
+    {
+        XPOST_LOG_ERR("unable to allocate storage to move ent %u", ent);
+        return 0;
+    }
+
+    te = xpost_memory_table_entry(&mem->table, ent);
+    memcpy(mem->base + adr, mem->base + te->adr, sz);
+    te->adr = adr;
+    xpost_memory_save_marks_spoil(mem, ent, adr);
+    te->sz = nsz;
+    mem->allocated += nsz;
+    return 1;
+}
+
+/* search the bins for a suitably-sized bit of memory,
+
+   if more than mem->threshold bytes have been requested since the
+        last collection, it triggers a collection.
+    Returns 1 on success, 0 on failure, 2 to request garbage collection and re-call.
  */
-unsigned int xpost_free_realloc(Xpost_Memory_File *mem,
-                                unsigned int oldadr,
-                                unsigned int oldsize,
-                                unsigned int newsize)
+int xpost_free_alloc(Xpost_Memory_File *mem,
+                     unsigned int sz,
+                     unsigned int tag,
+                     unsigned int *entity)
 {
-    Xpost_Memory_Table *tab = NULL;
-    unsigned int newadr;
-    unsigned int ent;
-    unsigned int rent; /* relative ent */
+    unsigned int z;
+    unsigned int e = 0;
+    int bad = 0;
     int ret;
 
-#ifdef DEBUGFREE
-    printf("xpost_free_realloc: ");
-    printf("initial ");
-    xpost_free_dump(mem);
-#endif
+    /* small arrays and dicts of a running program start in the nursery */
+    if (mem->nursery_size && sz && sz <= XPOST_MEMORY_NURSERY_MAX_OBJECT &&
+        (tag == arraytype || tag == dicttype) &&
+        !mem->marking && !mem->interpreter_get_initializing())
+    {
+        ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z);
+        if (ret && _xpost_free_alloc_young(mem, z, sz, tag, entity))
+        {
+            ++mem->stats.nursery_allocs;
+            return 1;
+        }
+    }
 
-    /* allocate new entry */
-    ret = xpost_memory_table_alloc(mem, newsize, 0, &ent);
-    if (!ret)
+    if (!mem->interpreter_get_initializing())
     {
-        XPOST_LOG_ERR("cannot allocate new memory");
-        return 0;
+        mem->allocated += sz + sizeof(Xpost_Memory_Table_Entry);
+        if (mem->allocated >= mem->threshold && !mem->reclaim_disabled)
+            return 2; /* request garbage-collection and try-again */
     }
-    rent = ent;
-    tab = &mem->table;
-    if (ent >= mem->table.nextent)
+
+    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z); /* free pointer */
+    if (!ret)
     {
-        XPOST_LOG_ERR("cannot find table for ent %u", ent);
+        XPOST_LOG_ERR("unable to load free list head");
         return 0;
     }
 
-    /* steal its adr */
-    newadr = tab->tab[rent].adr;
-
-    /* copy data */
-    memcpy(mem->base + newadr, mem->base + oldadr, oldsize);
+    for (;;)
+    {
+        if (sz)
+            e = _xpost_free_alloc_fit(mem, z, sz, &bad);
+        if (e || bad || !sz || mem->sweep >= mem->sweep_limit)
+            break;
+        /* nothing fits yet: sweep further before using fresh memory */
+        (void) xpost_free_sweep(mem, XPOST_FREE_SWEEP_STEP);
+    }
 
-    /* stash old adr */
-    tab->tab[rent].adr = oldadr;
-    tab->tab[rent].sz = oldsize;
+    if (bad)
+    {
+        XPOST_LOG_ERR("ent number exceeds table size %u",
+                mem->table.nextent);
+        /* bad element found: discard free list */
+        (void) xpost_free_discard(mem);
+        return 2; /* request collection to fill the list */
+    }
 
-    /* free it */
-    (void) xpost_free_memory_ent(mem, ent);
+    if (e)
+        ++mem->stats.free_list_hits;
+    else /* re-use a table slot, if any, for fresh memory */
+    {
+        e = _xpost_free_alloc_empty(mem, z, sz);
+        if (e)
+            ++mem->stats.free_list_misses;
+    }
 
-#ifdef DEBUGFREE
-    printf("final ");
-    xpost_free_dump(mem);
-    printf("\n");
-    dumpmtab(mem, 0);
-    fflush(NULL);
-#endif
+    if (e)
+    {
+        Xpost_Memory_Table_Entry *te = xpost_memory_table_entry(&mem->table, e);
+
+        te->tag = tag;
+        /* the save levels of the previous allocation go too */
+        te->mark &= ~(XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK |
+                      XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK |
+                      XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK |
+                      XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK);
+        /* marking is under way or the sweep has yet to reach this ent:
+           allocate it marked */
+        if (mem->marking || (e >= mem->sweep && e < mem->sweep_limit))
+            te->mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+        *entity = e;
+        return 1; /* found, return SUCCESS */
+    }
 
-    return newadr;
+    return 0; /* not found, fall-back to _new allocator */
 }
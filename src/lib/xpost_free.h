@@ -45,12 +45,29 @@
  *  will first call xpost_free_alloc before falling back to increasing the size
  *  of the memory space.
 
- *  The free list is a chain of unused ents and their associated memory.
- *  The free list head is ent 0, which points (via the address field in
- *  the memory table entry for ent 0) to a 32bit int which is either 0
- *  (ie. a "NULL" "pointer", also a link back to the head (!)) or the ent
- *  number of the next free allocation. Any subsequent ents in the chain
- *  will have the next ent or 0 in the first 4 bytes of the allocation.
+ *  The free list is a set of chains of unused ents and their associated
+ *  memory, segregated by size. The data area of ent 0 holds an array of
+ *  XPOST_FREE_BINS 32bit ints, the heads of the small-size chains, followed
+ *  by the root of the large-object tree. Each small bin holds allocations
+ *  whose sizes fall into the same XPOST_FREE_BIN_GRAIN-byte class. A head
+ *  is either 0 (ie. a "NULL" "pointer") or the ent number of the first free
+ *  allocation in the bin. Any subsequent ents in a chain will have the next
+ *  ent or 0 in the first 4 bytes of the allocation.
+ *
+ *  Allocations larger than the biggest bin are kept in a binary search tree
+ *  with one node per size. The first 4 bytes of a node's allocation hold
+ *  the left child, the next 4 bytes the right child, and the next 4 bytes
+ *  the head of a chain of the other free ents of the same size, linked
+ *  through the same 4 bytes of theirs. A sweep frees many ents of the same
+ *  size, and these go on the chain in constant time rather than making
+ *  the tree deeper.
+ *
+ *  The slot after the tree root heads a chain of ents which have no memory
+ *  of their own any more, linked through the address field of the memory
+ *  table. These are handed out with fresh memory before growing the table.
+ *
+ *  Since all of this lives in the memory file itself, the free list is
+ *  preserved by file-backed VM and is not disturbed by save and restore.
  *
  *  (All allocations are padded to at least an even word and zero-sized
  *  allocations are ignored, so any ent that can be put on the free list
@@ -61,10 +78,13 @@
  * @enum  Xpost_Garbage_Params
  * @brief private constants
  *
- * FIXME: PLRM describes garbage collection control to be based on
- * number of bytes allocated, not the number of allocations.
- * Also this should be a variable accessible through `setvmthreshold`
- * and `setsystemparams` operators.
+ * Automatic collection is triggered by the number of bytes allocated
+ * since the previous collection (counting a table entry for each
+ * allocation). The trigger is the larger of the VMThreshold and the
+ * size of the memory that survived the last collection scaled by a
+ * percentage the collector adjusts from its own results.
+ * Collecting global vm means traversing every local vm as well,
+ * so its threshold is multiplied by XPOST_GARBAGE_COLLECTION_GLOBAL_RATIO.
  * PLRM, appendix C describes this variable, which is expected in the
  * dictionary argument of `setsystemparams`, and returned by
  * `currentsystemparams`:
@@ -74,24 +94,69 @@
  */
 typedef enum
 {
-    XPOST_GARBAGE_COLLECTION_PERIOD = 20000,  /**< number of times to grow before collecting */
-    XPOST_GARBAGE_COLLECTION_THRESHOLD = 1000000000  /**< number of bytes to allocate before collecting */
+    XPOST_GARBAGE_COLLECTION_THRESHOLD = 4000000, /**< default VMThreshold in bytes */
+    XPOST_GARBAGE_COLLECTION_THRESHOLD_MIN = 100000, /**< smallest VMThreshold accepted */
+    XPOST_GARBAGE_COLLECTION_THRESHOLD_MAX = 0x7FFFFFFF, /**< largest VMThreshold accepted */
+    XPOST_GARBAGE_COLLECTION_SCALE = 100, /**< initial threshold as a percentage of live size */
+    XPOST_GARBAGE_COLLECTION_SCALE_MIN = 50, /**< smallest adjusted scale */
+    XPOST_GARBAGE_COLLECTION_SCALE_MAX = 800, /**< largest adjusted scale */
+    XPOST_GARBAGE_COLLECTION_GLOBAL_RATIO = 16 /**< global vm threshold as a multiple of local */
 } Xpost_Garbage_Params;
 
-#define XPOST_USE_THRESHOLD
-
 /**
  * Maximum size to accept from an allocation relative to the size requested
  */
 #define XPOST_FREE_ACCEPT_OVERSIZE 3
 #define XPOST_FREE_ACCEPT_DENOM 2
 
+/**
+ * Size granularity of the small-allocation bins
+ */
+#define XPOST_FREE_BIN_GRAIN 8
+
+/**
+ * Number of small-allocation bins. Allocations larger than
+ * XPOST_FREE_BINS * XPOST_FREE_BIN_GRAIN go in the large-object tree.
+ */
+#define XPOST_FREE_BINS 128
+
+/**
+ * Slot of the large-object tree root in the free list head
+ */
+#define XPOST_FREE_TREE XPOST_FREE_BINS
+
+/**
+ * Offsets of the links in the storage of a large-object tree node:
+ * the smaller and larger subtrees, and the list of other free ents
+ * of the same size
+ */
+#define XPOST_FREE_TREE_LEFT 0
+#define XPOST_FREE_TREE_RIGHT sizeof(unsigned int)
+#define XPOST_FREE_TREE_SAME (2 * sizeof(unsigned int))
+
+/**
+ * Number of entries to examine in the exact-size bin before moving
+ * on to the larger bins
+ */
+#define XPOST_FREE_BIN_SEARCH 4
+
+/**
+ * Number of entries to sweep at a time when an allocation cannot be
+ * satisfied while the sweep following a collection is unfinished
+ */
+#define XPOST_FREE_SWEEP_STEP 256
+
 /**
  * @brief  initialize the FREE special entity which points
  *         to the head of the free list
  */
 int xpost_free_init(Xpost_Memory_File *mem);
 
+/**
+ * @brief  discard the contents of the free list
+ */
+int xpost_free_discard(Xpost_Memory_File *mem);
+
 /**
  * @brief  print a dump of the free list
  */
@@ -107,22 +172,47 @@ int xpost_free_alloc(Xpost_Memory_File *mem,
 
 /**
  * @brief  explicitly add ent to free list
+ *
+ * The ent is flagged with XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK
+ * until it is allocated again; freeing it twice does nothing.
  */
 int xpost_free_memory_ent(Xpost_Memory_File *mem,
                           unsigned int ent);
 
 /**
- * @brief reallocate data, preserving original contents
+ * @brief  sweep up to count ents of the sweep following a collection
+ *
+ * After marking, the collector sets mem->sweep and mem->sweep_limit
+ * instead of sweeping the whole table at once. The ents in between are
+ * swept a few at a time by xpost_free_alloc, when it finds nothing
+ * suitable on the free list, and by the idle loop. Ents allocated in
+ * this range before the sweep reaches them are allocated marked.
+ * The sizes reclaimed and surviving are added to mem->gc.
+ *
+ * returns 1 if the sweep is complete, 0 otherwise.
+ */
+int xpost_free_sweep(Xpost_Memory_File *mem,
+                     unsigned int count);
 
- * Use the free-list and tables to now provide a realloc for
- * "raw" vm addresses (mem->base offsets rather than ents).
- * Assumes new size is larger than old size.
+/**
+ * @brief  put an ent whose memory has been reclaimed by other means
+ *         on the free list, to be given fresh memory when it is re-used
+ */
+int xpost_free_release_ent(Xpost_Memory_File *mem,
+                           unsigned int ent);
 
- * Allocate new entry, copy data, steal its adr, stash old adr, free it.
+/**
+ * @brief  move the storage of an ent out of the nursery
+ *
+ * Small arrays and dicts of a running program are bump-allocated in the
+ * nursery of a memory file with a nursery_size. A minor collection
+ * gives each one that survives storage from the free list, or fresh
+ * memory, and copies its contents. Objects refer to the ent, which
+ * keeps its number, so nothing else needs to change.
+ *
+ * returns 1 on success, 0 on failure.
  */
-unsigned int xpost_free_realloc(Xpost_Memory_File *mem,
-                                unsigned int oldadr,
-                                unsigned int oldsize,
-                                unsigned int newsize);
+int xpost_free_move_ent(Xpost_Memory_File *mem,
+                        unsigned int ent);
 
 #endif
@@ -34,6 +34,7 @@
 #endif
 
 #include <assert.h>
+#include <limits.h> /* UINT_MAX */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,7 +45,7 @@
 
 #include "xpost.h"
 #include "xpost_log.h"
-#include "xpost_compat.h" /* xpost_mkstemp */
+#include "xpost_compat.h" /* xpost_get_usertime_us xpost_mkstemp */
 #include "xpost_memory.h"
 #include "xpost_object.h"
 #include "xpost_stack.h"
@@ -55,6 +56,7 @@
 #include "xpost_dict.h"
 #include "xpost_save.h"
 #include "xpost_name.h"
+#include "xpost_file.h"
 
 //#include "xpost_interpreter.h"
 #include "xpost_garbage.h"
@@ -64,6 +66,9 @@
 #endif
 
 
+static
+int _xpost_garbage_mark_finish(void);
+
 /* iterate through all tables,
     clear the MARK in the mark. */
 static
@@ -73,9 +78,14 @@ void _xpost_garbage_unmark(Xpost_Memory_File *mem)
 
     if (!mem) return;
 
+    /* the marks of an unfinished collection are still needed */
+    if (mem->marking)
+        (void) _xpost_garbage_mark_finish();
+    (void) xpost_garbage_sweep_finish(mem);
+
     for (i = mem->start; i < mem->table.nextent; i++)
     {
-        mem->table.tab[i].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+        xpost_memory_table_entry(&mem->table, i)->mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
     }
 }
 
@@ -97,7 +107,7 @@ int _xpost_garbage_mark_ent(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find ent %u", ent);
         return 0;
     }
-    mem->table.tab[ent].mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+    xpost_memory_table_entry(&mem->table, ent)->mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
     return 1;
 }
 
@@ -114,17 +124,96 @@ int _xpost_garbage_ent_is_marked(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    *retval = (mem->table.tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK)
+    *retval = (xpost_memory_table_entry(&mem->table, ent)->mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK)
         >> XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET;
 
     return 1;
 }
 
-/* recursively mark an object */
+/*
+   composite objects whose contents are still to be traversed.
+   marking an object sets its mark and pushes it here instead of
+   recursing, so the depth of a structure costs heap, not C stack.
+ */
+typedef struct
+{
+    Xpost_Memory_File *mem;
+    unsigned int ent;
+    unsigned int type;
+} markrec;
+
+static markrec *_xpost_garbage_mark_stack_data;
+static unsigned int _xpost_garbage_mark_stack_top;
+static unsigned int _xpost_garbage_mark_stack_max;
+
+/* the context whose local vm is being marked incrementally, if any.
+   its mark stack lives on between steps, so only one vm at a time. */
+static Xpost_Context *_xpost_garbage_marking_ctx;
+
+#ifdef __GNUC__
+# define XPOST_GARBAGE_PREFETCH(p) __builtin_prefetch(p)
+#else
+# define XPOST_GARBAGE_PREFETCH(p) ((void)(p))
+#endif
+
+/* push an object onto the mark stack, growing it if necessary */
+static
+int _xpost_garbage_mark_stack_push(Xpost_Memory_File *mem,
+                                   unsigned int ent,
+                                   unsigned int type)
+{
+    markrec *rec;
+
+    if (_xpost_garbage_mark_stack_top == _xpost_garbage_mark_stack_max)
+    {
+        unsigned int max = _xpost_garbage_mark_stack_max ?
+            _xpost_garbage_mark_stack_max * 2 : XPOST_GARBAGE_MARK_STACK_SIZE;
+        markrec *tmp = realloc(_xpost_garbage_mark_stack_data, max * sizeof *tmp);
+        if (!tmp)
+        {
+            XPOST_LOG_ERR("cannot grow mark stack to %u entries", max);
+            return 0;
+        }
+        _xpost_garbage_mark_stack_data = tmp;
+        _xpost_garbage_mark_stack_max = max;
+    }
+    rec = &_xpost_garbage_mark_stack_data[_xpost_garbage_mark_stack_top++];
+    rec->mem = mem;
+    rec->ent = ent;
+    rec->type = type;
+    return 1;
+}
+
+/* release the mark stack after a collection */
+static
+void _xpost_garbage_mark_stack_free(void)
+{
+    free(_xpost_garbage_mark_stack_data);
+    _xpost_garbage_mark_stack_data = NULL;
+    _xpost_garbage_mark_stack_top = 0;
+    _xpost_garbage_mark_stack_max = 0;
+}
+
+/* prefetch the table entry of an object about to be marked */
+static
+void _xpost_garbage_prefetch_object(Xpost_Context *ctx, Xpost_Object o)
+{
+    Xpost_Memory_File *objmem;
+    unsigned int ent;
+
+    if (!xpost_object_is_composite(o))
+        return;
+    objmem = xpost_context_select_memory(ctx, o);
+    ent = xpost_object_get_ent(o);
+    if (ent < objmem->table.nextent)
+        XPOST_GARBAGE_PREFETCH(xpost_memory_table_entry(&objmem->table, ent));
+}
+
+/* set the mark of an object and queue its contents to be traversed */
 static
-int _xpost_garbage_mark_object(Xpost_Context *ctx, Xpost_Memory_File *mem, Xpost_Object o, int markall);
+int _xpost_garbage_shade_object(Xpost_Context *ctx, Xpost_Memory_File *mem, Xpost_Object o, int markall);
 
-/* recursively mark a dictionary */
+/* shade the keys and values of a dictionary */
 static
 int _xpost_garbage_mark_dict(Xpost_Context *ctx,
                              Xpost_Memory_File *mem,
@@ -137,15 +226,18 @@ int _xpost_garbage_mark_dict(Xpost_Context *ctx,
         dichead *dp = (void *)(mem->base + adr);
         dicrec *tp = (void *)(mem->base + adr + sizeof(dichead));
         int j;
+        int n = DICTABN(dp->sz);
 #ifdef DEBUG_GC
         Xpost_Object_Type type;
         printf("markdict: nused=%d\n", dp->nused);
 #endif
 
-        for (j = 0; j < DICTABN(dp->sz); j++)
+        for (j = 0; j < n; j++)
         {
             if (xpost_object_get_type(tp[j].key) != nulltype){
-                if (!_xpost_garbage_mark_object(ctx,
+                if (j + 1 < n)
+                    _xpost_garbage_prefetch_object(ctx, tp[j + 1].value);
+                if (!_xpost_garbage_shade_object(ctx,
                             xpost_context_select_memory(ctx,tp[j].key), tp[j].key, markall))
                     return 0;
 #ifdef DEBUG_GC
@@ -172,7 +264,7 @@ int _xpost_garbage_mark_dict(Xpost_Context *ctx,
             printf(":");
             printf("%s\n", xpost_object_type_names[xpost_object_get_type(tp[j].value)]);
 #endif
-                if (!_xpost_garbage_mark_object(ctx,
+                if (!_xpost_garbage_shade_object(ctx,
                             xpost_context_select_memory(ctx,tp[j].value), tp[j].value, markall))
                     return 0;
             }
@@ -182,7 +274,7 @@ int _xpost_garbage_mark_dict(Xpost_Context *ctx,
     return 1;
 }
 
-/* recursively mark all elements of array */
+/* shade all elements of array */
 static
 int _xpost_garbage_mark_array(Xpost_Context *ctx,
                               Xpost_Memory_File *mem,
@@ -205,9 +297,11 @@ int _xpost_garbage_mark_array(Xpost_Context *ctx,
 #ifdef DEBUG_GC
             printf("%u:%s\n", j, xpost_object_type_names[xpost_object_get_type(op[j])]);
 #endif
-            if (!_xpost_garbage_mark_object(ctx,
-                                            xpost_context_select_memory(ctx,op[j]),
-                                            op[j], markall))
+            if (j + 1 < sz)
+                _xpost_garbage_prefetch_object(ctx, op[j + 1]);
+            if (!_xpost_garbage_shade_object(ctx,
+                                             xpost_context_select_memory(ctx,op[j]),
+                                             op[j], markall))
                 return 0;
         }
     }
@@ -221,32 +315,33 @@ int _xpost_garbage_mark_array(Xpost_Context *ctx,
    even if it means switching memory files
  */
 static
-int _xpost_garbage_mark_object(Xpost_Context *ctx,
-                               Xpost_Memory_File *mem,
-                               Xpost_Object o,
-                               int markall)
+int _xpost_garbage_shade_object(Xpost_Context *ctx,
+                                Xpost_Memory_File *mem,
+                                Xpost_Object o,
+                                int markall)
 {
-    unsigned int ad;
     int ret;
-    unsigned int tag;
     unsigned int ent;
     Xpost_Object_Type type;
     Xpost_Memory_File *objmem;
 
     if (!mem) return 0;
 
-    if (!xpost_object_is_composite(o))
-        return 1;
-
-    ent = xpost_object_get_ent(o);
     type = xpost_object_get_type(o);
+    /* a file is not composite, but its ent holds the Xpost_File */
+    if (type == filetype)
+        ent = o.mark_.padw;
+    else if (xpost_object_is_composite(o))
+        ent = xpost_object_get_ent(o);
+    else
+        return 1;
 
 #ifdef DEBUG_GC
             printf("markobject: ent %d, addr %u, %s (size %d)\n",
                    ent,
                    xpost_context_select_memory(ctx,o)==mem?
                        (ent >= mem->table.nextent?
-                        (unsigned)-1: mem->table.tab[ent].adr) : 0,
+                        (unsigned)-1: xpost_memory_table_entry(&mem->table, ent)->adr) : 0,
                    xpost_object_type_names[type],
                    o.comp_.sz);
 #endif
@@ -260,7 +355,8 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
             {
                 return 1;
             }
-
+            /*@fallthrough@*/
+        case dicttype:
             objmem = xpost_context_select_memory(ctx, o);
             if (objmem != mem) {
                 if (!markall)
@@ -273,72 +369,17 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                         ent);
                 return 0;
             }
-            if (!objmem) return 0;
             if (!_xpost_garbage_ent_is_marked(objmem, ent, &ret))
                 return 0;
             if (!ret) {
                 ret = _xpost_garbage_mark_ent(objmem, ent);
                 if (!ret)
                 {
-                    XPOST_LOG_ERR("cannot mark array %d", ent);
-                    return 0;
-                }
-                ret = xpost_memory_table_get_addr(objmem, ent, &ad);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot retrieve address for array ent %u", ent);
-                    return 0;
-                }
-                ret = xpost_memory_table_get_tag(objmem, ent, &tag);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot retrieve tag for array ent %u", ent);
-                    return 0;
-                }
-                if (o.comp_.sz != objmem->table.tab[ent].used/sizeof(Xpost_Object))
-                {
-                    XPOST_LOG_INFO("o.comp_.sz %u != tab[ent].used/obj %u",
-                            o.comp_.sz, objmem->table.tab[ent].used/sizeof(Xpost_Object));
-                }
-                if (!_xpost_garbage_mark_array(ctx, objmem, ad,
-                            //mem->table.tab[ent].used/sizeof(Xpost_Object)
-                            o.comp_.sz
-                            , markall))
-                    return 0;
-            }
-            break;
-
-        case dicttype:
-            objmem = xpost_context_select_memory(ctx, o);
-            if (objmem != mem)
-            {
-                if (!markall)
-                    break;
-            }
-            if (ent < objmem->start)
-            {
-                XPOST_LOG_ERR("attempt to mark %s object %d",
-                        xpost_object_type_names[type],
-                        ent);
-                return 0;
-            }
-            if (!_xpost_garbage_ent_is_marked(objmem, ent, &ret))
-                return 0;
-            if (!ret)
-            {
-                ret = _xpost_garbage_mark_ent(objmem, ent);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot mark dict");
+                    XPOST_LOG_ERR("cannot mark %s %d",
+                            xpost_object_type_names[type], ent);
                     return 0;
                 }
-                ret = xpost_memory_table_get_addr(objmem, ent, &ad);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot retrieve address for dict ent %u", ent);
-                    return 0;
-                }
-                if (!_xpost_garbage_mark_dict(ctx, objmem, ad, markall))
+                if (!_xpost_garbage_mark_stack_push(objmem, ent, type))
                     return 0;
             }
             break;
@@ -380,16 +421,12 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                         ent);
                 return 0;
             }
-            if (objmem == ctx->gl)
+            /* an unmarked file is closed by the sweep */
+            ret = _xpost_garbage_mark_ent(objmem, ent);
+            if (!ret)
             {
-                printf("file found in global vm\n");
-            } else {
-                ret = _xpost_garbage_mark_ent(objmem, o.mark_.padw);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot mark file");
-                    return 0;
-                }
+                XPOST_LOG_ERR("cannot mark file");
+                return 0;
             }
             break;
     }
@@ -397,15 +434,57 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
     return 1;
 }
 
+/* traverse up to count queued objects, or until the mark stack is empty */
+static
+int _xpost_garbage_mark_drain(Xpost_Context *ctx, int markall, unsigned int count)
+{
+    for ( ; count && _xpost_garbage_mark_stack_top; count--)
+    {
+        markrec rec = _xpost_garbage_mark_stack_data[--_xpost_garbage_mark_stack_top];
+        Xpost_Memory_Table_Entry *te = xpost_memory_table_entry(&rec.mem->table, rec.ent);
+
+        /* freed since it was queued, by restore */
+        if (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK)
+            continue;
+
+        if (_xpost_garbage_mark_stack_top)
+        {
+            markrec *next = &_xpost_garbage_mark_stack_data[_xpost_garbage_mark_stack_top - 1];
+            XPOST_GARBAGE_PREFETCH(next->mem->base +
+                    xpost_memory_table_entry(&next->mem->table, next->ent)->adr);
+        }
+
+        if (rec.type == dicttype)
+        {
+            if (!_xpost_garbage_mark_dict(ctx, rec.mem, te->adr, markall))
+                return 0;
+        }
+        else
+        {
+            /* mark the whole allocation: the object may have been a subarray */
+            if (!_xpost_garbage_mark_array(ctx, rec.mem, te->adr,
+                        te->used / sizeof(Xpost_Object), markall))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* traverse the queued objects until the mark stack is empty */
+static
+int _xpost_garbage_mark_all(Xpost_Context *ctx, int markall)
+{
+    return _xpost_garbage_mark_drain(ctx, markall, UINT_MAX);
+}
+
 
-/* mark all names in stack except 0::BOGUSNAME */
+/* shade all names in stack except 0::BOGUSNAME */
 static
 int _xpost_garbage_mark_names(Xpost_Context *ctx,
                               Xpost_Memory_File *mem,
                               unsigned int stackadr,
                               int markall)
 {
-    int start = 1;
     if (!mem) return 0;
 
     {
@@ -416,19 +495,10 @@ int _xpost_garbage_mark_names(Xpost_Context *ctx,
         printf("marking stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-next:
-        for (i = start; i < s->top; i++)
-        {
-            if (!_xpost_garbage_mark_object(ctx, mem, s->data[i], markall))
-                return 0;
-        }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
+        for (i = 1; i < s->top; i++)
         {
-            if (s->nextseg == 0)
+            if (!_xpost_garbage_shade_object(ctx, mem, XPOST_STACK_DATA(mem, s)[i], markall))
                 return 0;
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            start = 0;
-            goto next;
         }
     }
 
@@ -436,7 +506,7 @@ next:
 }
 
 
-/* mark all allocations referred to by objects in stack */
+/* shade all allocations referred to by objects in stack */
 static
 int _xpost_garbage_mark_stack(Xpost_Context *ctx,
                               Xpost_Memory_File *mem,
@@ -453,37 +523,33 @@ int _xpost_garbage_mark_stack(Xpost_Context *ctx,
         printf("marking stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-next:
         for (i = 0; i < s->top; i++)
         {
             Xpost_Memory_File *objmem;
-            objmem = xpost_context_select_memory(ctx, s->data[i]);
+            Xpost_Object o = XPOST_STACK_DATA(mem, s)[i];
+            objmem = xpost_context_select_memory(ctx, o);
             if (objmem == mem || markall)
-                if (!_xpost_garbage_mark_object(ctx, objmem, s->data[i], markall))
+                if (!_xpost_garbage_shade_object(ctx, objmem, o, markall))
                     return 0;
         }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
-        {
-            if (s->nextseg == 0)
-                return 0;
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            goto next;
-        }
     }
 
     return 1;
 }
 
-/* mark all allocations referred to by objects in save object's stack of saverec_'s */
+/* mark the saved allocations in save object's stack of saverec_'s
+   and shade their contents */
 static
 int _xpost_garbage_mark_save_stack(Xpost_Context *ctx,
                                    Xpost_Memory_File *mem,
-                                   unsigned int stackadr)
+                                   unsigned int stackadr,
+                                   int markall)
 {
     if (!mem) return 0;
 
     {
         Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+        Xpost_Object *data = XPOST_STACK_DATA(mem, s);
         unsigned int i;
         unsigned int ad;
         int ret;
@@ -493,72 +559,82 @@ int _xpost_garbage_mark_save_stack(Xpost_Context *ctx,
         printf("marking saverec stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-next:
         for (i = 0; i < s->top; i++)
         {
-            /* _xpost_garbage_mark_object(ctx, mem, s->data[i]); */
-            /* _xpost_garbage_mark_save_stack(ctx, mem, s->data[i].save_.stk); */
-            ret = _xpost_garbage_mark_ent(mem, s->data[i].saverec_.src);
+            /* _xpost_garbage_mark_object(ctx, mem, data[i]); */
+            /* _xpost_garbage_mark_save_stack(ctx, mem, data[i].save_.stk); */
+            ret = _xpost_garbage_mark_ent(mem, data[i].saverec_.src);
             if (!ret)
             {
                 XPOST_LOG_ERR("cannot mark array");
                 return 0;
             }
-            ret = _xpost_garbage_mark_ent(mem, s->data[i].saverec_.cpy);
+            ret = _xpost_garbage_mark_ent(mem, data[i].saverec_.cpy);
             if (!ret)
             {
                 XPOST_LOG_ERR("cannot mark array");
                 return 0;
             }
-            if (s->data[i].saverec_.tag == dicttype)
+            if (data[i].saverec_.tag == dicttype)
             {
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.src, &ad);
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.src, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for ent %u",
-                                  s->data[i].saverec_.src);
+                                  data[i].saverec_.src);
                     return 0;
                 }
-                if (!_xpost_garbage_mark_dict(ctx, mem, ad, 0))
+                if (!_xpost_garbage_mark_dict(ctx, mem, ad, markall))
                     return 0;
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.cpy, &ad);
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.cpy, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for ent %u",
-                                  s->data[i].saverec_.cpy);
+                                  data[i].saverec_.cpy);
                     return 0;
                 }
-                if (!_xpost_garbage_mark_dict(ctx, mem, ad, 0))
+                if (!_xpost_garbage_mark_dict(ctx, mem, ad, markall))
                     return 0;
             }
-            if (s->data[i].saverec_.tag == arraytype)
+            if (data[i].saverec_.tag == (arraytype | XPOST_SAVE_REC_PAGE))
             {
-                unsigned int sz = s->data[i].saverec_.pad;
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.src, &ad);
+                /* the whole source, and the page saved from it */
+                unsigned int ents[2];
+                unsigned int k;
+
+                ents[0] = data[i].saverec_.src;
+                ents[1] = data[i].saverec_.cpy;
+                for (k = 0; k < 2; k++)
+                {
+                    Xpost_Memory_Table_Entry *te = xpost_memory_table_entry(&mem->table, ents[k]);
+                    if (!_xpost_garbage_mark_array(ctx, mem, te->adr,
+                                te->used / sizeof(Xpost_Object), markall))
+                        return 0;
+                }
+            }
+            if (data[i].saverec_.tag == arraytype)
+            {
+                unsigned int sz = data[i].saverec_.pad;
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.src, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for array ent %u",
-                                  s->data[i].saverec_.src);
+                                  data[i].saverec_.src);
                     return 0;
                 }
-                if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, 0))
+                if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, markall))
                     return 0;
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.cpy, &ad);
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.cpy, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for array ent %u",
-                                  s->data[i].saverec_.cpy);
+                                  data[i].saverec_.cpy);
                     return 0;
                 }
-                if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, 0))
+                if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, markall))
                     return 0;
             }
         }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
-        {
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            goto next;
-        }
     }
 
     return 1;
@@ -568,119 +644,343 @@ next:
 static
 int _xpost_garbage_mark_save(Xpost_Context *ctx,
                              Xpost_Memory_File *mem,
-                             unsigned int stackadr)
+                             unsigned int stackadr,
+                             int markall)
 {
     if (!mem) return 0;
     {
 
         Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+        Xpost_Object *data = XPOST_STACK_DATA(mem, s);
         unsigned int i;
 
 #ifdef DEBUG_GC
         printf("marking save stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-    next:
         for (i = 0; i < s->top; i++)
         {
-            /* _xpost_garbage_mark_object(ctx, mem, s->data[i]); */
-            if (!_xpost_garbage_mark_save_stack(ctx, mem, s->data[i].save_.stk))
+            /* _xpost_garbage_mark_object(ctx, mem, data[i]); */
+            if (!_xpost_garbage_mark_save_stack(ctx, mem, data[i].save_.stk, markall))
                 return 0;
         }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
-        {
-            s = (void *)(mem->base + s->nextseg);
-            goto next;
-        }
     }
     return 1;
 }
 
-/* discard the free list.
-   iterate through tables,
-        if element is unmarked and not zero-sized,
-            free it.
-   return reclaimed size
+/* an allocation in address order, for compaction */
+typedef struct
+{
+    unsigned int adr;
+    unsigned int ent;
+} compactrec;
+
+/* order compactrecs by address */
+static
+int _xpost_garbage_compactrec_cmp(const void *left, const void *right)
+{
+    const compactrec *l = left;
+    const compactrec *r = right;
+    return l->adr < r->adr ? -1 : l->adr > r->adr;
+}
+
+/* is this ent on the free list? */
+static
+int _xpost_garbage_ent_is_free(Xpost_Memory_File *mem,
+                               unsigned int ent)
+{
+    return ent >= mem->start &&
+        (xpost_memory_table_entry(&mem->table, ent)->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK);
+}
+
+/* slide live allocations down over the free ones.
+   must follow a complete sweep, so every garbage ent is on the free list.
+
+   memory which is not owned by any ent (stack segments, the name tree,
+   operator signatures) and the ents below mem->start cannot be moved,
+   so each run of allocations between these is compacted separately.
+   the space left at the end of each run is given to one of the freed
+   ents and put back on the free list; the rest of the freed ents
+   no longer have any memory. if the last run reaches the end of the
+   memory file, mem->used shrinks instead and the pages are returned.
+
+   returns the number of bytes moved to the end of the memory file.
  */
 static
-unsigned int _xpost_garbage_sweep(Xpost_Memory_File *mem)
+unsigned int _xpost_garbage_compact(Xpost_Memory_File *mem)
 {
-    unsigned int zero = 0;
-    unsigned int z;
+    Xpost_Memory_Table *tab = &mem->table;
+    compactrec *recs;
+    unsigned int *spare;
+    unsigned int nspare = 0;
+    unsigned int n = 0;
+    unsigned int freesz = 0;
+    unsigned int dst;
+    unsigned int end;
+    unsigned int oldused = mem->used;
     unsigned int i;
-    unsigned int sz = 0;
-    int ret;
 
-    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z); /* address of the free list head */
-    if (!ret)
+    for (i = 1; i < tab->nextent; i++)
+    {
+        /* the nursery is emptied by minor collections, not moved */
+        if (xpost_memory_table_entry(tab, i)->sz == 0 ||
+            XPOST_MEMORY_IS_YOUNG(mem, xpost_memory_table_entry(tab, i)->adr))
+            continue;
+        ++n;
+        if (_xpost_garbage_ent_is_free(mem, i))
+            freesz += xpost_memory_table_entry(tab, i)->sz;
+    }
+    if (freesz * XPOST_GARBAGE_COMPACT_RATIO < mem->used)
+        return 0;
+
+    recs = malloc(n * sizeof *recs);
+    spare = malloc(n * sizeof *spare);
+    if (!recs || !spare)
     {
-        XPOST_LOG_ERR("cannot load free list head");
+        XPOST_LOG_ERR("cannot allocate compaction table");
+        free(recs);
+        free(spare);
         return 0;
     }
+    for (i = 1, n = 0; i < tab->nextent; i++)
+    {
+        if (xpost_memory_table_entry(tab, i)->sz == 0 ||
+            XPOST_MEMORY_IS_YOUNG(mem, xpost_memory_table_entry(tab, i)->adr))
+            continue;
+        recs[n].adr = xpost_memory_table_entry(tab, i)->adr;
+        recs[n].ent = i;
+        ++n;
+    }
+    qsort(recs, n, sizeof *recs, _xpost_garbage_compactrec_cmp);
 
-    memcpy(mem->base+z, &zero, sizeof(unsigned int)); /* discard list */
-    /* *(unsigned int *)(mem->base+z) = 0; */
+    for (i = 1; i < n; i++)
+    {
+        if (recs[i].adr < recs[i-1].adr + xpost_memory_table_entry(tab, recs[i-1].ent)->sz)
+        {
+            XPOST_LOG_ERR("ent %u overlaps ent %u, cannot compact",
+                          recs[i].ent, recs[i-1].ent);
+            free(recs);
+            free(spare);
+            return 0;
+        }
+    }
 
-#ifdef DEBUG_GC
-    printf("freeing ");
-#endif
-    /* scan table */
-    for (i = mem->start; i < mem->table.nextent; i++)
+    if (!xpost_free_discard(mem))
+    {
+        free(recs);
+        free(spare);
+        return 0;
+    }
+
+    dst = end = n ? recs[0].adr : 0;
+    for (i = 0; i <= n; i++)
     {
-        if (((mem->table.tab[i].mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK) == 0) &&
-            (mem->table.tab[i].sz != 0))
+        unsigned int ent = i < n ? recs[i].ent : 0;
+        unsigned int adr = i < n ? recs[i].adr : mem->used;
+        unsigned int sz = i < n ? xpost_memory_table_entry(tab, ent)->sz : 0;
+
+        if (i == n || adr != end || ent < mem->start)
         {
-#ifdef DEBUG_GC
-            printf("%u ", i);
-#endif
-            if (mem->table.tab[i].tag == filetype)
+            /* unmovable memory follows: close the current run */
+            if (i == n && adr == end)
+            {
+                mem->used = dst;
+            }
+            else if (end > dst)
+            {
+                unsigned int e = spare[--nspare];
+                xpost_memory_table_entry(tab, e)->adr = dst;
+                xpost_memory_table_entry(tab, e)->sz = end - dst;
+                xpost_memory_table_entry(tab, e)->mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK;
+                (void) xpost_free_memory_ent(mem, e);
+                /* keep the free list links, release the rest */
+                (void) xpost_memory_file_discard(mem,
+                        dst + 2 * sizeof(unsigned int),
+                        end - dst - 2 * sizeof(unsigned int));
+            }
+            if (i == n)
+                break;
+            if (ent < mem->start)
+            {
+                dst = end = adr + sz;
                 continue;
-            ret = xpost_free_memory_ent(mem, i);
-            if (ret < 0)
+            }
+            dst = end = adr;
+        }
+
+        if (_xpost_garbage_ent_is_free(mem, ent))
+        {
+            spare[nspare++] = ent;
+        }
+        else
+        {
+            if (dst != adr)
             {
-                XPOST_LOG_ERR("cannot free ent");
-                return sz;
+                memmove(mem->base + dst, mem->base + adr, sz);
+                xpost_memory_table_entry(tab, ent)->adr = dst;
             }
-            sz += (unsigned int)ret;
+            dst += sz;
         }
+        end = adr + sz;
+    }
+
+    while (nspare)
+        (void) xpost_free_release_ent(mem, spare[--nspare]);
+    /* everything has moved: no save level can be cut back to */
+    for (i = 0; i < mem->nsave_marks; i++)
+        mem->save_marks[i].spoiled = 1;
+
+    free(recs);
+    free(spare);
+
+    XPOST_LOG_INFO("compacted %s from %u to %u bytes",
+                   mem->fname, oldused, mem->used);
+    if (mem->used < oldused)
+        (void) xpost_memory_file_shrink(mem);
+    return oldused - mem->used;
+}
+
+/* mark the save stack and the name stack of a vm */
+static
+int _xpost_garbage_mark_vm(Xpost_Context *ctx,
+                           Xpost_Memory_File *mem,
+                           int markall)
+{
+    unsigned int ad;
+    int ret;
+
+    ret = xpost_memory_table_get_addr(mem,
+                                      XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &ad);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot load save stack for %s memory",
+                      mem == ctx->gl ? "global" : "local");
+        return 0;
     }
+    if (!_xpost_garbage_mark_save(ctx, mem, ad, markall))
+        return 0;
+    ret = xpost_memory_table_get_addr(mem,
+                                      XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &ad);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot load name stack for %s memory",
+                      mem == ctx->gl ? "global" : "local");
+        return 0;
+    }
+#ifdef DEBUG_GC
+    printf("marking name stack\n");
+#endif
+    return _xpost_garbage_mark_names(ctx, mem, ad, markall);
+}
+
+/* mark the roots held by a context: its stacks, which live in
+   its local vm, and the objects it refers to directly */
+static
+int _xpost_garbage_mark_context(Xpost_Context *ctx,
+                                Xpost_Memory_File *mem,
+                                int markall)
+{
+#ifdef DEBUG_GC
+    printf("marking os\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->os, markall))
+        return 0;
+
 #ifdef DEBUG_GC
-    printf("\n");
+    printf("marking ds\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->ds, markall))
+        return 0;
+
+#ifdef DEBUG_GC
+    printf("marking es\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->es, markall))
+        return 0;
+
+#ifdef DEBUG_GC
+    printf("marking hold\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->hold, markall))
+        return 0;
+#ifdef DEBUG_GC
+    printf("marking window device\n");
+#endif
+    if (!_xpost_garbage_shade_object(ctx, mem, ctx->window_device, markall))
+        return 0;
+#if 0
+#ifdef DEBUG_GC
+    printf("marking event handler\n");
+#endif
+    if (!_xpost_garbage_shade_object(ctx, mem, ctx->event_handler, markall))
+        return 0;
 #endif
+    return 1;
+}
 
-    return sz;
+/* the allocation volume that should trigger the next collection of mem */
+static
+unsigned int _xpost_garbage_threshold(const Xpost_Memory_File *mem)
+{
+    unsigned long threshold;
+
+    threshold = (unsigned long)mem->gc.live * mem->gc.scale / 100;
+    if (threshold < mem->vmthreshold)
+        threshold = mem->vmthreshold;
+    threshold *= mem->threshold_ratio;
+    if (threshold > XPOST_GARBAGE_COLLECTION_THRESHOLD_MAX)
+        threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD_MAX;
+    return (unsigned int)threshold;
 }
 
 /*
-   determine GLOBAL/LOCAL
-   clear all marks,
-   mark all root stacks,
-   sweep.
-   return reclaimed size or -1 if error occured.
+   record the results of a collection and set the allocation
+   volume that triggers the next one.
+   if little of what was allocated could be reclaimed, the live
+   data is mostly long-lived and collecting sooner is wasted work,
+   so the threshold grows relative to the live size;
+   if nearly all of it was garbage, the threshold shrinks back.
  */
-int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
+static
+void _xpost_garbage_tune(Xpost_Memory_File *mem)
+{
+    Xpost_Memory_Gc_Stats *gc = &mem->gc;
+
+    ++gc->collections;
+
+    if (gc->allocated)
+    {
+        if (gc->reclaimed < gc->allocated / 4 &&
+            gc->scale < XPOST_GARBAGE_COLLECTION_SCALE_MAX)
+            gc->scale *= 2;
+        else if (gc->reclaimed > gc->allocated / 4 * 3 &&
+                 gc->scale > XPOST_GARBAGE_COLLECTION_SCALE_MIN)
+            gc->scale /= 2;
+    }
+
+    mem->threshold = _xpost_garbage_threshold(mem);
+}
+
+/* find a running context using mem, preferring one
+   for which mem is the global vm. returns NULL if none */
+static
+Xpost_Context *_xpost_garbage_context(Xpost_Memory_File *mem,
+                                      unsigned int **cidp,
+                                      int *isglobal)
 {
     unsigned int i;
     unsigned int *cid;
     Xpost_Context *ctx = NULL;
-    int isglobal;
-    unsigned int sz = 0;
     unsigned int ad;
     int ret;
 
-    if (mem->interpreter_get_initializing()) /* do not collect while initializing */
-        return 0;
-
-    /* printf("\ncollect:\n"); */
-
-    /* determine global/local */
-    isglobal = 0;
+    *isglobal = 0;
     ret = xpost_memory_table_get_addr(mem,
                                       XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST, &ad);
     if (!ret)
     {
         XPOST_LOG_ERR("cannot load context list");
-        return -1;
+        return NULL;
     }
     cid = (void *)(mem->base + ad);
     for (i = 0; i < MAXCONTEXT && cid[i]; i++)
@@ -690,7 +990,7 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
         {
             if (mem == ctx->gl)
             {
-                isglobal = 1;
+                *isglobal = 1;
                 break;
             }
         }
@@ -698,136 +998,774 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
     if (ctx == NULL)
     {
         XPOST_LOG_ERR("cannot find context");
-        return -1;
+        return NULL;
     }
-#ifdef DEBUG_GC
-    printf("using cid=%d\n", ctx->id);
-#endif
+    if (cidp)
+        *cidp = cid;
+    return ctx;
+}
 
-    if (isglobal)
+/* empty the nursery and put its memory on the free list,
+   so that compaction can slide the heap over it.
+   it is made again by the next young allocation. */
+static
+void _xpost_garbage_nursery_dissolve(Xpost_Memory_File *mem)
+{
+    unsigned int ent;
+
+    if (!mem->nursery_limit || !xpost_garbage_collect_nursery(mem) ||
+        mem->nursery_top != mem->nursery_base)
+        return;
+    if (!xpost_memory_table_alloc_ent(mem, mem->nursery_base,
+                mem->nursery_limit - mem->nursery_base, 0, &ent))
+        return;
+    mem->nursery_base = mem->nursery_top = mem->nursery_limit = 0;
+    (void) xpost_free_memory_ent(mem, ent);
+}
+
+/* close the files queued by the sweep and free their ents */
+static
+void _xpost_garbage_finalize(Xpost_Memory_File *mem)
+{
+    Xpost_Object f;
+    unsigned int i;
+    int ret;
+
+    f.tag = filetype;
+    for (i = 0; i < mem->nfinalize; i++)
     {
-        dosweep = 0;
-        return 0; /* do not perform global collections at this time */
+        f.mark_.padw = mem->finalize[i];
+#ifdef DEBUG_FILE
+        printf("gc: finalizing file ent %u\n", f.mark_.padw);
+#endif
+        if (xpost_file_get_file_pointer(mem, f))
+            ++mem->gc.finalized;
+        (void) xpost_file_object_close(mem, f);
+        ret = xpost_free_memory_ent(mem, f.mark_.padw);
+        if (ret < 0)
+        {
+            XPOST_LOG_ERR("cannot free ent %u", f.mark_.padw);
+            continue;
+        }
+        mem->gc.reclaimed += (unsigned int)ret;
+    }
+    mem->nfinalize = 0;
+}
 
-        _xpost_garbage_unmark(mem);
+/* the sweep of mem is complete:
+   close unreachable files, compact a local vm,
+   adjust the threshold and report. */
+static
+void _xpost_garbage_sweep_done(Xpost_Memory_File *mem)
+{
+    long long t = xpost_get_usertime_us();
+    int isglobal;
+
+    mem->sweep_limit = 0;
+    _xpost_garbage_finalize(mem);
+    /* the local vms are left to their own collections */
+    if (_xpost_garbage_context(mem, NULL, &isglobal) && !isglobal)
+    {
+        _xpost_garbage_nursery_dissolve(mem);
+        (void) _xpost_garbage_compact(mem);
+    }
+    _xpost_garbage_tune(mem);
+    ++mem->stats.collections;
+    mem->stats.reclaimed += mem->gc.reclaimed;
+    mem->stats.sweep_us += xpost_get_usertime_us() - t;
+
+    XPOST_LOG_INFO("collect recovered %u bytes, %u live, closed %u files",
+                   mem->gc.reclaimed, mem->gc.live, mem->gc.finalized);
+}
+
+/* continue the pending sweep of mem by count ents,
+   finishing the collection if the sweep is complete */
+int xpost_garbage_sweep(Xpost_Memory_File *mem, unsigned int count)
+{
+    if (!mem->sweep_limit)
+        return 1;
+    if (!xpost_free_sweep(mem, count))
+        return 0;
+    _xpost_garbage_sweep_done(mem);
+    return 1;
+}
+
+/* finish the pending sweep of mem, if any */
+int xpost_garbage_sweep_finish(Xpost_Memory_File *mem)
+{
+    if (!mem) return 0;
+    return xpost_garbage_sweep(mem, mem->table.nextent);
+}
+
+/* set the VMThreshold of mem, or restore the default if threshold is -1 */
+int xpost_garbage_set_threshold(Xpost_Memory_File *mem, int threshold)
+{
+    if (threshold < 0)
+        threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
+    if (threshold < XPOST_GARBAGE_COLLECTION_THRESHOLD_MIN)
+        threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD_MIN;
+    mem->vmthreshold = (unsigned int)threshold;
+    mem->threshold = _xpost_garbage_threshold(mem);
+    return 1;
+}
 
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &ad);
-        if (!ret)
+/* start the lazy sweep of a marked vm */
+static
+void _xpost_garbage_sweep_start(Xpost_Memory_File *mem)
+{
+#ifdef DEBUG_GC
+    printf("sweep\n");
+#endif
+    mem->gc.allocated = mem->allocated;
+    /* what restore cut back was allocated and reclaimed all the same */
+    mem->gc.reclaimed = mem->gc.cut;
+    mem->gc.cut = 0;
+    mem->gc.live = 0;
+    mem->gc.finalized = 0;
+    mem->allocated = 0;
+    mem->sweep = mem->start;
+    mem->sweep_limit = mem->table.nextent;
+}
+
+/* write barrier: shade an object stored into mem during incremental marking */
+void xpost_garbage_shade(Xpost_Memory_File *mem, Xpost_Object o)
+{
+    Xpost_Memory_Table_Entry *te;
+    unsigned int ent;
+    Xpost_Object_Type type;
+
+    if (!mem->marking)
+        return;
+    /* only a local vm is marked incrementally */
+    if (o.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK)
+        return;
+
+    type = xpost_object_get_type(o);
+    if (type == filetype)
+        ent = o.mark_.padw;
+    else if (type == arraytype || type == dicttype || type == stringtype)
+        ent = xpost_object_get_ent(o);
+    else
+        return;
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return;
+    te = xpost_memory_table_entry(&mem->table, ent);
+    if (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK)
+        return;
+    te->mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+    if (type == arraytype || type == dicttype)
+        (void) _xpost_garbage_mark_stack_push(mem, ent, type);
+}
+
+/* queue the contents of ent to be traversed again
+   after they were replaced behind the write barrier's back */
+void xpost_garbage_rescan(Xpost_Memory_File *mem,
+                          unsigned int ent,
+                          unsigned int type)
+{
+    if (!mem->marking || (type != arraytype && type != dicttype))
+        return;
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return;
+    xpost_memory_table_entry(&mem->table, ent)->mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+    (void) _xpost_garbage_mark_stack_push(mem, ent, type);
+}
+
+/* write barrier for the nursery: remember ent if o is young */
+void xpost_garbage_remember(Xpost_Memory_File *mem,
+                            unsigned int ent,
+                            Xpost_Object o)
+{
+    Xpost_Object_Type type = xpost_object_get_type(o);
+    unsigned int oent;
+
+    if (type != arraytype && type != dicttype)
+        return;
+    if (o.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK)
+        return;
+    oent = xpost_object_get_ent(o);
+    if (oent < mem->start || oent >= mem->table.nextent ||
+        !XPOST_MEMORY_IS_YOUNG(mem, xpost_memory_table_entry(&mem->table, oent)->adr))
+        return;
+    if (ent < mem->start || ent >= mem->table.nextent ||
+        XPOST_MEMORY_IS_YOUNG(mem, xpost_memory_table_entry(&mem->table, ent)->adr))
+        return;
+    xpost_garbage_remember_ent(mem, ent);
+}
+
+/* add ent to the remembered set.
+   its contents are traversed by the next minor collection,
+   and if it has storage in the nursery, it survives. */
+void xpost_garbage_remember_ent(Xpost_Memory_File *mem,
+                                unsigned int ent)
+{
+    Xpost_Memory_Table_Entry *te;
+
+    if (!mem->nursery_limit || ent < mem->start || ent >= mem->table.nextent)
+        return;
+    te = xpost_memory_table_entry(&mem->table, ent);
+    if (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK)
+        return;
+    if (mem->nremembered == mem->remembered_max)
+    {
+        unsigned int max = mem->remembered_max ? mem->remembered_max * 2 : 256;
+        unsigned int *tmp = realloc(mem->remembered, max * sizeof *tmp);
+        if (!tmp)
         {
-            XPOST_LOG_ERR("cannot load save stack for global memory");
-            return -1;
+            /* without the remembered set, nothing may leave the nursery */
+            XPOST_LOG_ERR("cannot grow remembered set to %u entries, disabling nursery", max);
+            mem->nursery_size = 0;
+            return;
         }
-        if (!_xpost_garbage_mark_save(ctx, mem, ad))
-            return -1;
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &ad);
-        if (!ret)
+        mem->remembered = tmp;
+        mem->remembered_max = max;
+    }
+    te->mark |= XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK;
+    mem->remembered[mem->nremembered++] = ent;
+}
+
+/* move a young array or dict out of the nursery
+   and queue its contents to be traversed */
+static
+int _xpost_garbage_nursery_keep(Xpost_Memory_File *mem,
+                                Xpost_Object o)
+{
+    Xpost_Object_Type type = xpost_object_get_type(o);
+    Xpost_Memory_Table_Entry *te;
+    unsigned int ent;
+
+    if (type != arraytype && type != dicttype)
+        return 1;
+    if (o.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK)
+        return 1;
+    ent = xpost_object_get_ent(o);
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return 1;
+    te = xpost_memory_table_entry(&mem->table, ent);
+    if (te->sz == 0 || !XPOST_MEMORY_IS_YOUNG(mem, te->adr))
+        return 1;
+    if (!xpost_free_move_ent(mem, ent))
+        return 0;
+    return _xpost_garbage_mark_stack_push(mem, ent, type);
+}
+
+/* queue the contents of an array or dict which is a root of
+   a minor collection, moving it out of the nursery if it is young */
+static
+int _xpost_garbage_nursery_root(Xpost_Memory_File *mem,
+                                unsigned int ent,
+                                unsigned int type)
+{
+    Xpost_Memory_Table_Entry *te;
+
+    if (type != arraytype && type != dicttype)
+        return 1;
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return 1;
+    te = xpost_memory_table_entry(&mem->table, ent);
+    if (te->sz == 0 || (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK))
+        return 1;
+    if (XPOST_MEMORY_IS_YOUNG(mem, te->adr) && !xpost_free_move_ent(mem, ent))
+        return 0;
+    return _xpost_garbage_mark_stack_push(mem, ent, type);
+}
+
+/* keep the young objects on a stack.
+   the stack is addressed by offset: moving may grow the memory file */
+static
+int _xpost_garbage_nursery_stack(Xpost_Memory_File *mem,
+                                 unsigned int stackadr)
+{
+    unsigned int top = ((Xpost_Stack *)(mem->base + stackadr))->top;
+    unsigned int i;
+
+    for (i = 0; i < top; i++)
+        if (!_xpost_garbage_nursery_keep(mem,
+                    XPOST_STACK_DATA(mem, (Xpost_Stack *)(mem->base + stackadr))[i]))
+            return 0;
+    return 1;
+}
+
+/* treat the saved and the saving copies of every save record as roots:
+   restore exchanges their contents */
+static
+int _xpost_garbage_nursery_save(Xpost_Memory_File *mem)
+{
+    unsigned int stackadr;
+    unsigned int recadr;
+    unsigned int top;
+    unsigned int rtop;
+    unsigned int i;
+    unsigned int j;
+    Xpost_Object rec;
+
+    if (!xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &stackadr))
+        return 0;
+    top = ((Xpost_Stack *)(mem->base + stackadr))->top;
+    for (i = 0; i < top; i++)
+    {
+        recadr = XPOST_STACK_DATA(mem, (Xpost_Stack *)(mem->base + stackadr))[i].save_.stk;
+        rtop = ((Xpost_Stack *)(mem->base + recadr))->top;
+        for (j = 0; j < rtop; j++)
         {
-            XPOST_LOG_ERR("cannot load name stack for global memory");
-            return -1;
+            rec = XPOST_STACK_DATA(mem, (Xpost_Stack *)(mem->base + recadr))[j];
+            rec.saverec_.tag &= ~XPOST_SAVE_REC_PAGE;
+            if (!_xpost_garbage_nursery_root(mem, rec.saverec_.src, rec.saverec_.tag) ||
+                !_xpost_garbage_nursery_root(mem, rec.saverec_.cpy, rec.saverec_.tag))
+                return 0;
         }
-        if (!_xpost_garbage_mark_names(ctx, mem, ad, markall))
-            return -1;
+    }
+    return 1;
+}
 
-        for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+/* keep the young objects referred to by the contents of ent */
+static
+int _xpost_garbage_nursery_scan(Xpost_Memory_File *mem,
+                                unsigned int ent,
+                                unsigned int type)
+{
+    unsigned int adr = xpost_memory_table_entry(&mem->table, ent)->adr;
+    unsigned int n;
+    unsigned int j;
+
+    if (type == dicttype)
+    {
+        n = DICTABN(((dichead *)(mem->base + adr))->sz);
+        for (j = 0; j < n; j++)
         {
-            ctx = mem->interpreter_cid_get_context(cid[i]);
-            xpost_garbage_collect(ctx->lo, 0, markall);
+            dicrec *r = (dicrec *)(mem->base + adr + sizeof(dichead)) + j;
+            Xpost_Object v = r->value;
+
+            if (xpost_object_get_type(r->key) == nulltype)
+                continue;
+            if (!_xpost_garbage_nursery_keep(mem, r->key) ||
+                !_xpost_garbage_nursery_keep(mem, v))
+                return 0;
         }
+    }
+    else
+    {
+        n = xpost_memory_table_entry(&mem->table, ent)->used / sizeof(Xpost_Object);
+        for (j = 0; j < n; j++)
+            if (!_xpost_garbage_nursery_keep(mem,
+                        ((Xpost_Object *)(mem->base + adr))[j]))
+                return 0;
+    }
+    return 1;
+}
+
+/* move a young object stored into global vm out of the nursery at once,
+   with the young objects it refers to: minor collections do not
+   traverse global vm. the mark stack is used above any gray objects
+   of an incremental marking. */
+int xpost_garbage_promote(Xpost_Memory_File *mem, Xpost_Object o)
+{
+    unsigned int bottom = _xpost_garbage_mark_stack_top;
+    int ret;
 
+    ret = _xpost_garbage_nursery_keep(mem, o);
+    while (ret && _xpost_garbage_mark_stack_top > bottom)
+    {
+        markrec rec = _xpost_garbage_mark_stack_data[--_xpost_garbage_mark_stack_top];
+        ret = _xpost_garbage_nursery_scan(mem, rec.ent, rec.type);
     }
-    else /* local */
+    _xpost_garbage_mark_stack_top = bottom;
+    if (!ret)
     {
-        //printf("collect!\n");
-        _xpost_garbage_unmark(mem);
-        if (markall)
-            _xpost_garbage_unmark(ctx->gl);
+        XPOST_LOG_ERR("cannot move object out of the nursery of %s, disabling nursery",
+                      mem->fname);
+        mem->nursery_size = 0;
+    }
+    return ret;
+}
 
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &ad);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot load save stack for local memory");
-            return -1;
-        }
-        if (!_xpost_garbage_mark_save(ctx, mem, ad))
-            return -1;
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &ad);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot load name stack for local memory");
+/* minor collection: move the reachable young objects out of the
+   nursery, release the ents of the rest and empty it */
+int xpost_garbage_collect_nursery(Xpost_Memory_File *mem)
+{
+    Xpost_Memory_Table_Entry *te;
+    Xpost_Context *ctx;
+    unsigned int *cid;
+    unsigned int cids[MAXCONTEXT];
+    unsigned int ncid;
+    unsigned int used = mem->nursery_top - mem->nursery_base;
+    unsigned int kept = mem->allocated;
+    unsigned int i;
+    long long t;
+    int isglobal;
+    int ret = 1;
+
+    if (!mem->nursery_limit || mem->marking || _xpost_garbage_marking_ctx)
+        return 1;
+    t = xpost_get_usertime_us();
+    ctx = _xpost_garbage_context(mem, &cid, &isglobal);
+    if (ctx == NULL || isglobal)
+        return 0;
+    /* the context list is in mem, which may grow */
+    for (ncid = 0; ncid < MAXCONTEXT && cid[ncid]; ncid++)
+        cids[ncid] = cid[ncid];
+
+    _xpost_garbage_mark_stack_top = 0;
+    for (i = 0; ret && i < ncid; i++)
+    {
+        ctx = mem->interpreter_cid_get_context(cids[i]);
+        if (ctx->lo != mem)
+            continue;
+        ret = _xpost_garbage_nursery_stack(mem, ctx->os) &&
+            _xpost_garbage_nursery_stack(mem, ctx->ds) &&
+            _xpost_garbage_nursery_stack(mem, ctx->es) &&
+            _xpost_garbage_nursery_stack(mem, ctx->hold) &&
+            _xpost_garbage_nursery_keep(mem, ctx->window_device) &&
+            _xpost_garbage_nursery_keep(mem, ctx->event_handler) &&
+            _xpost_garbage_nursery_keep(mem, ctx->currentobject);
+    }
+    if (ret)
+        ret = _xpost_garbage_nursery_save(mem);
+    for (i = 0; ret && i < mem->nremembered; i++)
+    {
+        unsigned int ent = mem->remembered[i];
+
+        if (ent >= mem->table.nextent)
+            continue;
+        ret = _xpost_garbage_nursery_root(mem, ent,
+                xpost_memory_table_entry(&mem->table, ent)->tag);
+    }
+    while (ret && _xpost_garbage_mark_stack_top)
+    {
+        markrec rec = _xpost_garbage_mark_stack_data[--_xpost_garbage_mark_stack_top];
+        ret = _xpost_garbage_nursery_scan(mem, rec.ent, rec.type);
+    }
+    _xpost_garbage_mark_stack_top = 0;
+
+    if (!ret)
+    {
+        /* survivors may remain in the nursery: stop using it */
+        XPOST_LOG_ERR("minor collection of %s failed, disabling nursery", mem->fname);
+        mem->nursery_size = 0;
+        return 0;
+    }
+
+    for (i = 0; i < mem->nremembered; i++)
+        if (mem->remembered[i] < mem->table.nextent)
+            xpost_memory_table_entry(&mem->table, mem->remembered[i])->mark &=
+                ~XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK;
+    mem->nremembered = 0;
+
+    /* whatever is still in the nursery is garbage */
+    for (i = 0; i < mem->nyoung; i++)
+    {
+        te = xpost_memory_table_entry(&mem->table, mem->young[i]);
+        if (te->sz != 0 && XPOST_MEMORY_IS_YOUNG(mem, te->adr))
+            (void) xpost_free_release_ent(mem, mem->young[i]);
+    }
+    mem->nyoung = 0;
+    mem->nursery_top = mem->nursery_base;
+
+    ++mem->stats.minor_collections;
+    mem->stats.reclaimed += used - (mem->allocated - kept);
+    mem->stats.minor_us += xpost_get_usertime_us() - t;
+    XPOST_LOG_INFO("minor collection of %s kept %u of %u bytes",
+                   mem->fname, mem->allocated - kept, used);
+    return 1;
+}
+
+/* is o an object of the local vm mem allocated since save level lev began:
+   an array or dict stamped with level lev or above, or any ent from nextent */
+static
+int _xpost_garbage_is_newer(Xpost_Memory_File *mem,
+                            Xpost_Object o,
+                            unsigned int lev,
+                            unsigned int nextent)
+{
+    Xpost_Object_Type type = xpost_object_get_type(o);
+    unsigned int ent;
+    unsigned int llev;
+
+    if (o.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK)
+        return 0;
+    if (type == filetype)
+        ent = o.mark_.padw;
+    else if (xpost_object_is_composite(o))
+        ent = xpost_object_get_ent(o);
+    else
+        return 0;
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return 0;
+    if (ent >= nextent)
+        return 1;
+    if (type != arraytype && type != dicttype)
+        return 0;
+    llev = (xpost_memory_table_entry(&mem->table, ent)->mark
+            & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET;
+    return llev >= lev;
+}
+
+/* does a stack in mem hold an object allocated since save level lev began,
+   or has its array been allocated at or after vm address used */
+static
+int _xpost_garbage_stack_has_newer(Xpost_Memory_File *mem,
+                                   unsigned int stackadr,
+                                   unsigned int lev,
+                                   unsigned int nextent,
+                                   unsigned int used)
+{
+    Xpost_Stack *s;
+    unsigned int i;
+
+    if (!xpost_stack_is_below(mem, stackadr, used))
+        return 1;
+    s = (Xpost_Stack *)(mem->base + stackadr);
+    for (i = 0; i < s->top; i++)
+        if (_xpost_garbage_is_newer(mem, XPOST_STACK_DATA(mem, s)[i], lev, nextent))
+            return 1;
+    return 0;
+}
+
+/* check the contexts using local vm mem for anything made since save level lev */
+int xpost_garbage_newer_in_use(Xpost_Memory_File *mem,
+                               unsigned int lev,
+                               unsigned int nextent,
+                               unsigned int used)
+{
+    Xpost_Context *ctx;
+    unsigned int *cid;
+    unsigned int i;
+    int isglobal;
+
+    if (mem->marking || _xpost_garbage_marking_ctx)
+        return 1;
+    ctx = _xpost_garbage_context(mem, &cid, &isglobal);
+    if (ctx == NULL || isglobal)
+        return 1;
+    for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+    {
+        ctx = mem->interpreter_cid_get_context(cid[i]);
+        if (ctx->lo != mem)
+            continue;
+        if (_xpost_garbage_stack_has_newer(mem, ctx->os, lev, nextent, used) ||
+            _xpost_garbage_stack_has_newer(mem, ctx->ds, lev, nextent, used) ||
+            _xpost_garbage_stack_has_newer(mem, ctx->es, lev, nextent, used) ||
+            _xpost_garbage_stack_has_newer(mem, ctx->hold, lev, nextent, used) ||
+            _xpost_garbage_is_newer(mem, ctx->window_device, lev, nextent) ||
+            _xpost_garbage_is_newer(mem, ctx->event_handler, lev, nextent) ||
+            _xpost_garbage_is_newer(mem, ctx->currentobject, lev, nextent))
+            return 1;
+    }
+    return 0;
+}
+
+/* free the arrays and dicts allocated above a restored save level */
+unsigned int xpost_garbage_free_newer(Xpost_Memory_File *mem,
+                                      unsigned int lev)
+{
+    Xpost_Memory_Table_Entry *te;
+    unsigned int freed = 0;
+    unsigned int ent;
+    int ret;
+
+    /* still in use: leave them to the collector */
+    if (xpost_garbage_newer_in_use(mem, lev, mem->table.nextent, mem->used))
+        return 0;
+
+    for (ent = mem->start; ent < mem->table.nextent; ent++)
+    {
+        te = xpost_memory_table_entry(&mem->table, ent);
+        if (te->sz == 0 || (te->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK) ||
+            (te->tag != arraytype && te->tag != dicttype))
+            continue;
+        if (((te->mark & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
+                    >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET) < lev)
+            continue;
+        ret = xpost_free_memory_ent(mem, ent);
+        if (ret > 0)
+            freed += (unsigned int)ret;
+    }
+    if (freed)
+        XPOST_LOG_INFO("restore freed %u bytes in %s", freed, mem->fname);
+    return freed;
+}
+
+/* complete the incremental marking under way and start the sweep.
+   the stacks are covered by the write barrier, but the window device
+   of each context is not, so it is shaded again first. */
+static
+int _xpost_garbage_mark_finish(void)
+{
+    Xpost_Context *ctx = _xpost_garbage_marking_ctx;
+    Xpost_Memory_File *mem;
+    unsigned int *cid;
+    unsigned int i;
+    int isglobal;
+    int ret = 1;
+
+    if (!ctx)
+        return 1;
+    mem = ctx->lo;
+
+    if (_xpost_garbage_context(mem, &cid, &isglobal))
+        for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+            if (!_xpost_garbage_shade_object(ctx, mem,
+                        mem->interpreter_cid_get_context(cid[i])->window_device, 0))
+                ret = 0;
+    if (ret && !_xpost_garbage_mark_all(ctx, 0))
+        ret = 0;
+
+    mem->marking = 0;
+    _xpost_garbage_marking_ctx = NULL;
+    _xpost_garbage_mark_stack_top = 0;
+    if (_xpost_garbage_mark_stack_max > XPOST_GARBAGE_MARK_STACK_SIZE)
+        _xpost_garbage_mark_stack_free();
+
+    if (!ret)
+    {
+        XPOST_LOG_ERR("incremental marking of %s failed", mem->fname);
+        return 0;
+    }
+    _xpost_garbage_sweep_start(mem);
+    return 1;
+}
+
+/* traverse up to count objects of the incremental marking of mem,
+   finishing the marking when there are none left */
+int xpost_garbage_mark_step(Xpost_Memory_File *mem, unsigned int count)
+{
+    Xpost_Context *ctx = _xpost_garbage_marking_ctx;
+    long long t;
+    int ret;
+
+    if (!mem->marking || !ctx || ctx->lo != mem)
+        return 1;
+    t = xpost_get_usertime_us();
+    if (!_xpost_garbage_mark_drain(ctx, 0, count))
+    {
+        XPOST_LOG_ERR("incremental marking of %s failed", mem->fname);
+        ret = _xpost_garbage_mark_finish();
+    }
+    else if (_xpost_garbage_mark_stack_top)
+        ret = 0;
+    else
+        ret = _xpost_garbage_mark_finish();
+    mem->stats.mark_us += xpost_get_usertime_us() - t;
+    return ret;
+}
+
+/*
+   determine GLOBAL/LOCAL
+   finish the previous sweep,
+   clear all marks,
+   mark all root stacks,
+   start the sweep.
+   if mem is a local vm with a mark budget, only shade the
+   roots and leave the marking to xpost_garbage_mark_step().
+   return 0 or -1 if error occured.
+ */
+static
+int _xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
+{
+    unsigned int i;
+    unsigned int *cid;
+    Xpost_Context *ctx;
+    int isglobal;
+    int incremental = 0;
+
+    if (mem->interpreter_get_initializing()) /* do not collect while initializing */
+        return 0;
+
+    /* the mark stack is in use by an incremental marking: finish it.
+       if that was a collection of mem, it only remains to be swept. */
+    if (_xpost_garbage_marking_ctx)
+    {
+        int same = _xpost_garbage_marking_ctx->lo == mem;
+
+        if (!_xpost_garbage_mark_finish())
             return -1;
-        }
+        if (same)
+            return 0;
+    }
+
+    _xpost_garbage_mark_stack_top = 0;
+
+    /* printf("\ncollect:\n"); */
+
+    /* determine global/local */
+    ctx = _xpost_garbage_context(mem, &cid, &isglobal);
+    if (ctx == NULL)
+        return -1;
 #ifdef DEBUG_GC
-        printf("marking name stack\n");
+    printf("using cid=%d\n", ctx->id);
 #endif
-        if (!_xpost_garbage_mark_names(ctx, mem, ad, markall))
+
+    if (isglobal)
+    {
+        /* global objects may be reachable only through local ones,
+           so every local vm sharing this global vm is traversed too */
+        _xpost_garbage_unmark(mem);
+        for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+            _xpost_garbage_unmark(mem->interpreter_cid_get_context(cid[i])->lo);
+
+        if (!_xpost_garbage_mark_vm(ctx, mem, 1))
             return -1;
 
         for (i = 0; i < MAXCONTEXT && cid[i]; i++)
         {
             ctx = mem->interpreter_cid_get_context(cid[i]);
-
-#ifdef DEBUG_GC
-            printf("marking os\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->os, markall))
+            if (!_xpost_garbage_mark_vm(ctx, ctx->lo, 1))
                 return -1;
-
-#ifdef DEBUG_GC
-            printf("marking ds\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->ds, markall))
+            if (!_xpost_garbage_mark_context(ctx, ctx->lo, 1))
                 return -1;
+        }
+    }
+    else /* local */
+    {
+        incremental = dosweep && mem->mark_budget;
+        if (incremental)
+            markall = 0;
 
-#ifdef DEBUG_GC
-            printf("marking es\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->es, markall))
-                return -1;
+        _xpost_garbage_unmark(mem);
+        if (markall)
+            _xpost_garbage_unmark(ctx->gl);
 
-#ifdef DEBUG_GC
-            printf("marking hold\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->hold, markall))
-                return -1;
-#ifdef DEBUG_GC
-            printf("marking window device\n");
-#endif
-            if (!_xpost_garbage_mark_object(ctx, mem, ctx->window_device, markall))
-                return -1;
-#if 0
-#ifdef DEBUG_GC
-            printf("marking event handler\n");
-#endif
-            if (!_xpost_garbage_mark_object(ctx, mem, ctx->event_handler, markall))
+        if (!_xpost_garbage_mark_vm(ctx, mem, markall))
+            return -1;
+
+        for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+        {
+            ctx = mem->interpreter_cid_get_context(cid[i]);
+            if (!_xpost_garbage_mark_context(ctx, mem, markall))
                 return -1;
-#endif
         }
-    }
 
-    if (dosweep) {
-#ifdef DEBUG_GC
-        printf("sweep\n");
-#endif
-        sz += _xpost_garbage_sweep(mem);
-        if (isglobal)
+        if (incremental)
         {
-            for (i = 0; i < MAXCONTEXT && cid[i]; i++)
-            {
-#ifdef DEBUG_GC
-                printf("sweep context(%d)->gl\n", cid[i]);
-#endif
-                ctx = mem->interpreter_cid_get_context(cid[i]);
-                sz += _xpost_garbage_sweep(ctx->lo);
-            }
+            mem->marking = 1;
+            _xpost_garbage_marking_ctx = ctx;
+            return 0;
         }
     }
 
-    printf("collect recovered %u bytes\n", sz);
-    return sz;
+    if (!_xpost_garbage_mark_all(ctx, isglobal || markall))
+        return -1;
+
+    /* do not keep a mark stack grown by an unusually deep structure */
+    if (_xpost_garbage_mark_stack_max > XPOST_GARBAGE_MARK_STACK_SIZE)
+        _xpost_garbage_mark_stack_free();
+
+    if (dosweep)
+        _xpost_garbage_sweep_start(mem);
+
+    return 0;
+}
+
+/* collect mem, timing the marking */
+int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
+{
+    long long t = xpost_get_usertime_us();
+    int ret;
+
+    ret = _xpost_garbage_collect(mem, dosweep, markall);
+    mem->stats.mark_us += xpost_get_usertime_us() - t;
+    return ret;
 }
 
 #if 0
@@ -1105,7 +2043,7 @@ unsigned int stac;
 /*     xpost_context_init_ctxlist(&mem); */
 /*     Xpost_Memory_Table *tab = &mem->table; */
 /*     unsigned int ent = xpost_memory_table_alloc(&mem, 0, 0); */
-/*     stac = mem->table.tab[ent].adr = initstack(&mem); */
+/*     stac = xpost_memory_table_entry(&mem->table, ent)->adr = initstack(&mem); */
 /*     /\* mem.roots[0] = XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK; *\/ */
 /*     /\* mem.roots[1] = ent; *\/ */
 /*     mem.start = ent+1; */
@@ -38,23 +38,203 @@
  */
 
 
+/**
+ * @def XPOST_GARBAGE_COMPACT_RATIO
+ * @brief Compact local vm after a collection when at least
+ * 1/XPOST_GARBAGE_COMPACT_RATIO of the memory in use is free.
+ */
+#define XPOST_GARBAGE_COMPACT_RATIO 4
+
+/**
+ * @def XPOST_GARBAGE_MARK_STACK_SIZE
+ * @brief Initial number of entries in the mark stack, which holds
+ * composite objects whose contents are still to be marked. It
+ * doubles as needed, so nesting depth is limited only by memory.
+ */
+#define XPOST_GARBAGE_MARK_STACK_SIZE 1024
+
+/**
+ * @def XPOST_GARBAGE_SWEEP_STEP
+ * @brief Number of table entries swept by each call of the idle
+ * procedure while a sweep is pending.
+ */
+#define XPOST_GARBAGE_SWEEP_STEP 128
+
 /**
  * @brief  Perform a garbage collection on mfile.
  *
- * dosweep controls whether a sweep is performed; if not, this
+ * dosweep controls whether a sweep is started; if not, this
  * is just a marking operation. markall controls whether
  * collect() should follow links across vm boundaries.
  *
  * For a local vm, dosweep should be 1 and markall should be 0.
  * For a global vm, dosweep should be 1 and markall should be 1.
  *
- * For a global vm, collect() calls itself recursively upon each
- * associated local vm, with dosweep = 0, markall = 1.
+ * For a global vm, the roots of every context sharing it, and the
+ * save and name stacks of their local vms, are traversed across vm
+ * boundaries, but only the global vm is swept. Its automatic
+ * collections are made less frequent by its threshold_ratio.
  *
- * returns size collected or -1 if error occured.
+ * The sweep is not performed here. Any sweep still pending from
+ * the previous collection is finished first, then the table is
+ * swept lazily by the allocator (see xpost_free_sweep()) and by
+ * xpost_garbage_sweep() from the idle loop, and the collection
+ * is complete when the sweep reaches the end of the table.
+ *
+ * After sweeping a local vm, if enough of it is free, live
+ * allocations are slid down over the free ones, rewriting their
+ * table addresses, and the unused end of the memory file is
+ * returned to the system.
+ *
+ * returns 0 or -1 if error occured.
  */
 int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall);
 
+/**
+ * @brief  Traverse up to count objects of the incremental marking of mem.
+ *
+ * If mem->mark_budget is not zero, a collection of a local vm only
+ * shades the roots, sets mem->marking and returns; the marking is
+ * then done by this function from the idle loop, and the sweep is
+ * started when no gray objects remain. Meanwhile every allocation
+ * in mem is allocated marked, and stores into its arrays, dicts and
+ * stacks call xpost_garbage_shade(). A collection of any vm first
+ * finishes an incremental marking in progress. Global vm is always
+ * marked all at once.
+ *
+ * returns 1 if the marking is complete, 0 otherwise.
+ */
+int xpost_garbage_mark_step(Xpost_Memory_File *mem, unsigned int count);
+
+/**
+ * @brief  Write barrier for incremental marking.
+ *
+ * Mark an object stored into an array, dict or stack of mem and
+ * queue its contents to be traversed, so that a marked object never
+ * refers to an unmarked one. Callers check mem->marking first.
+ */
+void xpost_garbage_shade(Xpost_Memory_File *mem, Xpost_Object o);
+
+/**
+ * @brief  Queue the contents of ent to be traversed again.
+ *
+ * For save and restore, which copy or exchange the contents of an
+ * array or dict without storing each element.
+ */
+void xpost_garbage_rescan(Xpost_Memory_File *mem,
+                          unsigned int ent,
+                          unsigned int type);
+
+/**
+ * @brief  Write barrier for the nursery.
+ *
+ * If o is an array or dict in the nursery of mem, add the array or
+ * dict ent, which is outside the nursery and into which o is being
+ * stored, to the remembered set of the next minor collection.
+ * Callers check mem->nursery_limit first.
+ */
+void xpost_garbage_remember(Xpost_Memory_File *mem,
+                            unsigned int ent,
+                            Xpost_Object o);
+
+/**
+ * @brief  Add ent to the remembered set of the next minor collection.
+ *
+ * For restore and dict growth, which exchange the storage of two
+ * arrays or dicts without storing each element. The contents of ent
+ * are traversed by the next minor collection, and ent survives it
+ * even if it now has storage in the nursery.
+ */
+void xpost_garbage_remember_ent(Xpost_Memory_File *mem,
+                                unsigned int ent);
+
+/**
+ * @brief  Move o out of the nursery of mem, with its young contents.
+ *
+ * For objects of local vm stored into global vm, which minor
+ * collections do not traverse. Callers check mem->nursery_limit first.
+ *
+ * returns 1 on success, 0 on failure.
+ */
+int xpost_garbage_promote(Xpost_Memory_File *mem, Xpost_Object o);
+
+/**
+ * @brief  Perform a minor collection of the nursery of mem.
+ *
+ * The arrays and dicts in the nursery which are reachable from the
+ * stacks of the contexts using mem, from its save records and from
+ * the remembered set are moved out of the nursery by
+ * xpost_free_move_ent(). The ents of the rest are released and the
+ * nursery is emptied. The minor collection is made from the idle
+ * loop, where no pointers into vm are held, and not while an
+ * incremental marking is in progress.
+ *
+ * returns 1 on success, 0 on failure.
+ */
+int xpost_garbage_collect_nursery(Xpost_Memory_File *mem);
+
+/**
+ * @brief  Check whether anything allocated in a local vm since save
+ *         level lev began may still be in use.
+ *
+ * Looks at the stacks of the contexts using mem for an array or dict
+ * stamped with save level lev or above, or any composite object or file
+ * with an ent of nextent or more, and for a stack segment allocated at
+ * or after vm address used.
+ *
+ * returns 1 if so, or if it cannot tell, 0 otherwise.
+ */
+int xpost_garbage_newer_in_use(Xpost_Memory_File *mem,
+                               unsigned int lev,
+                               unsigned int nextent,
+                               unsigned int used);
+
+/**
+ * @brief  Free the arrays and dicts of a local vm allocated at save
+ *         level lev or above, after restore has left that level.
+ *
+ * Restore returns every older array and dict to its saved contents, so
+ * only the stacks of the contexts using mem may still refer to the newer
+ * ones. If none of them does, they are put on the free list at once
+ * instead of waiting for a collection. Nothing is freed during an
+ * incremental marking.
+ *
+ * returns the number of bytes freed.
+ */
+unsigned int xpost_garbage_free_newer(Xpost_Memory_File *mem,
+                                      unsigned int lev);
+
+/**
+ * @brief  Continue the pending sweep of mem by up to count entries.
+ *
+ * When the sweep is complete, the collection is finished:
+ * a local vm is compacted, the threshold for the next collection
+ * is set and the results are recorded in mem->gc.
+ *
+ * returns 1 if no sweep is pending any more, 0 otherwise.
+ */
+int xpost_garbage_sweep(Xpost_Memory_File *mem, unsigned int count);
+
+/**
+ * @brief  Finish the pending sweep of mem, if any.
+ *
+ * returns 1, or 0 if mem is NULL.
+ */
+int xpost_garbage_sweep_finish(Xpost_Memory_File *mem);
+
+/**
+ * @brief  Set the VMThreshold of mem.
+ *
+ * Automatic collection is triggered when the bytes allocated since
+ * the previous collection reach the larger of this value and the
+ * size that survived that collection, scaled by a factor the
+ * collector adjusts after each collection. A threshold of -1
+ * restores the default; smaller values are raised to the minimum.
+ *
+ * returns 1.
+ */
+int xpost_garbage_set_threshold(Xpost_Memory_File *mem, int threshold);
+
 #if 0
 /**
  * @brief perform a short functionality test
@@ -0,0 +1,437 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h> /* fopen fread fwrite remove rename */
+#include <stdlib.h> /* free malloc */
+#include <string.h> /* memcmp memcpy memset strlen */
+
+#ifdef _WIN32
+# include <process.h> /* _getpid */
+# define getpid() _getpid()
+#else
+# include <unistd.h> /* getpid */
+#endif
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_memory.h"  /* the image is a copy of the memory files */
+#include "xpost_object.h"
+#include "xpost_stack.h"  /* the save stacks must be empty */
+#include "xpost_context.h"
+#include "xpost_garbage.h"  /* collect before writing */
+#include "xpost_operator.h"  /* the image must match the installed operators */
+#include "xpost_dict.h"  /* names are bound to the systemdict of the image */
+
+#include "xpost_image.h"  /* double-check prototypes */
+
+#define XPOST_IMAGE_MAGIC "XPOSTVM"
+#define XPOST_IMAGE_VERSION 2
+
+/* sections of the image start at multiples of this,
+   so the structures in them are aligned where they are read */
+#define XPOST_IMAGE_ALIGN 16
+
+/* the image file begins with a header, followed by the key,
+   then for the global and the local vm a memory record,
+   the memory table and the used bytes of the memory file. */
+typedef struct
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int sizes[4]; /* of the structures copied raw */
+    char build[24]; /* date and time this file was compiled */
+    unsigned int keylen;
+    int noops;
+    unsigned int opdigest; /* xpost_operator_digest() */
+    unsigned int id;
+    unsigned int os, es, ds, hold;
+    unsigned int vmmode;
+    unsigned long rand_next;
+} Xpost_Image_Header;
+
+typedef struct
+{
+    unsigned int used;
+    unsigned int nextent;
+    unsigned int start;
+    unsigned int allocated;
+    unsigned int threshold;
+    unsigned int vmthreshold;
+    unsigned int threshold_ratio;
+    int reclaim_disabled;
+    unsigned int nursery_size;
+    unsigned int nursery_base;
+    unsigned int nursery_top;
+    unsigned int nursery_limit;
+    Xpost_Memory_Gc_Stats gc;
+} Xpost_Image_Memory;
+
+/* a memory file as found in a loaded image */
+typedef struct
+{
+    Xpost_Image_Memory rec;
+    const unsigned char *table;
+    unsigned char *bytes;
+} Xpost_Image_Section;
+
+/* fill the header fields which identify the build */
+static
+void _xpost_image_header(Xpost_Image_Header *hdr)
+{
+    memset(hdr, 0, sizeof *hdr);
+    memcpy(hdr->magic, XPOST_IMAGE_MAGIC, sizeof XPOST_IMAGE_MAGIC);
+    hdr->version = XPOST_IMAGE_VERSION;
+    hdr->sizes[0] = sizeof(Xpost_Object);
+    hdr->sizes[1] = sizeof(Xpost_Memory_Table_Entry);
+    hdr->sizes[2] = sizeof(Xpost_Stack);
+    hdr->sizes[3] = sizeof(Xpost_Image_Memory);
+    strncpy(hdr->build, __DATE__ " " __TIME__, sizeof hdr->build - 1);
+}
+
+static
+unsigned int _xpost_image_pad(unsigned int n)
+{
+    return (n + XPOST_IMAGE_ALIGN - 1) / XPOST_IMAGE_ALIGN * XPOST_IMAGE_ALIGN;
+}
+
+/* check that nothing of mem is pending which the image cannot hold */
+static
+int _xpost_image_is_clean(Xpost_Memory_File *mem)
+{
+    unsigned int vs;
+
+    if (mem->marking || mem->sweep_limit
+        || mem->nyoung || mem->nremembered || mem->nfinalize
+        || mem->nsave_marks || mem->nsaved_pages)
+        return 0;
+    if (!xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs))
+        return 0;
+    return xpost_stack_count(mem, vs) == 0;
+}
+
+/* a window device and its event handler belong to the process */
+static
+int _xpost_image_is_unset(Xpost_Object o)
+{
+    return xpost_object_get_type(o) == nulltype
+        || xpost_object_get_type(o) == invalidtype;
+}
+
+/* write n bytes, and zeros up to the next section */
+static
+int _xpost_image_write(FILE *f, const void *p, unsigned int n)
+{
+    static const char zero[XPOST_IMAGE_ALIGN];
+    unsigned int pad = _xpost_image_pad(n) - n;
+
+    return fwrite(p, 1, n, f) == n && fwrite(zero, 1, pad, f) == pad;
+}
+
+/* write the memory record, the table and the used bytes of mem */
+static
+int _xpost_image_write_memory(FILE *f, Xpost_Memory_File *mem)
+{
+    Xpost_Image_Memory rec;
+    unsigned int i;
+
+    memset(&rec, 0, sizeof rec);
+    rec.used = mem->used;
+    rec.nextent = mem->table.nextent;
+    rec.start = mem->start;
+    rec.allocated = mem->allocated;
+    rec.threshold = mem->threshold;
+    rec.vmthreshold = mem->vmthreshold;
+    rec.threshold_ratio = mem->threshold_ratio;
+    rec.reclaim_disabled = mem->reclaim_disabled;
+    rec.nursery_size = mem->nursery_size;
+    rec.nursery_base = mem->nursery_base;
+    rec.nursery_top = mem->nursery_top;
+    rec.nursery_limit = mem->nursery_limit;
+    rec.gc = mem->gc;
+    if (!_xpost_image_write(f, &rec, sizeof rec))
+        return 0;
+
+    /* the table is written a page at a time, the last one padded */
+    for (i = 0; i < mem->table.nextent; i += XPOST_MEMORY_TABLE_SIZE)
+    {
+        unsigned int n = mem->table.nextent - i;
+
+        if (n > XPOST_MEMORY_TABLE_SIZE)
+            n = XPOST_MEMORY_TABLE_SIZE;
+        if (!_xpost_image_write(f, xpost_memory_table_entry(&mem->table, i),
+                                n * sizeof(Xpost_Memory_Table_Entry)))
+            return 0;
+    }
+
+    return _xpost_image_write(f, mem->base, mem->used);
+}
+
+/* collect both memory files and write them to path */
+int xpost_image_save(Xpost_Context *ctx, const char *path, const char *key)
+{
+    Xpost_Image_Header hdr;
+    char *tmp;
+    FILE *f;
+    int ret;
+
+    if (!xpost_garbage_collect_nursery(ctx->lo))
+        return 0;
+    if (ctx->garbage_collect_function(ctx->lo, 1, 0) == -1)
+        return 0;
+    (void) xpost_garbage_sweep_finish(ctx->lo);
+    if (ctx->garbage_collect_function(ctx->gl, 1, 1) == -1)
+        return 0;
+    (void) xpost_garbage_sweep_finish(ctx->gl);
+
+    if (!_xpost_image_is_clean(ctx->gl) || !_xpost_image_is_clean(ctx->lo)
+        || !_xpost_image_is_unset(ctx->event_handler)
+        || !_xpost_image_is_unset(ctx->window_device))
+    {
+        XPOST_LOG_INFO("vm not in a state to be written to image %s", path);
+        return 0;
+    }
+
+    _xpost_image_header(&hdr);
+    hdr.keylen = strlen(key);
+    hdr.noops = xpost_operator_count();
+    hdr.opdigest = xpost_operator_digest();
+    hdr.id = ctx->id;
+    hdr.os = ctx->os;
+    hdr.es = ctx->es;
+    hdr.ds = ctx->ds;
+    hdr.hold = ctx->hold;
+    hdr.vmmode = ctx->vmmode;
+    hdr.rand_next = ctx->rand_next;
+
+    /* another process may be reading or writing the image */
+    tmp = malloc(strlen(path) + 24);
+    if (!tmp)
+        return 0;
+    sprintf(tmp, "%s.%ld", path, (long)getpid());
+    f = fopen(tmp, "wb");
+    if (!f)
+    {
+        XPOST_LOG_ERR("cannot create image %s", tmp);
+        free(tmp);
+        return 0;
+    }
+    ret = _xpost_image_write(f, &hdr, sizeof hdr)
+        && _xpost_image_write(f, key, hdr.keylen)
+        && _xpost_image_write_memory(f, ctx->gl)
+        && _xpost_image_write_memory(f, ctx->lo);
+    if (fclose(f) != 0)
+        ret = 0;
+#ifdef _WIN32
+    if (ret)
+        (void) remove(path);
+#endif
+    if (ret && rename(tmp, path) != 0)
+        ret = 0;
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot write image %s", path);
+        (void) remove(tmp);
+    }
+    else
+        XPOST_LOG_INFO("wrote vm image %s (global %u bytes, local %u bytes)",
+                       path, ctx->gl->used, ctx->lo->used);
+    free(tmp);
+    return ret;
+}
+
+/* find the next section of n bytes of the image, or NULL if it is cut short */
+static
+unsigned char *_xpost_image_section(unsigned char *buf, long size, long *off, unsigned int n)
+{
+    unsigned char *p;
+
+    if (size - *off < (long)_xpost_image_pad(n))
+        return NULL;
+    p = buf + *off;
+    *off += _xpost_image_pad(n);
+    return p;
+}
+
+/* find the memory record, the table and the bytes of a memory file */
+static
+int _xpost_image_read_memory(unsigned char *buf, long size, long *off, Xpost_Image_Section *sec)
+{
+    unsigned char *p;
+
+    if (!(p = _xpost_image_section(buf, size, off, sizeof sec->rec)))
+        return 0;
+    memcpy(&sec->rec, p, sizeof sec->rec);
+    if (sec->rec.nextent <= XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE
+        || sec->rec.nextent > (unsigned int)(size / sizeof(Xpost_Memory_Table_Entry)))
+        return 0;
+    if (!(sec->table = _xpost_image_section(buf, size, off,
+                                            sec->rec.nextent * sizeof(Xpost_Memory_Table_Entry))))
+        return 0;
+    if (!(sec->bytes = _xpost_image_section(buf, size, off, sec->rec.used)))
+        return 0;
+    return 1;
+}
+
+/* make room in mem for the section, before anything is overwritten */
+static
+int _xpost_image_reserve(Xpost_Memory_File *mem, const Xpost_Image_Section *sec)
+{
+    unsigned int ent;
+
+    if (sec->rec.used > mem->max
+        && !xpost_memory_file_grow(mem, sec->rec.used - mem->max))
+        return 0;
+    while (mem->table.nextent < sec->rec.nextent)
+        if (!xpost_memory_table_alloc_ent(mem, 0, 0, 0, &ent))
+            return 0;
+    return 1;
+}
+
+/* replace the contents of mem with the section */
+static
+void _xpost_image_restore(Xpost_Memory_File *mem, const Xpost_Image_Section *sec)
+{
+    unsigned int i;
+
+    xpost_memory_discard_code(mem, 0, 0); /* the code is not in the image */
+    for (i = sec->rec.nextent; i < mem->table.nextent; i++)
+        memset(xpost_memory_table_entry(&mem->table, i), 0, sizeof(Xpost_Memory_Table_Entry));
+    for (i = 0; i < sec->rec.nextent; i++)
+        memcpy(xpost_memory_table_entry(&mem->table, i),
+               sec->table + i * sizeof(Xpost_Memory_Table_Entry),
+               sizeof(Xpost_Memory_Table_Entry));
+    mem->table.nextent = sec->rec.nextent;
+
+    memcpy(mem->base, sec->bytes, sec->rec.used);
+    if (mem->used > sec->rec.used)
+        memset(mem->base + sec->rec.used, 0, mem->used - sec->rec.used);
+    mem->used = sec->rec.used;
+
+    mem->start = sec->rec.start;
+    mem->allocated = sec->rec.allocated;
+    mem->threshold = sec->rec.threshold;
+    mem->vmthreshold = sec->rec.vmthreshold;
+    mem->threshold_ratio = sec->rec.threshold_ratio;
+    mem->reclaim_disabled = sec->rec.reclaim_disabled;
+    mem->nursery_size = sec->rec.nursery_size;
+    mem->nursery_base = sec->rec.nursery_base;
+    mem->nursery_top = sec->rec.nursery_top;
+    mem->nursery_limit = sec->rec.nursery_limit;
+    mem->gc = sec->rec.gc;
+    mem->sweep = 0;
+    mem->sweep_limit = 0;
+    mem->nyoung = 0;
+    mem->nremembered = 0;
+    mem->nfinalize = 0;
+}
+
+/* read the image at path over the vm of ctx */
+int xpost_image_load(Xpost_Context *ctx, const char *path, const char *key)
+{
+    Xpost_Image_Header hdr;
+    Xpost_Image_Header cur;
+    Xpost_Image_Section gl;
+    Xpost_Image_Section lo;
+    unsigned char *buf = NULL;
+    unsigned char *p;
+    long size;
+    long off = 0;
+    FILE *f;
+    int ret = 0;
+
+    f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    if (fseek(f, 0, SEEK_END) == 0
+        && (size = ftell(f)) > 0
+        && fseek(f, 0, SEEK_SET) == 0
+        && (buf = malloc(size))
+        && fread(buf, 1, size, f) == (size_t)size)
+        ret = 1;
+    fclose(f);
+    if (!ret)
+        goto done;
+    ret = 0;
+
+    if (!(p = _xpost_image_section(buf, size, &off, sizeof hdr)))
+        goto done;
+    memcpy(&hdr, p, sizeof hdr);
+    _xpost_image_header(&cur);
+    if (memcmp(hdr.magic, cur.magic, sizeof cur.magic) != 0
+        || hdr.version != cur.version
+        || memcmp(hdr.sizes, cur.sizes, sizeof cur.sizes) != 0
+        || memcmp(hdr.build, cur.build, sizeof cur.build) != 0)
+    {
+        XPOST_LOG_INFO("image %s is from another build", path);
+        goto done;
+    }
+    if (hdr.keylen != strlen(key)
+        || !(p = _xpost_image_section(buf, size, &off, hdr.keylen))
+        || memcmp(p, key, hdr.keylen) != 0)
+    {
+        XPOST_LOG_INFO("image %s is for another configuration", path);
+        goto done;
+    }
+    if (hdr.id != ctx->id
+        || hdr.os != ctx->os || hdr.es != ctx->es
+        || hdr.ds != ctx->ds || hdr.hold != ctx->hold
+        || !_xpost_image_read_memory(buf, size, &off, &gl)
+        || !_xpost_image_read_memory(buf, size, &off, &lo)
+        || off != size)
+    {
+        XPOST_LOG_ERR("image %s is damaged", path);
+        goto done;
+    }
+
+    if (hdr.noops != xpost_operator_count()
+        || hdr.opdigest != xpost_operator_digest())
+    {
+        XPOST_LOG_INFO("image %s has other operators", path);
+        goto done;
+    }
+
+    if (!_xpost_image_reserve(ctx->gl, &gl) || !_xpost_image_reserve(ctx->lo, &lo))
+        goto done;
+    _xpost_image_restore(ctx->gl, &gl);
+    _xpost_image_restore(ctx->lo, &lo);
+    ctx->vmmode = hdr.vmmode;
+    ctx->rand_next = hdr.rand_next;
+    xpost_dict_rebind_names(ctx);
+    XPOST_LOG_INFO("loaded vm image %s", path);
+    ret = 1;
+
+  done:
+    free(buf);
+    return ret;
+}
@@ -0,0 +1,87 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XPOST_IMAGE_H
+#define XPOST_IMAGE_H
+
+/**
+ * @file xpost_image.h
+ * @brief A preinitialized vm image.
+ *
+ * Loading init.ps dominates the start-up time of the interpreter.
+ * Once a context is initialized, its global and local memory files
+ * can be written to an image file, and later contexts created for
+ * the same configuration can read the image back in place of
+ * interpreting init.ps again.
+ *
+ * The image holds the used part of each memory file and its memory
+ * table, and the few context fields which init.ps changes. The vm
+ * holds no pointers into the process: operators are referred to by
+ * opcode into the optab, which is in C memory. The operators are
+ * installed in the new context as usual, and the image is accepted
+ * only if they match those it was written with, by count and by
+ * xpost_operator_digest().
+ *
+ * An image is only written from a clean vm: after a full collection,
+ * with the nursery empty, no save level and no file waiting to be
+ * closed. An image which does not match the build or the key given
+ * to xpost_image_load() is ignored.
+ */
+
+/**
+ * @brief Write the vm of a context just initialized by init.ps to an
+ *        image file.
+ *
+ * @param[in] ctx The context.
+ * @param[in] path The image file.
+ * @param[in] key The configuration the context was initialized for.
+ * @return 1 if the image was written, 0 otherwise.
+ *
+ * The memory files are collected first. The image is written to a
+ * temporary file which then replaces @p path.
+ */
+int xpost_image_save(Xpost_Context *ctx, const char *path, const char *key);
+
+/**
+ * @brief Replace the vm of a new context with an image file.
+ *
+ * @param[in,out] ctx The context, with its operators installed.
+ * @param[in] path The image file.
+ * @param[in] key The configuration the context is initialized for.
+ * @return 1 if the image was loaded, 0 otherwise.
+ *
+ * If the image is missing, was written by another build or for
+ * another @p key, or its operators differ from the installed ones,
+ * 0 is returned and the context is left as it was, to be
+ * initialized by init.ps.
+ */
+int xpost_image_load(Xpost_Context *ctx, const char *path, const char *key);
+
+#endif
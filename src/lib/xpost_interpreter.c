@@ -55,11 +55,14 @@
 #include "xpost_name.h"  /* eval functions examine names */
 #include "xpost_dict.h"  /* eval functions examine dicts */
 #include "xpost_file.h"  /* eval functions examine files */
+#include "xpost_compile.h"  /* run compiled procedures */
 
 #include "xpost_interpreter.h" /* uses: context itp MAXCONTEXT MAXMFILE */
+#include "xpost_image.h"  /* load init.ps from a vm image */
 #include "xpost_garbage.h"  /*  test gc, install collect() in context's memory files */
 #include "xpost_operator.h"  /* eval functions call operators */
 #include "xpost_oplib.h"
+#include "xpost_op_dict.h"  /* evalload looks up names */
 
 static
 Xpost_Object namedollarerror; /* cached result of xpost_name_cons(ctx, "$error")
@@ -292,6 +295,7 @@ int xpost_interpreter_init(Xpost_Interpreter *itpptr, const char *device)
 void xpost_interpreter_exit(Xpost_Interpreter *itpptr)
 {
     xpost_context_exit(&itpptr->ctab[0]);
+    ++xpost_dict_epoch; /* forget the name lookups into its vm */
 }
 
 
@@ -331,37 +335,34 @@ int evalpush(Xpost_Context *ctx)
     return 0;
 }
 
-/* load executable name */
+/* look up name k, and execute or push its value */
 static
-int evalload(Xpost_Context *ctx)
+int _xpost_interpreter_load(Xpost_Context *ctx, Xpost_Object k)
 {
-    int ret;
-    if (_xpost_interpreter_is_tracing)
+    Xpost_Object v;
+
+    if (!xpost_op_dict_stack_lookup(ctx, k, &v))
+        return undefined;
+    if (xpost_object_is_exe(v))
     {
-        Xpost_Object s = xpost_name_get_string(ctx, xpost_stack_topdown_fetch(ctx->lo, ctx->es, 0));
-        XPOST_LOG_DUMP("evalload <name \"%*s\">", s.comp_.sz, xpost_string_get_pointer(ctx, s));
+        if (!xpost_stack_push(ctx->lo, ctx->es, v))
+            return execstackoverflow;
     }
-
-    if (!xpost_stack_push(ctx->lo, ctx->os,
-            xpost_stack_pop(ctx->lo, ctx->es)))
-        return stackoverflow;
-    assert(ctx->gl->base);
-    /*xpost_operator_exec(ctx, xpost_operator_cons(ctx, "load", NULL,0,0).mark_.padw); */
-    ret = xpost_operator_exec(ctx, ctx->opcode_shortcuts.load);
-    if (ret)
-        return ret;
-    if (xpost_object_is_exe(xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0)))
+    else
     {
-        Xpost_Object q;
-        q = xpost_stack_pop(ctx->lo, ctx->os);
-        if (xpost_object_get_type(q) == invalidtype)
-            return undefined;
-        if (!xpost_stack_push(ctx->lo, ctx->es, q))
-            return ret;
+        if (!xpost_stack_push(ctx->lo, ctx->os, v))
+            return stackoverflow;
     }
     return 0;
 }
 
+/* load executable name */
+static
+int evalload(Xpost_Context *ctx)
+{
+    return _xpost_interpreter_load(ctx, xpost_stack_pop(ctx->lo, ctx->es));
+}
+
 /* execute operator */
 static
 int evaloperator(Xpost_Context *ctx)
@@ -371,8 +372,6 @@ int evaloperator(Xpost_Context *ctx)
     if (xpost_object_get_type(op) == invalidtype)
         return stackunderflow;
 
-    if (_xpost_interpreter_is_tracing)
-        xpost_operator_dump(ctx, op.mark_.padw);
     ret = xpost_operator_exec(ctx, op.mark_.padw);
     if (ret)
         return ret;
@@ -530,6 +529,55 @@ void initevaltype(void)
     XPOST_OBJECT_TYPES(AS_EVALINIT)
 }
 
+/* the actions of the untraced loop, which does the same as the
+   evaltype functions but without a call for the common ones */
+#define XPOST_INTERPRETER_ACTIONS(_) \
+    _(push) \
+    _(pop) \
+    _(quit) \
+    _(load) \
+    _(operator) \
+    _(array) \
+    _(string) \
+    _(file) \
+    _(unregistered)
+
+#define AS_ACTION(_) XPOST_INTERPRETER_ACTION_ ## _ ,
+enum { XPOST_INTERPRETER_ACTIONS(AS_ACTION) };
+
+/* action for each type of executable object, as evaltype.
+   the type field is 5 bits, the types above XPOST_OBJECT_NTYPES are unregistered.
+   invalid is unregistered too, as the sanity check in eval(). */
+static
+const unsigned char _xpost_interpreter_action[XPOST_OBJECT_TAG_DATA_TYPE_MASK + 1] =
+{
+    XPOST_INTERPRETER_ACTION_unregistered, /* invalid */
+    XPOST_INTERPRETER_ACTION_pop,       /* null */
+    XPOST_INTERPRETER_ACTION_push,      /* mark */
+    XPOST_INTERPRETER_ACTION_push,      /* integer */
+    XPOST_INTERPRETER_ACTION_push,      /* real */
+    XPOST_INTERPRETER_ACTION_array,     /* array */
+    XPOST_INTERPRETER_ACTION_push,      /* dict */
+    XPOST_INTERPRETER_ACTION_file,      /* file */
+    XPOST_INTERPRETER_ACTION_operator,  /* operator */
+    XPOST_INTERPRETER_ACTION_push,      /* save */
+    XPOST_INTERPRETER_ACTION_load,      /* name */
+    XPOST_INTERPRETER_ACTION_push,      /* boolean */
+    XPOST_INTERPRETER_ACTION_push,      /* context */
+    XPOST_INTERPRETER_ACTION_quit,      /* extended */
+    XPOST_INTERPRETER_ACTION_push,      /* glob */
+    XPOST_INTERPRETER_ACTION_quit,      /* magic */
+    XPOST_INTERPRETER_ACTION_string,    /* string */
+    XPOST_INTERPRETER_ACTION_unregistered, XPOST_INTERPRETER_ACTION_unregistered,
+    XPOST_INTERPRETER_ACTION_unregistered, XPOST_INTERPRETER_ACTION_unregistered,
+    XPOST_INTERPRETER_ACTION_unregistered, XPOST_INTERPRETER_ACTION_unregistered,
+    XPOST_INTERPRETER_ACTION_unregistered, XPOST_INTERPRETER_ACTION_unregistered,
+    XPOST_INTERPRETER_ACTION_unregistered, XPOST_INTERPRETER_ACTION_unregistered,
+    XPOST_INTERPRETER_ACTION_unregistered, XPOST_INTERPRETER_ACTION_unregistered,
+    XPOST_INTERPRETER_ACTION_unregistered, XPOST_INTERPRETER_ACTION_unregistered,
+    XPOST_INTERPRETER_ACTION_unregistered
+};
+
 
 /*
    call window device's event_handler function
@@ -537,11 +585,29 @@ void initevaltype(void)
    underlying Window System, process one or more of them,
    and then return 0.
    it should leave all stacks undisturbed.
+
+   also continue the marking or the sweep of a recent collection, if any,
+   and make a minor collection if the nursery is filling up.
+   called every XPOST_INTERPRETER_IDLE_INTERVAL objects, so the steps
+   are that many times the per-object budget.
  */
 int idleproc (Xpost_Context *ctx)
 {
     int ret;
 
+    if (ctx->lo->marking)
+        (void) xpost_garbage_mark_step(ctx->lo,
+                ctx->lo->mark_budget * XPOST_INTERPRETER_IDLE_INTERVAL);
+    if (ctx->lo->sweep_limit)
+        (void) xpost_garbage_sweep(ctx->lo,
+                XPOST_GARBAGE_SWEEP_STEP * XPOST_INTERPRETER_IDLE_INTERVAL);
+    if (ctx->gl->sweep_limit)
+        (void) xpost_garbage_sweep(ctx->gl,
+                XPOST_GARBAGE_SWEEP_STEP * XPOST_INTERPRETER_IDLE_INTERVAL);
+    if (ctx->lo->nursery_top - ctx->lo->nursery_base >
+        (ctx->lo->nursery_limit - ctx->lo->nursery_base) / 4 * 3)
+        (void) xpost_garbage_collect_nursery(ctx->lo);
+
     if ((xpost_object_get_type(ctx->event_handler) == operatortype) &&
         (xpost_object_get_type(ctx->window_device) == dicttype))
     {
@@ -602,8 +668,8 @@ int validate_context(Xpost_Context *ctx)
 }
 
 /*
-   one iteration of the central loop
-   called repeatedly by mainloop()
+   one iteration of the central loop, with tracing
+   called repeatedly by _xpost_interpreter_run_traced()
  */
 int eval(Xpost_Context *ctx)
 {
@@ -618,9 +684,6 @@ int eval(Xpost_Context *ctx)
                                errant object since it is the "entry point" to the interpreter.
                              */
 
-    if (!validate_context(ctx))
-        return unregistered;
-
     if (_xpost_interpreter_is_tracing)
     {
         //XPOST_LOG_DUMP("eval(): Executing: ");
@@ -631,12 +694,15 @@ int eval(Xpost_Context *ctx)
         //xpost_stack_dump(ctx->lo, ctx->ds);
         //XPOST_LOG_DUMP("Exec Stack: ");
         //xpost_stack_dump(ctx->lo, ctx->es);
+        if (xpost_object_get_type(t) == nametype && xpost_object_is_exe(t))
+        {
+            Xpost_Object s = xpost_name_get_string(ctx, t);
+            XPOST_LOG_DUMP("evalload <name \"%*s\">", s.comp_.sz, xpost_string_get_pointer(ctx, s));
+        }
+        if (xpost_object_get_type(t) == operatortype && xpost_object_is_exe(t))
+            xpost_operator_dump(ctx, t.mark_.padw);
     }
 
-    ret = idleproc(ctx); /* periodically process asynchronous events */
-    if (ret)
-        return ret;
-
     { /* check object for sanity before using jump table */
         Xpost_Object_Type type = xpost_object_get_type(t);
         if (type == invalidtype || type >= XPOST_OBJECT_NTYPES)
@@ -650,6 +716,223 @@ int eval(Xpost_Context *ctx)
     return ret;
 }
 
+/*
+   the central loop while tracing.
+   runs until quit, an error, or tracing is turned off.
+   *idle counts down the objects to execute before the next idleproc().
+ */
+static
+int _xpost_interpreter_run_traced(Xpost_Context *ctx, unsigned int *idle)
+{
+    int ret;
+
+    while (!ctx->quit && _xpost_interpreter_is_tracing)
+    {
+        if (!--*idle)
+        {
+            *idle = XPOST_INTERPRETER_IDLE_INTERVAL;
+            ret = idleproc(ctx); /* periodically process asynchronous events */
+            if (ret)
+                return ret;
+            if (ctx->quit)
+                break;
+        }
+        ret = eval(ctx);
+        if (ret)
+            return ret;
+    }
+    return 0;
+}
+
+/*
+   gcc and clang can jump through a table of label addresses
+   (computed goto), which gives each action its own indirect jump
+   and helps the branch predictor. it is an extension, so
+   -pedantic-errors is relaxed around its use.
+   define XPOST_NO_COMPUTED_GOTO to use the switch instead.
+ */
+#if defined(__GNUC__) && !defined(XPOST_NO_COMPUTED_GOTO)
+# define XPOST_INTERPRETER_THREADED
+#endif
+
+#ifdef XPOST_INTERPRETER_THREADED
+# define AS_LABEL(_) && _xpost_interpreter_do_ ## _ ,
+# define XPOST_INTERPRETER_DISPATCH(a) goto *label[a];
+# define XPOST_INTERPRETER_CASE(_) _xpost_interpreter_do_ ## _
+#else
+# define XPOST_INTERPRETER_DISPATCH(a) switch (a)
+# define XPOST_INTERPRETER_CASE(_) case XPOST_INTERPRETER_ACTION_ ## _
+#endif
+
+#ifdef XPOST_INTERPRETER_THREADED
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/*
+   the central loop.
+   executes the top of the exec stack until quit or an error,
+   whose code it returns, or until tracing is turned on.
+   does the same as eval(), but the context is validated once by mainloop(),
+   idleproc() is called every XPOST_INTERPRETER_IDLE_INTERVAL objects,
+   and pushing literals, popping null and calling operators are done in line.
+   a procedure with compiled code runs an instruction of it per step.
+   *idle counts down the objects to execute before the next idleproc().
+ */
+static
+int _xpost_interpreter_run(Xpost_Context *ctx, unsigned int *idle)
+{
+#ifdef XPOST_INTERPRETER_THREADED
+    static const void *const label[] = { XPOST_INTERPRETER_ACTIONS(AS_LABEL) };
+#endif
+    unsigned int countdown = *idle;
+    Xpost_Stack *es;
+    Xpost_Object t;
+    const Xpost_Compile_Code *code;
+    unsigned int insn;
+    unsigned int action;
+    int ret;
+
+next:
+    if (!--countdown)
+    {
+        countdown = XPOST_INTERPRETER_IDLE_INTERVAL;
+        ret = idleproc(ctx); /* periodically process asynchronous events */
+        if (ret)
+            goto out;
+        if (ctx->quit)
+            goto out;
+    }
+
+    /* vm may have moved */
+    es = (Xpost_Stack *)(ctx->lo->base + ctx->es);
+    if (!es->top)
+    {
+        ctx->currentobject = invalid;
+        ret = unregistered;
+        goto out;
+    }
+    t = XPOST_STACK_DATA(ctx->lo, es)[es->top - 1];
+    ctx->currentobject = t; /* as in eval() */
+
+    /* an unregistered type is an error even when literal, as in eval() */
+    action = _xpost_interpreter_action[xpost_object_get_type(t)];
+    if ((t.tag & XPOST_OBJECT_TAG_DATA_FLAG_LIT) &&
+        action != XPOST_INTERPRETER_ACTION_unregistered)
+        action = XPOST_INTERPRETER_ACTION_push;
+
+    XPOST_INTERPRETER_DISPATCH(action)
+    {
+        XPOST_INTERPRETER_CASE(push):
+            --es->top;
+            if (!xpost_stack_push(ctx->lo, ctx->os, t))
+            {
+                ret = stackoverflow;
+                goto out;
+            }
+            goto next;
+        XPOST_INTERPRETER_CASE(pop):
+            --es->top;
+            goto next;
+        XPOST_INTERPRETER_CASE(quit):
+            ++ctx->quit;
+            ret = 0;
+            goto out;
+        XPOST_INTERPRETER_CASE(load):
+            ret = evalload(ctx);
+            if (ret)
+                goto out;
+            goto next;
+        XPOST_INTERPRETER_CASE(operator):
+            --es->top;
+            ret = xpost_operator_exec(ctx, t.mark_.padw);
+            if (ret)
+                goto out;
+            /* quit and traceon are operators */
+            if (ctx->quit || _xpost_interpreter_is_tracing)
+                goto out;
+            goto next;
+        XPOST_INTERPRETER_CASE(array):
+            code = xpost_compile_get((t.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK) ? ctx->gl : ctx->lo, t);
+            if (!code)
+            {
+                ret = evalarray(ctx);
+                if (ret)
+                    goto out;
+                goto next;
+            }
+            /* the frame is the program counter. step it past the
+               instruction, or drop it for the last, as evalarray() does */
+            insn = code->insn[t.comp_.off - code->off];
+            if (t.comp_.sz > 1)
+            {
+                Xpost_Object *frame = &XPOST_STACK_DATA(ctx->lo, es)[es->top - 1];
+                ++frame->comp_.off;
+                --frame->comp_.sz;
+            }
+            else
+                --es->top;
+            switch (XPOST_COMPILE_INSN_OPCODE(insn))
+            {
+                case XPOST_COMPILE_PUSH:
+                    ctx->currentobject = code->lit[XPOST_COMPILE_INSN_ARG(insn)];
+                    if (!xpost_stack_push(ctx->lo, ctx->os, ctx->currentobject))
+                    {
+                        ret = stackoverflow;
+                        goto out;
+                    }
+                    goto next;
+                case XPOST_COMPILE_OPERATOR:
+                    t.mark_.tag = operatortype;
+                    t.mark_.pad0 = 0;
+                    t.mark_.padw = XPOST_COMPILE_INSN_ARG(insn);
+                    ctx->currentobject = t;
+                    ret = xpost_operator_exec(ctx, t.mark_.padw);
+                    if (ret)
+                        goto out;
+                    if (ctx->quit || _xpost_interpreter_is_tracing)
+                        goto out;
+                    goto next;
+                case XPOST_COMPILE_LOAD:
+                    ctx->currentobject = code->lit[XPOST_COMPILE_INSN_ARG(insn)];
+                    ret = _xpost_interpreter_load(ctx, ctx->currentobject);
+                    if (ret)
+                        goto out;
+                    goto next;
+                case XPOST_COMPILE_EXEC:
+                    if (!xpost_stack_push(ctx->lo, ctx->es, code->lit[XPOST_COMPILE_INSN_ARG(insn)]))
+                    {
+                        ret = execstackoverflow;
+                        goto out;
+                    }
+                    goto next;
+                default: /* XPOST_COMPILE_NOP */
+                    goto next;
+            }
+        XPOST_INTERPRETER_CASE(string):
+            ret = evalstring(ctx);
+            if (ret)
+                goto out;
+            goto next;
+        XPOST_INTERPRETER_CASE(file):
+            ret = evalfile(ctx);
+            if (ret)
+                goto out;
+            goto next;
+        XPOST_INTERPRETER_CASE(unregistered):
+            ret = unregistered;
+            goto out;
+    }
+
+out:
+    *idle = countdown;
+    return ret;
+}
+
+#ifdef XPOST_INTERPRETER_THREADED
+# pragma GCC diagnostic pop
+#endif
+
 /* called by mainloop() after propagated error codes.
    pushes postscript-level error procedures
    and resumes normal execution.
@@ -684,13 +967,13 @@ void _onerror(Xpost_Context *ctx,
     if ((xpost_object_get_type(ctx->currentobject) == operatortype) &&
         (ctx->currentobject.tag & XPOST_OBJECT_TAG_DATA_FLAG_OPARGSINHOLD))
     {
+        Xpost_Object args[XPOST_OPERATOR_MAX_ARGS];
         int n = ctx->currentobject.mark_.pad0;
         int i;
+        /* copied out of vm, which may move as the opstack grows */
         for (i = 0; i < n; i++)
-        {
-            xpost_stack_push(ctx->lo, ctx->os,
-                    xpost_stack_bottomup_fetch(ctx->lo, ctx->hold, i));
-        }
+            args[i] = xpost_stack_bottomup_fetch(ctx->lo, ctx->hold, i);
+        xpost_stack_push_n(ctx->lo, ctx->os, args, n);
     }
 
     /* printf("1\n"); */
@@ -793,7 +1076,8 @@ Xpost_Context *_switch_context(Xpost_Context *ctx)
 
 /*
    the big main central interpreter loop.
-   processes return codes from eval().
+   runs the traced or the untraced loop
+   and processes the return codes from them.
    0 indicate noerror
    yieldtocaller indicates `showpage` has been called using SHOWPAGE_RETURN semantics.
    ioblock indicates a blocked io operation.
@@ -802,15 +1086,26 @@ Xpost_Context *_switch_context(Xpost_Context *ctx)
  */
 int mainloop(Xpost_Context *ctx)
 {
+    unsigned int idle = 1; /* start with idleproc() */
     int ret;
 
 ctxswitch:
     xpost_ctx = ctx = _switch_context(ctx);
     itpdata->cid = ctx->id;
+    ++xpost_dict_epoch; /* the name lookup cache is for one dict stack */
+
+    if (!validate_context(ctx))
+    {
+        XPOST_LOG_ERR("context not valid");
+        return 0;
+    }
 
     while(!ctx->quit)
     {
-        ret = eval(ctx);
+        if (_xpost_interpreter_is_tracing)
+            ret = _xpost_interpreter_run_traced(ctx, &idle);
+        else
+            ret = _xpost_interpreter_run(ctx, &idle);
         if (ret)
             switch (ret)
             {
@@ -885,6 +1180,25 @@ int initalldata(const char *device)
     return 1;
 }
 
+/* the devices, the operator which loads each if any,
+   and the operator which instantiates it */
+static
+const char *device_strings[][3] =
+{
+    { "pgm",     "",                 "newPGMIMAGEdevice" },
+    { "ppm",     "",                 "newPPMIMAGEdevice" },
+    { "null",    "",                 "newnulldevice"     },
+    { "xcb",     "loadxcbdevice",    "newxcbdevice"      },
+    { "gdi",     "loadwin32device",  "newwin32device"    },
+    { "gl",      "loadwin32device",  "newwin32device"    },
+    { "bgr",     "loadbgrdevice",    "newbgrdevice"      },
+    { "raster",  "loadrasterdevice", "newrasterdevice"   },
+    { "pdfwrite","",                 "newPDFWRITEdevice" },
+    { "png",     "loadpngdevice",    "newpngdevice"      },
+    { "jpeg",    "loadjpegdevice",   "newjpegdevice"      },
+    { NULL, NULL, NULL }
+};
+
 /* FIXME remove duplication of effort here and in bin/xpost_main.c
          (ie. there should be 1 table, not 2)
 
@@ -914,21 +1228,6 @@ void setlocalconfig(Xpost_Context *ctx,
                     int width,
                     int height)
 {
-    const char *device_strings[][3] =
-    {
-        { "pgm",     "",                 "newPGMIMAGEdevice" },
-        { "ppm",     "",                 "newPPMIMAGEdevice" },
-        { "null",    "",                 "newnulldevice"     },
-        { "xcb",     "loadxcbdevice",    "newxcbdevice"      },
-        { "gdi",     "loadwin32device",  "newwin32device"    },
-        { "gl",      "loadwin32device",  "newwin32device"    },
-        { "bgr",     "loadbgrdevice",    "newbgrdevice"      },
-        { "raster",  "loadrasterdevice", "newrasterdevice"   },
-        { "pdfwrite","",                 "newPDFWRITEdevice" },
-        { "png",     "loadpngdevice",    "newpngdevice"      },
-        { "jpeg",    "loadjpegdevice",   "newjpegdevice"      },
-        { NULL, NULL, NULL }
-    };
     const char *strtemplate = "currentglobal false setglobal "
                         "%s userdict /DEVICE %s %s put "
                         "setglobal";
@@ -1010,31 +1309,24 @@ void setlocalconfig(Xpost_Context *ctx,
 }
 
 /*
-   load init.ps (which also loads err.ps) while systemdict is writeable
-   ignore invalidaccess errors.
+   find init.ps in the data directories.
+   return 1 with its path in path_init_ps and the directory in
+   path_init, or 0 if it can not be found.
  */
 static
-void loadinitps(Xpost_Context *ctx)
+int findinitps(char *path_init_ps, size_t size, char **path_init)
 {
-    char buf[1024];
-    char path_init_ps[XPOST_PATH_MAX];
     struct stat statbuf;
-    char *path_init;
     char *path;
-    int n;
-
-    assert(ctx->gl->base);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
-    ctx->ignoreinvalidaccess = 1;
 
 #define XPOST_PATH_INIT \
     do \
     { \
-        snprintf(path_init_ps, sizeof(path_init_ps), "%s/init.ps", path); \
+        snprintf(path_init_ps, size, "%s/init.ps", path); \
         if (stat(path_init_ps, &statbuf) == 0) \
         { \
-            path_init = path; \
-            goto load_init_ps; \
+            *path_init = path; \
+            return 1; \
         } \
         else \
             XPOST_LOG_DBG("init.ps not present in", path_init_ps); \
@@ -1076,9 +1368,31 @@ void loadinitps(Xpost_Context *ctx)
 
     XPOST_LOG_ERR("init.ps can not be found");
 
-    return;
+    return 0;
+}
+
+/*
+   load init.ps (which also loads err.ps) while systemdict is writeable
+   ignore invalidaccess errors.
+ */
+static
+void loadinitps(Xpost_Context *ctx)
+{
+    char buf[1024];
+    char path_init_ps[XPOST_PATH_MAX];
+    char *path_init;
+#ifdef _WIN32
+    char *path;
+#endif
+    int n;
+
+    assert(ctx->gl->base);
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
+    ctx->ignoreinvalidaccess = 1;
+
+    if (!findinitps(path_init_ps, sizeof(path_init_ps), &path_init))
+        return;
 
-  load_init_ps:
     /* backslashes are not supported in path because they are inserted in
     * PostScript files, and PostScript */
 #ifdef _WIN32
@@ -1124,6 +1438,89 @@ static int copyudtosd(Xpost_Context *ctx, Xpost_Object ud, Xpost_Object sd)
 }
 
 
+/* fold n bytes into an FNV-1a hash */
+static
+unsigned int stamphash(unsigned int h, const void *p, size_t n)
+{
+    const unsigned char *b = p;
+
+    while (n--)
+        h = (h ^ *b++) * 16777619u;
+    return h;
+}
+
+/*
+   describe the configuration which init.ps initializes a context for,
+   as the key of a vm image. the data files are included by their
+   names, sizes and times.
+   return a malloc'd string, or NULL if the configuration cannot use
+   an image: a device which must be loaded creates its window at
+   initialization, and output buffers are pointers into the process.
+ */
+static
+char *imagekey(const char *device,
+               const char *outfile,
+               int buffered,
+               Xpost_Showpage_Semantics semantics,
+               int quiet,
+               Xpost_Set_Size set_size,
+               int width,
+               int height)
+{
+    char path_init_ps[XPOST_PATH_MAX];
+    char pattern[XPOST_PATH_MAX];
+    char *path_init;
+    struct stat statbuf;
+    glob_t files;
+    unsigned int stamp = 2166136261u;
+    size_t len;
+    char *key;
+    int i;
+
+    if (buffered)
+        return NULL;
+    len = strcspn(device, ":");
+    for (i = 0; device_strings[i][0]; i++)
+    {
+        if (strlen(device_strings[i][0]) == len
+            && strncmp(device, device_strings[i][0], len) == 0)
+            break;
+    }
+    if (!device_strings[i][0] || device_strings[i][1][0])
+        return NULL;
+
+    if (!findinitps(path_init_ps, sizeof(path_init_ps), &path_init))
+        return NULL;
+    snprintf(pattern, sizeof(pattern), "%s/*.ps", path_init);
+    if (xpost_glob(pattern, &files) == 0)
+    {
+        for (i = 0; i < (int)files.gl_pathc; i++)
+        {
+            if (stat(files.gl_pathv[i], &statbuf) == 0)
+            {
+                long long sz = statbuf.st_size;
+                long long mt = statbuf.st_mtime;
+
+                stamp = stamphash(stamp, files.gl_pathv[i], strlen(files.gl_pathv[i]));
+                stamp = stamphash(stamp, &sz, sizeof sz);
+                stamp = stamphash(stamp, &mt, sizeof mt);
+            }
+        }
+        xpost_glob_free(&files);
+    }
+
+    if (set_size != XPOST_USE_SIZE)
+        width = height = 0;
+    len = strlen(device) + (outfile ? strlen(outfile) : 0) + strlen(path_init) + 128;
+    key = malloc(len);
+    if (!key)
+        return NULL;
+    snprintf(key, len, "device=%s output=%s semantics=%d quiet=%d size=%dx%d data=%s stamp=%08x",
+             device, outfile ? outfile : "", (int)semantics, quiet,
+             width, height, path_init, stamp);
+    return key;
+}
+
 /*
    create an executable context using the given device,
    output configuration, and semantics.
@@ -1142,6 +1539,8 @@ XPAPI Xpost_Context *xpost_create(const char *device,
     const char *outfile = NULL;
     const char *bufferin = NULL;
     char **bufferout = NULL;
+    const char *image;
+    char *key = NULL;
     int quiet;
 
     switch (output_msg)
@@ -1199,6 +1598,20 @@ XPAPI Xpost_Context *xpost_create(const char *device,
         return NULL;
     }
 
+    /* a vm image replaces the rest of the initialization */
+    if ((image = getenv("XPOST_IMAGE")) && *image)
+    {
+        key = imagekey(device, outfile, bufferin || bufferout,
+                       semantics, quiet, set_size, width, height);
+        if (key && xpost_image_load(xpost_ctx, image, key))
+        {
+            free(key);
+            xpost_stack_clear(xpost_ctx->lo, xpost_ctx->hold);
+            xpost_interpreter_set_initializing(0);
+            return xpost_ctx;
+        }
+    }
+
     /* extract systemdict and userdict for additional definitions */
     sd = xpost_stack_bottomup_fetch(xpost_ctx->lo, xpost_ctx->ds, 0);
     ud = xpost_stack_bottomup_fetch(xpost_ctx->lo, xpost_ctx->ds, 2);
@@ -1223,6 +1636,7 @@ XPAPI Xpost_Context *xpost_create(const char *device,
     if (ret)
     {
         XPOST_LOG_ERR("%s error in copyudtosd", errorname[ret]);
+        free(key);
         return NULL;
     }
 
@@ -1239,6 +1653,12 @@ XPAPI Xpost_Context *xpost_create(const char *device,
 
     xpost_interpreter_set_initializing(0);
 
+    if (key)
+    {
+        (void) xpost_image_save(xpost_ctx, image, key);
+        free(key);
+    }
+
     return xpost_ctx;
 }
 
@@ -1433,6 +1853,38 @@ run:
     return noerror;
 }
 
+/*
+   copy the running totals of the local or global vm of ctx
+ */
+XPAPI int xpost_stats_get(Xpost_Context *ctx, int global, Xpost_Stats *stats)
+{
+    Xpost_Memory_File *mem;
+    int i;
+
+    if (!ctx || !stats)
+        return 0;
+    mem = global ? ctx->gl : ctx->lo;
+    memset(stats, 0, sizeof *stats);
+    for (i = 0; i < XPOST_STATS_TAGS && i < XPOST_MEMORY_STATS_TAGS; i++)
+    {
+        stats->allocs[i] = mem->stats.allocs[i];
+        stats->bytes[i] = mem->stats.bytes[i];
+    }
+    stats->free_list_hits = mem->stats.free_list_hits;
+    stats->free_list_misses = mem->stats.free_list_misses;
+    stats->nursery_allocs = mem->stats.nursery_allocs;
+    stats->grows = mem->stats.grows;
+    stats->collections = mem->stats.collections;
+    stats->minor_collections = mem->stats.minor_collections;
+    stats->mark_us = mem->stats.mark_us;
+    stats->sweep_us = mem->stats.sweep_us;
+    stats->minor_us = mem->stats.minor_us;
+    stats->reclaimed = mem->stats.reclaimed;
+    stats->used = mem->used;
+    stats->max = mem->max;
+    return 1;
+}
+
 /*
    destroy the given context and associated memory files (if not in use by a shared context)
    exit interpreter if all contexts are destroyed.
@@ -69,11 +69,16 @@ void xpost_interpreter_set_initializing(int i);
 
 Xpost_Context *xpost_interpreter_cid_get_context(unsigned int cid);
 
+/**
+ * @brief number of objects executed by mainloop() between calls to idleproc()
+ */
+#define XPOST_INTERPRETER_IDLE_INTERVAL 16
+
 /**
  * The event-handler handler.
 
- * In a multi-threaded configuration, this may not execute at in every eval()
- * but by a superior strategy.
+ * mainloop() calls this every XPOST_INTERPRETER_IDLE_INTERVAL objects
+ * rather than in every eval().
  */
 int idleproc(Xpost_Context *ctx);
 
@@ -53,6 +53,8 @@
 #include "xpost_object.h"
 #include "xpost_memory.h"
 #include "xpost_font.h"
+#include "xpost_context.h"
+#include "xpost_operator.h"
 #include "xpost_main.h"
 #include "xpost_private.h"
 
@@ -128,6 +130,7 @@ xpost_quit(void)
     if (--_xpost_init_count != 0)
         return _xpost_init_count;
 
+    xpost_operator_quit();
     xpost_font_quit();
     xpost_log_quit();
     free(_xpost_data_dir);
@@ -35,7 +35,8 @@
 #include <assert.h>
 #include <ctype.h> /* isprint */
 #include <errno.h>
-#include <stdlib.h> /* free malloc realloc */
+#include <limits.h> /* UINT_MAX */
+#include <stdlib.h> /* calloc free getenv malloc realloc strtoul */
 #include <stdio.h> /* remove puts */
 #include <string.h> /* memset strerror */
 
@@ -43,7 +44,7 @@
 #include <fcntl.h> /* open */
 
 #ifdef HAVE_SYS_MMAN_H
-# include <sys/mman.h> /* mmap munmap mremap */
+# include <sys/mman.h> /* mmap munmap mremap madvise */
 #endif
 
 #ifdef _WIN32
@@ -74,15 +75,28 @@
 
 
 size_t xpost_memory_page_size;
+size_t xpost_memory_reserve_size;
+int xpost_memory_huge_pages;
 
 /*
-   initialize the global extern page_size variable
+   initialize the global extern page_size variable,
+   and the reservation settings from the environment
  */
 int
 xpost_memory_init(void)
 {
+    const char *env;
 #ifdef _WIN32
     SYSTEM_INFO si;
+#endif
+
+    env = getenv("XPOST_VM_RESERVE");
+    if (env && *env)
+        xpost_memory_reserve_size = (size_t)strtoul(env, NULL, 10) << 20;
+    env = getenv("XPOST_VM_HUGEPAGES");
+    xpost_memory_huge_pages = env && *env && *env != '0';
+
+#ifdef _WIN32
 
     GetSystemInfo(&si);
 
@@ -103,6 +117,127 @@ xpost_memory_init(void)
 #endif
 }
 
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+
+/* make bytes from up to to of the reserved range at base usable,
+   mapped from the same offsets of fd if not -1.
+   return 1 on success, 0 on failure. */
+static int
+_xpost_memory_file_commit(unsigned char *base,
+                          size_t from,
+                          size_t to,
+                          int fd)
+{
+    if (fd != -1)
+        return mmap(base + from, to - from,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED,
+                    fd, from) != MAP_FAILED;
+    return mprotect(base + from, to - from, PROT_READ | PROT_WRITE) == 0;
+}
+
+/* give bytes from up to to of the reserved range at base back to the system,
+   keeping them reserved.
+   return 1 on success, 0 on failure. */
+static int
+_xpost_memory_file_decommit(unsigned char *base,
+                            size_t from,
+                            size_t to)
+{
+    return mmap(base + from, to - from,
+                PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                -1, 0) != MAP_FAILED;
+}
+
+/* reserve xpost_memory_reserve_size bytes of address space for mem
+   and commit the first sz of them, so base need never move.
+   returns the range or MAP_FAILED. */
+static void *
+_xpost_memory_file_reserve(Xpost_Memory_File *mem,
+                           int fd,
+                           size_t sz)
+{
+    size_t reserve;
+    void *base;
+
+    /* offsets into the memory file are unsigned ints */
+    reserve = xpost_memory_reserve_size;
+    if (reserve > UINT_MAX)
+        reserve = UINT_MAX;
+    reserve = reserve / xpost_memory_page_size * xpost_memory_page_size;
+    if (reserve <= sz || sz % xpost_memory_page_size)
+        return MAP_FAILED;
+
+    base = mmap(NULL, reserve,
+                PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                -1, 0);
+    if (base == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("unable to reserve %lu bytes (error: %s)",
+                      (unsigned long)reserve, strerror(errno));
+        return MAP_FAILED;
+    }
+    if (!_xpost_memory_file_commit(base, 0, sz, fd))
+    {
+        XPOST_LOG_ERR("unable to commit %lu bytes (error: %s)",
+                      (unsigned long)sz, strerror(errno));
+        munmap(base, reserve);
+        return MAP_FAILED;
+    }
+# ifdef MADV_HUGEPAGE
+    /* only anonymous and tmpfs memory can be given huge pages */
+    if (xpost_memory_huge_pages &&
+        madvise(base, reserve, MADV_HUGEPAGE) == -1)
+        XPOST_LOG_INFO("no huge pages for memory file (error: %s)",
+                       strerror(errno));
+# endif
+    mem->reserve = reserve;
+    return base;
+}
+
+/* grow mem to sz bytes inside its reserved range, or to the whole
+   range if need bytes still fit.
+   return 1 if it was grown, 0 if the range is too small and has been
+   given up, so the mapping must move, -1 on failure. */
+static int
+_xpost_memory_file_grow_reserved(Xpost_Memory_File *mem,
+                                 size_t need,
+                                 size_t sz)
+{
+    sz = (sz + xpost_memory_page_size - 1)
+        / xpost_memory_page_size * xpost_memory_page_size;
+    if (sz > mem->reserve && need <= mem->reserve)
+        sz = mem->reserve;
+    if (sz > mem->reserve)
+    {
+        XPOST_LOG_INFO("memory file%s%s outgrew its reservation of %u bytes",
+                       mem->fname[0] ? " for " : "", mem->fname[0] ? mem->fname : "",
+                       mem->reserve);
+        munmap((void *)(mem->base + mem->max), mem->reserve - mem->max);
+        mem->reserve = 0;
+        return 0;
+    }
+
+    if (mem->fd != -1)
+    {
+        if (ftruncate(mem->fd, sz) == -1)
+            XPOST_LOG_ERR("ftruncate(%d, %d) returned -1 (error: %s)",
+                          mem->fd, sz, strerror(errno));
+    }
+    if (!_xpost_memory_file_commit(mem->base, mem->max, sz, mem->fd))
+    {
+        XPOST_LOG_ERR("%d unable to grow memory (error: %s)",
+                      VMerror, strerror(errno));
+        return -1;
+    }
+    mem->max = sz;
+    return 1;
+}
+
+#endif
+
 /*
    initialize the memory file structure,
    possibly using filename or file descriptor.
@@ -144,6 +279,8 @@ xpost_memory_file_init(Xpost_Memory_File *mem,
         mem->fname[0] = '\0';
 
     mem->fd = fd;
+    mem->reserve = 0;
+    memset(&mem->stats, 0, sizeof mem->stats);
     if (fd != -1)
     {
         if (fstat(fd, &buf) == 0)
@@ -197,12 +334,16 @@ xpost_memory_file_init(Xpost_Memory_File *mem,
     if (!mem->base)
     {
 #elif defined (HAVE_MMAP)
-    mem->base = (unsigned char *)mmap(NULL,
-                                      sz,
-                                      PROT_READ | PROT_WRITE,
-                                      (fd == -1 ? MAP_PRIVATE   : MAP_SHARED) |
-                                      (fd == -1 ? MAP_ANONYMOUS : 0),
-                                      fd, 0);
+    mem->base = MAP_FAILED;
+    if (xpost_memory_reserve_size)
+        mem->base = (unsigned char *)_xpost_memory_file_reserve(mem, fd, sz);
+    if (mem->base == MAP_FAILED)
+        mem->base = (unsigned char *)mmap(NULL,
+                                          sz,
+                                          PROT_READ | PROT_WRITE,
+                                          (fd == -1 ? MAP_PRIVATE   : MAP_SHARED) |
+                                          (fd == -1 ? MAP_ANONYMOUS : 0),
+                                          fd, 0);
     if (mem->base == MAP_FAILED)
     { /* . */
 #else
@@ -252,7 +393,8 @@ xpost_memory_file_exit(Xpost_Memory_File *mem)
 #ifdef _WIN32
     UnmapViewOfFile(mem->base);
 #elif defined (HAVE_MMAP)
-    munmap((void *)mem->base, mem->max);
+    munmap((void *)mem->base, mem->reserve ? mem->reserve : mem->max);
+    mem->reserve = 0;
 #else
     if (mem->fd != -1)
     {
@@ -267,6 +409,41 @@ xpost_memory_file_exit(Xpost_Memory_File *mem)
     mem->used = 0;
     mem->max = 0;
 
+    free(mem->young);
+    mem->young = NULL;
+    mem->nyoung = mem->young_max = 0;
+    free(mem->remembered);
+    mem->remembered = NULL;
+    mem->nremembered = mem->remembered_max = 0;
+    free(mem->finalize);
+    mem->finalize = NULL;
+    mem->nfinalize = mem->finalize_max = 0;
+    free(mem->saved_pages);
+    mem->saved_pages = NULL;
+    mem->nsaved_pages = mem->saved_pages_max = 0;
+    free(mem->name_bindings);
+    mem->name_bindings = NULL;
+    mem->name_bindings_max = 0;
+    xpost_memory_discard_code(mem, 0, 0);
+    free(mem->code);
+    mem->code = NULL;
+    mem->code_max = 0;
+    free(mem->save_marks);
+    mem->save_marks = NULL;
+    mem->nsave_marks = mem->save_marks_max = 0;
+    mem->nursery_base = mem->nursery_top = mem->nursery_limit = 0;
+
+    if (mem->table.page)
+    {
+        unsigned int i;
+        for (i = 0; i < mem->table.max / XPOST_MEMORY_TABLE_SIZE; i++)
+            free(mem->table.page[i]);
+        free(mem->table.page);
+        mem->table.page = NULL;
+        mem->table.max = 0;
+        mem->table.nextent = 0;
+    }
+
     if (mem->fd != -1)
     {
         close(mem->fd);
@@ -295,6 +472,7 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
     HANDLE fm;
 #endif
     void *tmp;
+    size_t need;
     int ret = 1;
 
     if (!mem)
@@ -313,6 +491,7 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
         sz = xpost_memory_page_size;
     else
         sz = (sz / xpost_memory_page_size + 1) * xpost_memory_page_size;
+    need = mem->max + sz;
     sz += mem->max * 1.5;
 
     XPOST_LOG_INFO("grow memory file%s%s (old: %d  new: %d)",
@@ -365,6 +544,16 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
     else
     { /* hanging error case */
 #elif defined (HAVE_MMAP)
+    if (mem->reserve)
+    {
+        /* base stays put */
+        ret = _xpost_memory_file_grow_reserved(mem, need, sz);
+        if (ret == 1)
+            ++mem->stats.grows;
+        if (ret)
+            return ret == 1;
+        ret = 1;
+    }
     if (mem->fd != -1)
     {
         if (ftruncate(mem->fd, sz) == -1)
@@ -415,11 +604,135 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
     }
     mem->base = (unsigned char *)tmp;
     mem->max = sz;
+    ++mem->stats.grows;
 
     return ret;
 }
 
 
+/* shrink memory file to fit the space in use, rounded up to the nearest
+   system page size and leaving some headroom for further allocations.
+   the pages past the new end are returned to the system.
+   return 1 on success, 0 on failure.
+ */
+XPCHECKAPI int
+xpost_memory_file_shrink(Xpost_Memory_File *mem)
+{
+    size_t sz;
+    void *tmp;
+    int ret = 1;
+
+    if (!mem)
+    {
+        XPOST_LOG_ERR("%d mem pointer is NULL", VMerror);
+        return 0;
+    }
+
+    if (mem->base == NULL)
+    {
+        XPOST_LOG_ERR("%d mem->base is NULL", VMerror);
+        return 0;
+    }
+
+    sz = mem->used + mem->used / 2;
+    sz = (sz / xpost_memory_page_size + 1) * xpost_memory_page_size;
+    if (sz + XPOST_MEMORY_SHRINK_PAGES * xpost_memory_page_size > mem->max)
+        return 1; /* not worth the trouble */
+
+    XPOST_LOG_INFO("shrink memory file%s%s (old: %d  new: %d)",
+                   mem->fname[0] ? " for " : "", mem->fname[0] ? mem->fname : "",
+                   mem->max, sz);
+
+#ifdef _WIN32
+    (void)tmp;
+    return 1; /* the view cannot be shrunk in place */
+#elif defined (HAVE_MMAP)
+    if (mem->reserve)
+    {
+        /* keep the pages past the new end reserved */
+        if (!_xpost_memory_file_decommit(mem->base, sz, mem->max))
+        {
+            XPOST_LOG_ERR("%d unable to shrink memory (error: %s)",
+                          VMerror, strerror(errno));
+            return 0;
+        }
+        tmp = mem->base;
+    }
+    else
+# ifdef HAVE_MREMAP
+    tmp = mremap(mem->base, mem->max, sz, 0);
+# else
+    tmp = munmap((void *)(mem->base + sz), mem->max - sz) == 0 ?
+        mem->base : MAP_FAILED;
+# endif
+    if (tmp == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to shrink memory (error: %s)",
+                      VMerror, strerror(errno));
+        return 0;
+    }
+    if (mem->fd != -1)
+    {
+        if (ftruncate(mem->fd, sz) == -1)
+            XPOST_LOG_ERR("ftruncate(%d, %d) returned -1 (error: %s)",
+                          mem->fd, sz, strerror(errno));
+    }
+#else
+    tmp = realloc(mem->base, sz);
+    if (tmp == NULL)
+    {
+        XPOST_LOG_ERR("%d unable to shrink memory", VMerror);
+        return 0;
+    }
+#endif
+    mem->base = (unsigned char *)tmp;
+    mem->max = sz;
+
+    return ret;
+}
+
+
+/* return the whole pages inside a free region of the memory file to the
+   system. the contents of the region read as zero afterwards.
+   return 1 on success, 0 on failure.
+ */
+XPCHECKAPI int
+xpost_memory_file_discard(Xpost_Memory_File *mem,
+                          unsigned int adr,
+                          unsigned int sz)
+{
+    size_t start;
+    size_t end;
+
+    if (!mem || mem->base == NULL)
+    {
+        XPOST_LOG_ERR("%d mem not initialized", VMerror);
+        return 0;
+    }
+
+    /* page boundaries are relative to base, which is page-aligned */
+    start = ((size_t)adr + xpost_memory_page_size - 1)
+        / xpost_memory_page_size * xpost_memory_page_size;
+    end = ((size_t)adr + sz) / xpost_memory_page_size * xpost_memory_page_size;
+    if (end <= start)
+        return 1;
+
+#if defined (HAVE_MMAP) && defined (MADV_REMOVE) && defined (MADV_DONTNEED)
+    if (madvise(mem->base + start, end - start,
+                mem->fd != -1 ? MADV_REMOVE : MADV_DONTNEED) == -1)
+    {
+        XPOST_LOG_ERR("madvise returned -1 (error: %s)", strerror(errno));
+        return 0;
+    }
+#else
+    (void)start;
+    (void)end;
+#endif
+
+    return 1;
+}
+
+
 /*
    allocate data linearly from the memory file
    */
@@ -522,18 +835,63 @@ xpost_memory_file_dump(const Xpost_Memory_File *mem)
 }
 
 
+/*
+   an ent which predates a save level has been given the storage at adr.
+   the memory file cannot be cut back to that save once it has storage
+   past the cut. the marks of the inner levels have the larger nextent. */
+void
+xpost_memory_save_marks_spoil(Xpost_Memory_File *mem,
+                              unsigned int ent,
+                              unsigned int adr)
+{
+    unsigned int i;
+
+    if (XPOST_MEMORY_IS_YOUNG(mem, adr))
+        return;
+    for (i = mem->nsave_marks; i-- > 0 && ent < mem->save_marks[i].nextent; )
+        if (adr >= mem->save_marks[i].used)
+            mem->save_marks[i].spoiled = 1;
+}
+
+/* free the code compiled from the arrays of ents in [ent, end) */
+void
+xpost_memory_discard_code(Xpost_Memory_File *mem,
+                          unsigned int ent,
+                          unsigned int end)
+{
+    if (!end || end > mem->code_max)
+        end = mem->code_max;
+    for ( ; ent < end; ent++)
+    {
+        if (mem->code[ent])
+        {
+            free(mem->code[ent]);
+            mem->code[ent] = NULL;
+        }
+    }
+}
+
 /*
  * allocate and initialize a memory table data structure
  */
 XPCHECKAPI int
 xpost_memory_table_init(Xpost_Memory_File *mem)
 {
-    mem->table.tab = malloc( (mem->table.max = 1000) * sizeof(*mem->table.tab));
-    if (!mem->table.tab)
+    mem->table.page = calloc(mem->table.npages = 16, sizeof(*mem->table.page));
+    if (!mem->table.page)
     {
         XPOST_LOG_ERR("%d unable to initialize memory table", VMerror);
         return 0;
     }
+    mem->table.page[0] = calloc(XPOST_MEMORY_TABLE_SIZE, sizeof(**mem->table.page));
+    if (!mem->table.page[0])
+    {
+        XPOST_LOG_ERR("%d unable to initialize memory table", VMerror);
+        free(mem->table.page);
+        mem->table.page = NULL;
+        return 0;
+    }
+    mem->table.max = XPOST_MEMORY_TABLE_SIZE;
     mem->table.nextent = 0;
     return 1;
 }
@@ -562,16 +920,16 @@ xpost_memory_register_garbage_collect_function(
 }
 
 /*
-   allocate sz bytes as an 'ent' in the memory table
+   add an 'ent' to the memory table for sz bytes at adr
    */
-static int
-_xpost_memory_table_alloc_new(Xpost_Memory_File *mem,
-                              unsigned int sz,
-                              unsigned int tag,
-                              unsigned int *entity)
+XPCHECKAPI int
+xpost_memory_table_alloc_ent(Xpost_Memory_File *mem,
+                             unsigned int adr,
+                             unsigned int sz,
+                             unsigned int tag,
+                             unsigned int *entity)
 {
     unsigned int ent;
-    unsigned int adr;
 
     if (!mem)
     {
@@ -587,32 +945,71 @@ _xpost_memory_table_alloc_new(Xpost_Memory_File *mem,
                 ent, XPOST_OBJECT_COMP_MAX_ENT);
     }
 
-    if (!xpost_memory_file_alloc(mem, sz, &adr))
-    {
-        XPOST_LOG_ERR("%d unable to allocate entity data storage", VMerror);
-        return 0;
-    }
-
-    mem->table.tab[ent].adr = adr;
-    mem->table.tab[ent].sz = sz;
-    mem->table.tab[ent].tag = tag;
+    xpost_memory_table_entry(&mem->table, ent)->adr = adr;
+    xpost_memory_table_entry(&mem->table, ent)->sz = sz;
+    xpost_memory_table_entry(&mem->table, ent)->tag = tag;
+    if (mem->marking) /* allocate black during incremental marking */
+        xpost_memory_table_entry(&mem->table, ent)->mark = XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
 
     if (mem->table.nextent == mem->table.max)
     {
-        void *tmp = realloc(mem->table.tab, (mem->table.max*=2) * sizeof(*mem->table.tab));
-        if (!tmp)
+        /* add a page of entries, the existing ones stay where they are */
+        unsigned int n = mem->table.max / XPOST_MEMORY_TABLE_SIZE;
+        if (n == mem->table.npages)
+        {
+            void *tmp = realloc(mem->table.page, 2 * n * sizeof(*mem->table.page));
+            if (!tmp)
+            {
+                XPOST_LOG_ERR("%d unable to grow memory table directory", VMerror);
+                return 0;
+            }
+            mem->table.page = tmp;
+            mem->table.npages = 2 * n;
+        }
+        mem->table.page[n] = calloc(XPOST_MEMORY_TABLE_SIZE, sizeof(**mem->table.page));
+        if (!mem->table.page[n])
         {
             XPOST_LOG_ERR("%d unable to grow memory table", VMerror);
-            mem->table.max/=2;
             return 0;
         }
-        mem->table.tab = tmp;
+        mem->table.max += XPOST_MEMORY_TABLE_SIZE;
     }
 
     *entity = ent;
     return 1;
 }
 
+/*
+   allocate sz bytes as an 'ent' in the memory table
+   */
+static int
+_xpost_memory_table_alloc_new(Xpost_Memory_File *mem,
+                              unsigned int sz,
+                              unsigned int tag,
+                              unsigned int *entity)
+{
+    unsigned int adr;
+
+    if (!xpost_memory_file_alloc(mem, sz, &adr))
+    {
+        XPOST_LOG_ERR("%d unable to allocate entity data storage", VMerror);
+        return 0;
+    }
+    return xpost_memory_table_alloc_ent(mem, adr, sz, tag, entity);
+}
+
+/* count an allocation of sz bytes with tag */
+static void
+_xpost_memory_table_count(Xpost_Memory_File *mem,
+                          unsigned int sz,
+                          unsigned int tag)
+{
+    if (tag >= XPOST_MEMORY_STATS_TAGS)
+        tag = 0;
+    ++mem->stats.allocs[tag];
+    mem->stats.bytes[tag] += sz;
+}
+
 /*
    allocate sz bytes in the memory table, using free-list if installed,
    possibly calling garbage collector, if installed
@@ -630,6 +1027,8 @@ xpost_memory_table_alloc(Xpost_Memory_File *mem,
         ret = mem->free_list_alloc(mem, sz, tag, entity);
         if (ret == 1)
         {
+            xpost_memory_table_entry(&mem->table, *entity)->used = sz;
+            _xpost_memory_table_count(mem, sz, tag);
             return 1;
         }
         else if (ret == 2)
@@ -637,25 +1036,27 @@ xpost_memory_table_alloc(Xpost_Memory_File *mem,
             if (mem->garbage_collect_is_installed &&
                     !mem->interpreter_get_initializing())
             {
-                int sz_reclaimed;
-
-                sz_reclaimed = mem->garbage_collect(mem, 1, 1);
-                if (sz_reclaimed == -1)
+                if (mem->garbage_collect(mem, 1, 1) == -1)
                     return 0;
-                if (sz_reclaimed > (int)sz)
+                /* the free list is refilled as it is searched */
+                ret = mem->free_list_alloc(mem, sz, tag, entity);
+                if (ret == 1)
                 {
-                    ret = mem->free_list_alloc(mem, sz, tag, entity);
-                    if (ret == 1)
-                    {
-                        return 1;
-                    }
+                    xpost_memory_table_entry(&mem->table, *entity)->used = sz;
+                    _xpost_memory_table_count(mem, sz, tag);
+                    return 1;
                 }
             }
         }
     }
     ret = _xpost_memory_table_alloc_new(mem, sz, tag, entity);
-    //XPOST_LOG_INFO("allocated %u(%u) bytes with tag %u as ent %u at %u in %s", sz, mem->table.tab[*entity].sz, tag, *entity, mem->table.tab[*entity].adr, mem->fname);
-    mem->table.tab[*entity].used = sz;
+    if (ret)
+    {
+        ++mem->stats.free_list_misses;
+        _xpost_memory_table_count(mem, sz, tag);
+        xpost_memory_table_entry(&mem->table, *entity)->used = sz;
+    }
+    //XPOST_LOG_INFO("allocated %u(%u) bytes with tag %u as ent %u at %u in %s", sz, xpost_memory_table_entry(&mem->table, *entity)->sz, tag, *entity, xpost_memory_table_entry(&mem->table, *entity)->adr, mem->fname);
     return ret;
 }
 
@@ -678,7 +1079,7 @@ xpost_memory_table_get_addr(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("%d entity not found %u", VMerror, ent);
         return 0;
     }
-    *retaddr = mem->table.tab[ent].adr;
+    *retaddr = xpost_memory_table_entry(&mem->table, ent)->adr;
     return 1;
 }
 
@@ -688,7 +1089,7 @@ int xpost_memory_table_set_addr(Xpost_Memory_File *mem,
                                 unsigned int setaddr)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].adr = setaddr;
+    xpost_memory_table_entry(&mem->table, ent)->adr = setaddr;
     return 1;
 }
 
@@ -700,7 +1101,7 @@ xpost_memory_table_get_size(Xpost_Memory_File *mem,
                             unsigned int *sz)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    *sz = mem->table.tab[ent].sz;
+    *sz = xpost_memory_table_entry(&mem->table, ent)->sz;
     return 1;
 }
 
@@ -711,7 +1112,7 @@ xpost_memory_table_set_size(Xpost_Memory_File *mem,
                             unsigned int size)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].sz = size;
+    xpost_memory_table_entry(&mem->table, ent)->sz = size;
     return 1;
 }
 
@@ -722,7 +1123,7 @@ xpost_memory_table_get_mark(Xpost_Memory_File *mem,
                             unsigned int *retmark)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    *retmark = mem->table.tab[ent].mark;
+    *retmark = xpost_memory_table_entry(&mem->table, ent)->mark;
     return 1;
 }
 
@@ -734,7 +1135,7 @@ xpost_memory_table_set_mark(Xpost_Memory_File *mem,
                             unsigned int setmark)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].mark = setmark;
+    xpost_memory_table_entry(&mem->table, ent)->mark = setmark;
     return 1;
 }
 
@@ -746,7 +1147,7 @@ xpost_memory_table_get_tag(Xpost_Memory_File *mem,
                            unsigned int *tag)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    *tag = mem->table.tab[ent].tag;
+    *tag = xpost_memory_table_entry(&mem->table, ent)->tag;
     return 1;
 }
 
@@ -757,7 +1158,7 @@ xpost_memory_table_set_tag(Xpost_Memory_File *mem,
                            unsigned int tag)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].tag = tag;
+    xpost_memory_table_entry(&mem->table, ent)->tag = tag;
     return 1;
 }
 
@@ -772,14 +1173,14 @@ xpost_memory_get(Xpost_Memory_File *mem,
 {
     CHECK_VALID_ENT(ent,mem,0)
 
-    if (offset * sz > mem->table.tab[ent].sz)
+    if (offset * sz > xpost_memory_table_entry(&mem->table, ent)->sz)
     {
         XPOST_LOG_ERR("%d out of bounds memory %u * %u > %u", rangecheck,
-                offset, sz, mem->table.tab[ent].sz);
+                offset, sz, xpost_memory_table_entry(&mem->table, ent)->sz);
         return 0;
     }
 
-    memcpy(dest, mem->base + mem->table.tab[ent].adr + offset * sz, sz);
+    memcpy(dest, mem->base + xpost_memory_table_entry(&mem->table, ent)->adr + offset * sz, sz);
     return 1;
 }
 
@@ -793,14 +1194,14 @@ xpost_memory_put(Xpost_Memory_File *mem,
 {
     CHECK_VALID_ENT(ent,mem,0)
 
-    if (offset * sz > mem->table.tab[ent].sz)
+    if (offset * sz > xpost_memory_table_entry(&mem->table, ent)->sz)
     {
         XPOST_LOG_ERR("%d out of bounds memory %u * %u > %u", rangecheck,
-                offset, sz, mem->table.tab[ent].sz);
+                offset, sz, xpost_memory_table_entry(&mem->table, ent)->sz);
         return 0;
     }
 
-    memcpy(mem->base + mem->table.tab[ent].adr + offset * sz, src, sz);
+    memcpy(mem->base + xpost_memory_table_entry(&mem->table, ent)->adr + offset * sz, src, sz);
     return 1;
 }
 
@@ -818,25 +1219,25 @@ xpost_memory_table_dump_ent(Xpost_Memory_File *mem,
             "sz [%u], "
             "mark %s rfct %d llev %d tlev %d\n",
             e, i,
-            mem->table.tab[i].adr, mem->table.tab[i].adr,
-            mem->table.tab[i].sz,
-            mem->table.tab[i].mark
+            xpost_memory_table_entry(&mem->table, i)->adr, xpost_memory_table_entry(&mem->table, i)->adr,
+            xpost_memory_table_entry(&mem->table, i)->sz,
+            xpost_memory_table_entry(&mem->table, i)->mark
                 & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK ? "#" : "_",
-            (mem->table.tab[i].mark
+            (xpost_memory_table_entry(&mem->table, i)->mark
                 & XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK)
                 >> XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET,
-            (mem->table.tab[i].mark
+            (xpost_memory_table_entry(&mem->table, i)->mark
                 & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
                 >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET,
-            (mem->table.tab[i].mark
+            (xpost_memory_table_entry(&mem->table, i)->mark
                 & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
                 >> XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);
-        for (u = 0; u < mem->table.tab[i].sz; u++)
+        for (u = 0; u < xpost_memory_table_entry(&mem->table, i)->sz; u++)
         {
             XPOST_LOG_DUMP(" %02x%c",
-                    mem->base[ mem->table.tab[i].adr + u ],
-                    isprint(mem->base[ mem->table.tab[i].adr + u]) ?
-                        mem->base[ mem->table.tab[i].adr + u ] :
+                    mem->base[ xpost_memory_table_entry(&mem->table, i)->adr + u ],
+                    isprint(mem->base[ xpost_memory_table_entry(&mem->table, i)->adr + u]) ?
+                        mem->base[ xpost_memory_table_entry(&mem->table, i)->adr + u ] :
                         ' ');
         }
 }
@@ -856,25 +1257,25 @@ xpost_memory_table_dump(const Xpost_Memory_File *mem)
                 "sz [%u], "
                 "mark %s rfct %d llev %d tlev %d\n",
                 e, i,
-                mem->table.tab[i].adr, mem->table.tab[i].adr,
-                mem->table.tab[i].sz,
-                mem->table.tab[i].mark
+                xpost_memory_table_entry(&mem->table, i)->adr, xpost_memory_table_entry(&mem->table, i)->adr,
+                xpost_memory_table_entry(&mem->table, i)->sz,
+                xpost_memory_table_entry(&mem->table, i)->mark
                     & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK ? "#" : "_",
-                (mem->table.tab[i].mark
+                (xpost_memory_table_entry(&mem->table, i)->mark
                     & XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK)
                     >> XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET,
-                (mem->table.tab[i].mark
+                (xpost_memory_table_entry(&mem->table, i)->mark
                     & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
                     >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET,
-                (mem->table.tab[i].mark
+                (xpost_memory_table_entry(&mem->table, i)->mark
                     & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
                     >> XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);
-        for (u = 0; u < mem->table.tab[i].sz; u++)
+        for (u = 0; u < xpost_memory_table_entry(&mem->table, i)->sz; u++)
         {
             XPOST_LOG_DUMP(" %02x%c",
-                    mem->base[ mem->table.tab[i].adr + u ],
-                    isprint(mem->base[ mem->table.tab[i].adr + u]) ?
-                        mem->base[ mem->table.tab[i].adr + u ] :
+                    mem->base[ xpost_memory_table_entry(&mem->table, i)->adr + u ],
+                    isprint(mem->base[ xpost_memory_table_entry(&mem->table, i)->adr + u]) ?
+                        mem->base[ xpost_memory_table_entry(&mem->table, i)->adr + u ] :
                         ' ');
         }
         XPOST_LOG_DUMP("\n");
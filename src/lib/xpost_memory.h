@@ -50,21 +50,47 @@
 
 /**
  * @def XPOST_MEMORY_TABLE_SIZE
- * @brief Number of entries in a single segment of the
+ * @brief Number of entries in a single page of the
  * Xpost_Memory_Table.
  *
  * This parameter may be tuned for performance.
  *
  * Most VM access (composite object data) has to go through the
- * #Xpost_Memory_Table, which is segmented. So depending on the number
- * of live entries (k), accessing data from an object may require
- * chasing through k/#XPOST_MEMORY_TABLE_SIZE tables before finding the
- * right one. This isn't a lengthy operation, but it is a complicated
- * address calcuation that may not be pipeline-friendly.
+ * #Xpost_Memory_Table, which is a directory of pages of this many
+ * entries. Growing the table adds a page, so entries never move and
+ * pointers to them stay valid. It should be a power of 2 so finding
+ * the page and the slot in it is just a shift and a mask.
  */
-#define XPOST_MEMORY_TABLE_SIZE 2000
+#define XPOST_MEMORY_TABLE_SIZE 2048
 
 
+/**
+ * @def XPOST_MEMORY_SHRINK_PAGES
+ * @brief Minimum number of pages xpost_memory_file_shrink() will
+ * give back to the system.
+ */
+#define XPOST_MEMORY_SHRINK_PAGES 16
+
+/**
+ * @def XPOST_MEMORY_NURSERY_SIZE
+ * @brief Size of the nursery of local vm, where new arrays and
+ * dicts are allocated.
+ */
+#define XPOST_MEMORY_NURSERY_SIZE (256 * 1024)
+
+/**
+ * @def XPOST_MEMORY_NURSERY_MAX_OBJECT
+ * @brief Largest allocation made in the nursery.
+ */
+#define XPOST_MEMORY_NURSERY_MAX_OBJECT 4096
+
+/**
+ * @def XPOST_MEMORY_IS_YOUNG
+ * @brief True if the address @p adr lies in the nursery of @p mem.
+ */
+#define XPOST_MEMORY_IS_YOUNG(mem, adr) \
+    ((unsigned int)(adr) - (mem)->nursery_base < (mem)->nursery_limit - (mem)->nursery_base)
+
 /*
  *
  * Enums
@@ -75,13 +101,16 @@
  * @typedef Xpost_Memory_Table_Mark_Data
  *
  * There are 4 "virtual" bitfields packed in what is assumed to be a
- * 32-bit unsigned field. These values are used in masking and
- * shifting operations to access the fields in a direct, portable
- * manner.
+ * 32-bit unsigned field, plus a flag set while the allocation is on
+ * the free list and a flag set while it is in the remembered set of
+ * the nursery. These values are used in masking and shifting
+ * operations to access the fields in a direct, portable manner.
  */
 typedef enum
 {
-    XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK       = 0x7F000000,
+    XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK       = 0x40000000,
+    XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK = 0x20000000,
+    XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK       = 0x1F000000,
     XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET     =     24,
     XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK   = 0x00FF0000,
     XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET =       16,
@@ -114,6 +143,19 @@ typedef enum
  *
  */
 
+/**
+ * @struct Xpost_Memory_Table_Entry
+ * @brief An entry in the Memory Table, describing one allocation.
+ */
+typedef struct Xpost_Memory_Table_Entry
+{
+    unsigned int adr; /**< allocation address */
+    unsigned int used; /**< size in use */
+    unsigned int sz; /**< size of allocation */
+    unsigned int mark; /**< garbage collection metadata */
+    unsigned int tag; /**< type of object using this allocation, if needed */
+} Xpost_Memory_Table_Entry;
+
 /**
  * @struct Xpost_Memory_Table
  * @brief The segmented Memory Table structure.
@@ -122,16 +164,68 @@ typedef struct Xpost_Memory_Table
 {
     unsigned int nextent; /**< next slot in table */
     unsigned int max; /**< allocated size */
-    struct
-    {
-        unsigned int adr; /**< allocation address */
-        unsigned int used; /**< size in use */
-        unsigned int sz; /**< size of allocation */
-        unsigned int mark; /**< garbage collection metadata */
-        unsigned int tag; /**< type of object using this allocation, if needed */
-    } *tab; /**< table entries */
+    unsigned int npages; /**< size of the page directory */
+    Xpost_Memory_Table_Entry **page; /**< directory of pages of
+                                          #XPOST_MEMORY_TABLE_SIZE entries */
 } Xpost_Memory_Table;
 
+/**
+ * @struct Xpost_Memory_Gc_Stats
+ * @brief Figures recorded by the garbage collector, used to
+ * tune the automatic collection threshold.
+ */
+typedef struct Xpost_Memory_Gc_Stats
+{
+    unsigned int collections; /**< number of collections performed */
+    unsigned int allocated; /**< bytes allocated before the last collection */
+    unsigned int reclaimed; /**< bytes reclaimed by the last collection */
+    unsigned int live; /**< bytes surviving the last collection */
+    unsigned int scale; /**< threshold as a percentage of the live size */
+    unsigned int finalized; /**< files closed by the last collection */
+    unsigned int cut; /**< bytes given back by restore since the last collection */
+} Xpost_Memory_Gc_Stats;
+
+/**
+ * @def XPOST_MEMORY_STATS_TAGS
+ * @brief Number of allocation tags counted apart, one for each object
+ * type. Other tags are counted with tag 0.
+ */
+#define XPOST_MEMORY_STATS_TAGS 17
+
+/**
+ * @struct Xpost_Memory_Stats
+ * @brief Running totals of the allocations and collections of a
+ * memory file, see xpost_stats_get().
+ */
+typedef struct Xpost_Memory_Stats
+{
+    unsigned long allocs[XPOST_MEMORY_STATS_TAGS]; /**< allocations by tag */
+    unsigned long long bytes[XPOST_MEMORY_STATS_TAGS]; /**< bytes allocated by tag */
+    unsigned long free_list_hits; /**< allocations which re-used free storage */
+    unsigned long free_list_misses; /**< allocations which needed fresh storage */
+    unsigned long nursery_allocs; /**< allocations in the nursery */
+    unsigned long grows; /**< times the memory file was grown */
+    unsigned long collections; /**< full collections completed */
+    unsigned long minor_collections; /**< collections of the nursery */
+    unsigned long long mark_us; /**< microseconds spent marking */
+    unsigned long long sweep_us; /**< microseconds spent sweeping and compacting */
+    unsigned long long minor_us; /**< microseconds spent collecting the nursery */
+    unsigned long long reclaimed; /**< bytes reclaimed by all collections */
+} Xpost_Memory_Stats;
+
+/**
+ * @struct Xpost_Memory_Save_Mark
+ * @brief The extent of a memory file when a save level began,
+ * used to cut it back again by xpost_save_rollback().
+ */
+typedef struct Xpost_Memory_Save_Mark
+{
+    unsigned int used; /**< mem->used at the save */
+    unsigned int nextent; /**< mem->table.nextent at the save */
+    unsigned int names; /**< number of names in the name stack at the save */
+    int spoiled; /**< an older ent has since been given storage past used */
+} Xpost_Memory_Save_Mark;
+
 /**
  * @struct Xpost_Memory_File
  * @brief A memory region that may be suballocated. Bookkeeping data
@@ -149,14 +243,49 @@ typedef struct Xpost_Memory_File
     unsigned char *base; /**< pointer to mapped memory */
     unsigned int used;  /**< size used, cursor to free space */
     unsigned int max; /**< size available in memory pointed to by base */
+    unsigned int reserve; /**< size of the address range reserved at base,
+                               or 0 if base moves as the file grows */
 
     struct Xpost_Memory_Table table;
 
     unsigned int start; /**< first 'live' entry in the memory_table. */
         /* the domain of the collector is entries >= start */
 
-    int period;
-    int threshold;
+    unsigned int allocated; /**< bytes allocated since the last collection */
+    unsigned int threshold; /**< allocation volume that triggers a collection */
+    unsigned int vmthreshold; /**< lower bound of threshold, set by `setvmthreshold` */
+    int reclaim_disabled; /**< automatic collection disabled by `vmreclaim` */
+    unsigned int threshold_ratio; /**< multiplier of threshold, larger for global vm */
+    unsigned int sweep; /**< next entry to be swept */
+    unsigned int sweep_limit; /**< end of the pending sweep, or 0 if none */
+    int marking; /**< incremental marking in progress, see xpost_garbage_shade() */
+    unsigned int mark_budget; /**< objects traversed per step of incremental marking, 0 for none */
+    unsigned int nursery_size; /**< size of the nursery to create, 0 for none */
+    unsigned int nursery_base; /**< start of the nursery, 0 until it is created */
+    unsigned int nursery_top; /**< next free byte in the nursery */
+    unsigned int nursery_limit; /**< end of the nursery */
+    unsigned int *young; /**< ents which were given storage in the nursery */
+    unsigned int nyoung; /**< number of ents in young */
+    unsigned int young_max; /**< allocated size of young */
+    unsigned int *remembered; /**< ents outside the nursery which may refer into it */
+    unsigned int nremembered; /**< number of ents in remembered */
+    unsigned int remembered_max; /**< allocated size of remembered */
+    unsigned int *finalize; /**< unreachable file ents waiting to be closed */
+    unsigned int nfinalize; /**< number of ents in finalize */
+    unsigned int finalize_max; /**< allocated size of finalize */
+    int save_pages; /**< save large arrays a page at a time, see xpost_save_save_page() */
+    unsigned int *saved_pages; /**< hash set of ent and page pairs saved at the current level */
+    unsigned int nsaved_pages; /**< number of pairs in saved_pages */
+    unsigned int saved_pages_max; /**< number of slots in saved_pages */
+    unsigned int *name_bindings; /**< per name of global vm, its value's offset in systemdict, see xpost_name_reserve_bindings() */
+    unsigned int name_bindings_max; /**< allocated size of name_bindings */
+    void **code; /**< per ent, the compiled procedure of an array, see xpost_compile.h */
+    unsigned int code_max; /**< allocated size of code */
+    Xpost_Memory_Save_Mark *save_marks; /**< extent of the memory file at each save level */
+    unsigned int nsave_marks; /**< number of marks in save_marks */
+    unsigned int save_marks_max; /**< allocated size of save_marks */
+    Xpost_Memory_Gc_Stats gc; /**< statistics of the last collection */
+    Xpost_Memory_Stats stats; /**< running totals, see xpost_stats_get() */
     int free_list_alloc_is_installed;
     int (*free_list_alloc)(struct Xpost_Memory_File *mem,
                            unsigned sz,
@@ -185,6 +314,25 @@ typedef struct Xpost_Memory_File
  */
 extern size_t xpost_memory_page_size;
 
+/**
+ * @var xpost_memory_reserve_size
+ * @brief The address range reserved for each memory file, or 0.
+ *
+ * If set, the memory files are mapped at the start of a reserved range,
+ * which is committed as they grow, so their base does not move until
+ * they outgrow it. It is set in megabytes by the XPOST_VM_RESERVE
+ * environment variable.
+ */
+extern size_t xpost_memory_reserve_size;
+
+/**
+ * @var xpost_memory_huge_pages
+ * @brief Ask for transparent huge pages in the reserved ranges.
+ *
+ * It is set by the XPOST_VM_HUGEPAGES environment variable.
+ */
+extern int xpost_memory_huge_pages;
+
 
 /*
  *
@@ -195,8 +343,9 @@ extern size_t xpost_memory_page_size;
 /**
  * @brief Initialize the memory module.
  *
- * This function initializes the memory module. Currently, it only set
- * the value of #xpost_memory_page_size. It is called by
+ * This function initializes the memory module. It sets the value of
+ * #xpost_memory_page_size, and those of #xpost_memory_reserve_size and
+ * #xpost_memory_huge_pages from the environment. It is called by
  * xpost_init().
  */
 int xpost_memory_init(void);
@@ -249,6 +398,65 @@ XPCHECKAPI int xpost_memory_file_exit(Xpost_Memory_File *mem);
 XPCHECKAPI int xpost_memory_file_grow(Xpost_Memory_File *mem,
                                       size_t sz);
 
+/**
+ * @brief Release unused pages at the end of the given memory file,
+ * possibly moving the memory and invalidating all vm pointers.
+ *
+ * @param[in,out] mem The memory file
+ * @return 1 on success, 0 on failure.
+ *
+ * This function shrinks the memory available to @p mem to a little
+ * more than the size in use, if that saves at least
+ * #XPOST_MEMORY_SHRINK_PAGES pages, and returns the rest to the system.
+ */
+XPCHECKAPI int xpost_memory_file_shrink(Xpost_Memory_File *mem);
+
+/**
+ * @brief Note that an ent was given new storage.
+ *
+ * @param[in,out] mem The memory file
+ * @param[in] ent The ent
+ * @param[in] adr The address of its new storage
+ *
+ * Each save level records the extent of @p mem in mem->save_marks.
+ * The level can no longer be rolled back if @p ent predates it and
+ * @p adr lies beyond it, so the mark is spoiled. Storage in the
+ * nursery is not affected by a rollback and is ignored.
+ */
+void xpost_memory_save_marks_spoil(Xpost_Memory_File *mem,
+                                   unsigned int ent,
+                                   unsigned int adr);
+
+/**
+ * @brief Discard the compiled procedures of a range of ents.
+ *
+ * @param[in,out] mem The memory file
+ * @param[in] ent The first ent
+ * @param[in] end One past the last ent, or 0 for all after @p ent.
+ *
+ * An array whose contents change, or whose ent is freed, must lose
+ * the code compiled from it in mem->code.
+ */
+void xpost_memory_discard_code(Xpost_Memory_File *mem,
+                               unsigned int ent,
+                               unsigned int end);
+
+/**
+ * @brief Return the pages of an unused region of the given memory file
+ * to the system.
+ *
+ * @param[in,out] mem The memory file
+ * @param[in] adr The offset of the region.
+ * @param[in] sz The size of the region.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function releases the whole pages which lie inside the region
+ * of @p sz bytes at @p adr. The region reads as zeros afterwards.
+ */
+XPCHECKAPI int xpost_memory_file_discard(Xpost_Memory_File *mem,
+                                         unsigned int adr,
+                                         unsigned int sz);
+
 /**
  * @brief Allocate memory in the given memory file and return offset.
  *
@@ -312,6 +520,23 @@ int xpost_memory_register_garbage_collect_function(Xpost_Memory_File *mem,
                                                                           int dosweep,
                                                                           int markall));
 
+/**
+ * @brief Get the table entry of an entity.
+ *
+ * @param[in] tab The memory table.
+ * @param[in] ent The entity.
+ * @return A pointer to the entry.
+ *
+ * This function does no range-checking, @p ent must be less than
+ * tab->nextent. The pointer remains valid as the table grows.
+ */
+static inline Xpost_Memory_Table_Entry *
+xpost_memory_table_entry(const Xpost_Memory_Table *tab,
+                         unsigned int ent)
+{
+    return &tab->page[ent / XPOST_MEMORY_TABLE_SIZE][ent % XPOST_MEMORY_TABLE_SIZE];
+}
+
 /**
  * @brief Allocate memory, returns table index.
  *
@@ -333,6 +558,22 @@ XPCHECKAPI int xpost_memory_table_alloc(Xpost_Memory_File *mem,
                                         unsigned int tag,
                                         unsigned int *entity);
 
+/**
+ * @brief Add an entity for memory already allocated.
+ *
+ * @param[in,out] mem The memory file.
+ * @param[in] adr The address of the memory.
+ * @param[in] sz The allocation size.
+ * @param[in] tag The allocation tag.
+ * @param[out] entity The table index.
+ * @return 1 on success, 0 on failure.
+ */
+XPCHECKAPI int xpost_memory_table_alloc_ent(Xpost_Memory_File *mem,
+                                            unsigned int adr,
+                                            unsigned int sz,
+                                            unsigned int tag,
+                                            unsigned int *entity);
+
 /**
  * @brief Get the address from an entity.
  *
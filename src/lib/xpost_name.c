@@ -47,6 +47,7 @@
 //#include "xpost_interpreter.h"  // initialize interpreter to test
 #include "xpost_error.h"
 #include "xpost_string.h"  // access string objects
+#include "xpost_dict.h"  // names are bound to systemdict
 #include "xpost_name.h"  // double-check prototypes
 
 #define CNT_STR(s) sizeof(s)-1, s
@@ -110,8 +111,8 @@ int xpost_name_init(Xpost_Context *ctx)
 
     xpost_stack_init(ctx->gl, &t);
     tab = &ctx->gl->table; //recalc pointer
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK].adr = t;
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = 0;
+    xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK)->adr = t;
+    xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE)->adr = 0;
     xpost_memory_table_get_addr(ctx->gl,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &nstk);
     xpost_stack_push(ctx->gl, nstk, xpost_string_cons(ctx, CNT_STR("_not_a_name_")));
@@ -137,8 +138,8 @@ int xpost_name_init(Xpost_Context *ctx)
 
     xpost_stack_init(ctx->lo, &t);
     tab = &ctx->lo->table; //recalc pointer
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK].adr = t;
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = 0;
+    xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK)->adr = t;
+    xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE)->adr = 0;
     xpost_memory_table_get_addr(ctx->lo,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &nstk);
     xpost_stack_push(ctx->lo, nstk, xpost_string_cons(ctx, CNT_STR("_not_a_name_")));
@@ -224,6 +225,34 @@ int tstinsert(Xpost_Memory_File *mem,
     return 0;
 }
 
+/* make room for the binding slots of names up to n */
+int xpost_name_reserve_bindings(Xpost_Memory_File *mem,
+                                unsigned int n)
+{
+    unsigned int *tmp;
+    unsigned int max;
+    unsigned int i;
+
+    if (n < mem->name_bindings_max)
+        return 1;
+    max = mem->name_bindings_max ? mem->name_bindings_max : 1024;
+    while (max <= n)
+        max *= 2;
+    tmp = realloc(mem->name_bindings, max * sizeof *tmp);
+    if (!tmp)
+    {
+        XPOST_LOG_ERR("cannot grow name bindings");
+        return 0;
+    }
+    for (i = mem->name_bindings_max; i < n; i++)
+        tmp[i] = XPOST_DICT_NAME_SHADOWED; /* untracked */
+    for ( ; i < max; i++)
+        tmp[i] = 0;
+    mem->name_bindings = tmp;
+    mem->name_bindings_max = max;
+    return 1;
+}
+
 /* add the name to the name stack, return index */
 static
 unsigned int addname(Xpost_Context *ctx,
@@ -237,6 +266,8 @@ unsigned int addname(Xpost_Context *ctx,
     xpost_memory_table_get_addr(mem,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &names);
     u = xpost_stack_count(mem, names);
+    if (mem == ctx->gl && !xpost_name_reserve_bindings(mem, u))
+        return 0;
 
     //xpost_memory_file_dump(ctx->gl);
     //dumpmtab(ctx->gl, 0);
@@ -281,14 +312,13 @@ Xpost_Object xpost_name_cons(Xpost_Context *ctx,
         if (!u) {
             Xpost_Memory_File *mem = ctx->vmmode==GLOBAL?ctx->gl:ctx->lo;
             Xpost_Memory_Table *tab = &mem->table;
-            ret = tstinsert(mem, tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr, s, &t);
+            ret = tstinsert(mem, xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE)->adr, s, &t);
             if (ret)
             {
                 //this can only be a VMerror
                 return invalid;
             }
-            tab = &mem->table; //recalc pointer
-            tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = t;
+            xpost_memory_table_entry(tab, XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE)->adr = t;
             u = addname(ctx, s); // obeys vmmode
             o.mark_.tag = nametype | (ctx->vmmode==GLOBAL?XPOST_OBJECT_TAG_DATA_FLAG_BANK:0);
             o.mark_.pad0 = 0;
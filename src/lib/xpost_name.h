@@ -55,6 +55,20 @@ int xpost_name_init(Xpost_Context *ctx);
 Xpost_Object xpost_name_cons(Xpost_Context *ctx, const char *s);
 Xpost_Object xpost_name_get_string(Xpost_Context *ctx, Xpost_Object n);
 
+/**
+ * @brief make room in mem->name_bindings for the names up to n.
+ *
+ * Each name of global vm has a binding slot, which holds the
+ * offset of its value in systemdict, 0 if it has not been
+ * found there, or XPOST_DICT_NAME_SHADOWED if it is a key in some
+ * other dict. Slots of names after n start at 0. Slots of names
+ * before n which did not have one, if an earlier call failed,
+ * start shadowed, as nothing is known of them.
+ *
+ * returns 1 on success, 0 if the slots cannot be allocated.
+ */
+int xpost_name_reserve_bindings(Xpost_Memory_File *mem, unsigned int n);
+
 /**
  * @}
  */
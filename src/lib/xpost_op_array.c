@@ -313,14 +313,10 @@ int xpost_op_array_proc_forall(Xpost_Context *ctx,
 int xpost_oper_init_array_ops (Xpost_Context *ctx,
                                Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
     int ret;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "array", (Xpost_Op_Func)xpost_op_int_array, 1, 1,
             integertype);
@@ -231,14 +231,10 @@ int xpost_op_int_int_bitshift (Xpost_Context *ctx,
 int xpost_oper_init_bool_ops(Xpost_Context *ctx,
                              Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
     int ret;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "eq", (Xpost_Op_Func)xpost_op_any_any_eq, 1, 2, anytype, anytype);
     INSTALL;
@@ -195,13 +195,9 @@ int xpost_op_detach (Xpost_Context *ctx, Xpost_Object context)
 int xpost_oper_init_context_ops (Xpost_Context *ctx,
                                  Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
     //xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
     op = xpost_operator_cons(ctx, "currentcontext", (Xpost_Op_Func)xpost_op_currentcontext, 1, 0);
     INSTALL;
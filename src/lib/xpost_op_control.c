@@ -362,13 +362,9 @@ int xpost_op_quit(Xpost_Context *ctx)
 int xpost_oper_init_control_ops (Xpost_Context *ctx,
                                  Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "exec", (Xpost_Op_Func)xpost_op_any_exec, 0, 1, anytype);
     INSTALL;
@@ -143,6 +143,7 @@ int xpost_op_dict_begin(Xpost_Context *ctx,
 {
     if (!xpost_stack_push(ctx->lo, ctx->ds, D))
         return dictstackoverflow;
+    ++xpost_dict_epoch;
     return 0;
 }
 
@@ -154,6 +155,7 @@ int xpost_op_end(Xpost_Context *ctx)
     if (xpost_stack_count(ctx->lo, ctx->ds) <= 3)
         return dictstackunderflow;
     (void)xpost_stack_pop(ctx->lo, ctx->ds);
+    ++xpost_dict_epoch;
     return 0;
 }
 
@@ -175,40 +177,131 @@ int xpost_op_any_any_def(Xpost_Context *ctx,
     return 0;
 }
 
-/* key  load  value
-   search dict stack for key and return associated value */
-int xpost_op_any_load(Xpost_Context *ctx,
-                      Xpost_Object K)
+/* where a name was last found on the dict stack,
+   good while xpost_dict_epoch is unchanged.
+   shared by the contexts, mainloop() changes the epoch when it switches. */
+typedef struct
+{
+    unsigned int epoch;
+    Xpost_Object name;
+    Xpost_Memory_File *mem;  /* of the dict */
+    const Xpost_Memory_Table_Entry *te;  /* of the dict, so it may move */
+    unsigned int off;  /* of the value in the dict */
+} Xpost_Op_Dict_Load_Cache;
+
+/* direct-mapped by name index. name indices are dense, so this
+   covers the names of a program's inner loops */
+#define XPOST_OP_DICT_LOAD_CACHE_SIZE 1024
+
+static
+Xpost_Op_Dict_Load_Cache _xpost_op_dict_load_cache[XPOST_OP_DICT_LOAD_CACHE_SIZE];
+
+/* search dict stack for key and return associated value.
+   names are looked up through the load cache, and global names
+   which are keys only in systemdict through their binding slot. */
+int xpost_op_dict_stack_lookup(Xpost_Context *ctx,
+                               Xpost_Object K,
+                               Xpost_Object *pval)
 {
+    Xpost_Op_Dict_Load_Cache *c = NULL;
     int i;
-    int z = xpost_stack_count(ctx->lo, ctx->ds);
-    if (DEBUGLOAD)
+    int z;
+
+    if (xpost_object_get_type(K) == nametype)
     {
-        printf("\nload:");
-        xpost_object_dump(K);
-        xpost_stack_dump(ctx->lo, ctx->ds);
+        c = &_xpost_op_dict_load_cache[K.mark_.padw % XPOST_OP_DICT_LOAD_CACHE_SIZE];
+        if (c->epoch == xpost_dict_epoch &&
+            c->name.mark_.padw == K.mark_.padw &&
+            !((c->name.tag ^ K.tag) & (XPOST_OBJECT_TAG_DATA_TYPE_MASK | XPOST_OBJECT_TAG_DATA_FLAG_BANK)))
+        {
+            *pval = *(Xpost_Object *)(c->mem->base + c->te->adr + c->off);
+            return 1;
+        }
     }
 
-    xpost_stack_push(ctx->lo, ctx->hold, K);
+    /* a global name which is a key only in systemdict */
+    if ((K.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK) && c
+        && K.mark_.padw < ctx->gl->name_bindings_max)
+    {
+        unsigned int off = ctx->gl->name_bindings[K.mark_.padw];
+        if (off && off != XPOST_DICT_NAME_SHADOWED)
+        {
+            Xpost_Object sd = xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0);
+            const Xpost_Memory_Table_Entry *te =
+                xpost_memory_table_entry(&ctx->gl->table, xpost_object_get_ent(sd));
+
+            *pval = *(Xpost_Object *)(ctx->gl->base + te->adr + off);
+            c->epoch = xpost_dict_epoch;
+            c->name = K;
+            c->mem = ctx->gl;
+            c->te = te;
+            c->off = off;
+            return 1;
+        }
+    }
 
+    z = xpost_stack_count(ctx->lo, ctx->ds);
     for (i = 0; i < z; i++)
     {
-        Xpost_Object x;
         Xpost_Object D = xpost_stack_topdown_fetch(ctx->lo,ctx->ds,i);
+        Xpost_Memory_File *mem = xpost_context_select_memory(ctx, D);
+        unsigned int off;
 
         if (DEBUGLOAD)
         {
-            xpost_dict_dump_memory (xpost_context_select_memory(ctx, D), D);
+            xpost_dict_dump_memory (mem, D);
             (void)puts("");
         }
 
-        x = xpost_dict_get(ctx, D, K);
-        if (xpost_object_get_type(x) != invalidtype)
+        off = xpost_dict_find_value_offset(ctx, mem, D, K);
+        if (off)
         {
-            xpost_stack_push(ctx->lo, ctx->os, x);
-            return 0;
+            const Xpost_Memory_Table_Entry *te =
+                xpost_memory_table_entry(&mem->table, xpost_object_get_ent(D));
+
+            *pval = *(Xpost_Object *)(mem->base + te->adr + off);
+            if (xpost_object_get_type(*pval) == magictype)
+            {   /* computed on each lookup */
+                *pval = xpost_dict_get_memory(ctx, mem, D, K);
+                return 1;
+            }
+            if (i == z - 1)
+                xpost_dict_bind_name(ctx, K, off);
+            if (c)
+            {
+                c->epoch = xpost_dict_epoch;
+                c->name = K;
+                c->mem = mem;
+                c->te = te;
+                c->off = off;
+            }
+            return 1;
         }
     }
+    return 0;
+}
+
+/* key  load  value
+   search dict stack for key and return associated value */
+int xpost_op_any_load(Xpost_Context *ctx,
+                      Xpost_Object K)
+{
+    Xpost_Object x;
+
+    if (DEBUGLOAD)
+    {
+        printf("\nload:");
+        xpost_object_dump(K);
+        xpost_stack_dump(ctx->lo, ctx->ds);
+    }
+
+    xpost_stack_push(ctx->lo, ctx->hold, K);
+
+    if (xpost_op_dict_stack_lookup(ctx, K, &x))
+    {
+        xpost_stack_push(ctx->lo, ctx->os, x);
+        return 0;
+    }
 
     if (DEBUGLOAD)
     {
@@ -483,6 +576,7 @@ int xpost_op_cleardictstack(Xpost_Context *ctx)
     {
         (void)xpost_stack_pop(ctx->lo, ctx->ds);
     }
+    ++xpost_dict_epoch;
     /*
     Xpost_Stack *ds;
     unsigned int dsaddr;
@@ -502,14 +596,10 @@ int xpost_op_cleardictstack(Xpost_Context *ctx)
 int xpost_oper_init_dict_ops (Xpost_Context *ctx,
                               Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
     int ret;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "dict", (Xpost_Op_Func)xpost_op_int_dict, 1, 1, integertype);
     INSTALL;
     ret = xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "<<"), mark);
@@ -35,6 +35,7 @@
 
 extern int DEBUGLOAD;
 
+int xpost_op_dict_stack_lookup(Xpost_Context *ctx, Xpost_Object K, Xpost_Object *pval);
 int xpost_op_any_load(Xpost_Context *ctx, Xpost_Object K);
 int xpost_oper_init_dict_ops(Xpost_Context *ctx, Xpost_Object sd);
 
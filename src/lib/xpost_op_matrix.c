@@ -557,13 +557,9 @@ int _invert_matrix(Xpost_Context *ctx,
 int xpost_oper_init_matrix_ops(Xpost_Context *ctx,
                                Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "matrix", (Xpost_Op_Func)_matrix, 1, 0);
     INSTALL;
@@ -56,6 +56,7 @@
 #include "xpost_string.h"
 #include "xpost_array.h"
 #include "xpost_dict.h"
+#include "xpost_compile.h"  /* bind compiles procedures */
 
 //#include "xpost_interpreter.h"
 #include "xpost_operator.h"
@@ -95,11 +96,14 @@ Xpost_Object bind(Xpost_Context *ctx,
                 }
         }
     }
-    return xpost_object_set_access(ctx, p, XPOST_OBJECT_TAG_ACCESS_READ_ONLY);
+    p = xpost_object_set_access(ctx, p, XPOST_OBJECT_TAG_ACCESS_READ_ONLY);
+    (void) xpost_compile_proc(ctx, p);
+    return p;
 }
 
 /* proc  bind  proc
-   replace names with operators in proc and make read-only */
+   replace names with operators in proc and make read-only,
+   and compile it */
 static
 int Pbind(Xpost_Context *ctx,
           Xpost_Object P)
@@ -108,6 +112,17 @@ int Pbind(Xpost_Context *ctx,
     return 0;
 }
 
+/* proc  .compile  proc
+   compile proc as it is, without binding it */
+static
+int Pcompile(Xpost_Context *ctx,
+             Xpost_Object P)
+{
+    (void) xpost_compile_proc(ctx, P);
+    xpost_stack_push(ctx->lo, ctx->os, P);
+    return 0;
+}
+
 /* -  realtime  int
    return real time in milliseconds */
 static
@@ -279,9 +294,7 @@ int returntocaller(Xpost_Context *ctx)
 int xpost_oper_init_misc_ops(Xpost_Context *ctx,
                              Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     const char *productstr = "Xpost";
     const char *versionstr = "0.0";
@@ -289,11 +302,11 @@ int xpost_oper_init_misc_ops(Xpost_Context *ctx,
     int serno = 0;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "bind", (Xpost_Op_Func)Pbind, 1, 1, proctype);
     INSTALL;
+    op = xpost_operator_cons(ctx, ".compile", (Xpost_Op_Func)Pcompile, 1, 1, proctype);
+    INSTALL;
     xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "null"), null);
     xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "version"),
                    xpost_object_cvlit(xpost_string_cons(ctx, strlen(versionstr), versionstr)));
@@ -33,6 +33,7 @@
 #endif
 
 #include <assert.h>
+#include <limits.h> /* INT_MAX */
 #include <stdio.h>
 #include <stdlib.h> /* NULL strtod */
 #include <string.h>
@@ -47,6 +48,7 @@
 #include "xpost_name.h"
 #include "xpost_string.h"
 #include "xpost_dict.h"
+#include "xpost_array.h"
 #include "xpost_error.h"
 
 #include "xpost_garbage.h"
@@ -61,23 +63,69 @@ int vmreclaim (Xpost_Context *ctx, Xpost_Object I)
     {
         default: return rangecheck;
         case -2: /* disable automatic collection in local and global vm */
+            ctx->lo->reclaim_disabled = 1;
+            ctx->gl->reclaim_disabled = 1;
             break;
         case -1: /* disable automatic collection in local vm */
+            ctx->lo->reclaim_disabled = 1;
             break;
         case 0: /* enable automatic collection */
+            ctx->lo->reclaim_disabled = 0;
+            ctx->gl->reclaim_disabled = 0;
             break;
         case 1: /* perform immediate collection in local vm */
             if (ctx->garbage_collect_function(ctx->lo, 1, 0) == -1)
                 return VMerror;
+            (void) xpost_garbage_sweep_finish(ctx->lo);
             break;
         case 2: /* perform immediate collection in local and global vm */
+            if (ctx->garbage_collect_function(ctx->lo, 1, 0) == -1)
+                return VMerror;
+            (void) xpost_garbage_sweep_finish(ctx->lo);
             if (ctx->garbage_collect_function(ctx->gl, 1, 1) == -1)
                 return VMerror;
+            (void) xpost_garbage_sweep_finish(ctx->gl);
             break;
     }
     return 0;
 }
 
+/* set the allocation volume that triggers automatic collection,
+   -1 restores the default */
+static
+int setvmthreshold (Xpost_Context *ctx, Xpost_Object I)
+{
+    if (I.int_.val < -1)
+        return rangecheck;
+    (void) xpost_garbage_set_threshold(ctx->lo, I.int_.val);
+    (void) xpost_garbage_set_threshold(ctx->gl, I.int_.val);
+    return 0;
+}
+
+/* set the number of objects traversed at each step of an incremental
+   collection of local vm, 0 collects all at once */
+static
+int setvmmarkbudget (Xpost_Context *ctx, Xpost_Object I)
+{
+    if (I.int_.val < 0)
+        return rangecheck;
+    ctx->lo->mark_budget = (unsigned int)I.int_.val;
+    if (!ctx->lo->mark_budget && ctx->lo->marking)
+        if (ctx->garbage_collect_function(ctx->lo, 1, 0) == -1) /* finish marking */
+            return VMerror;
+    return 0;
+}
+
+/* choose whether save copies just the changed page of a large array
+   in local and global vm, or the whole array */
+static
+int setvmsavepages (Xpost_Context *ctx, Xpost_Object B)
+{
+    ctx->lo->save_pages = B.int_.val;
+    ctx->gl->save_pages = B.int_.val;
+    return 0;
+}
+
 static
 int vmstatus (Xpost_Context *ctx)
 {
@@ -128,24 +176,95 @@ int globalvmstatus (Xpost_Context *ctx)
     return 0;
 }
 
+/* a counter as an integer object, saturating */
+static
+Xpost_Object _count(unsigned long long n)
+{
+    return xpost_int_cons(n > INT_MAX ? INT_MAX : (integer)n);
+}
+
+/* bool  .vmstatus  dict
+   return the running totals of the allocations and collections
+   of local, or if bool is true, global vm. times are in milliseconds */
+static
+int Bvmstatus (Xpost_Context *ctx, Xpost_Object B)
+{
+    Xpost_Stats stats;
+    Xpost_Object d, count, bytes;
+    int i;
+
+    if (!xpost_stats_get(ctx, B.int_.val, &stats))
+        return VMerror;
+
+    /* keep each part reachable while the next is allocated */
+    d = xpost_dict_cons(ctx, 16);
+    if (xpost_object_get_type(d) == nulltype)
+        return VMerror;
+    if (!xpost_stack_push(ctx->lo, ctx->os, d))
+        return stackoverflow;
+    count = xpost_array_cons(ctx, XPOST_STATS_TAGS);
+    if (xpost_object_get_type(count) == nulltype)
+        return VMerror;
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "AllocCount"), count);
+    bytes = xpost_array_cons(ctx, XPOST_STATS_TAGS);
+    if (xpost_object_get_type(bytes) == nulltype)
+        return VMerror;
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "AllocBytes"), bytes);
+    for (i = 0; i < XPOST_STATS_TAGS; i++)
+    {
+        xpost_array_put(ctx, count, i, _count(stats.allocs[i]));
+        xpost_array_put(ctx, bytes, i, xpost_real_cons((real)stats.bytes[i]));
+    }
+
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "FreeListHits"),
+                   _count(stats.free_list_hits));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "FreeListMisses"),
+                   _count(stats.free_list_misses));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "NurseryAllocs"),
+                   _count(stats.nursery_allocs));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "Grows"),
+                   _count(stats.grows));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "Collections"),
+                   _count(stats.collections));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "MinorCollections"),
+                   _count(stats.minor_collections));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "MarkTime"),
+                   xpost_real_cons((real)stats.mark_us / 1000));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "SweepTime"),
+                   xpost_real_cons((real)stats.sweep_us / 1000));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "MinorTime"),
+                   xpost_real_cons((real)stats.minor_us / 1000));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "Reclaimed"),
+                   xpost_real_cons((real)stats.reclaimed));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "Used"),
+                   _count(stats.used));
+    xpost_dict_put(ctx, d, xpost_name_cons(ctx, "Max"),
+                   _count(stats.max));
+    return 0;
+}
+
 
 int xpost_oper_init_param_ops(Xpost_Context *ctx,
                               Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "vmreclaim", (Xpost_Op_Func)vmreclaim, 0, 1, integertype);
     INSTALL;
+    op = xpost_operator_cons(ctx, "setvmthreshold", (Xpost_Op_Func)setvmthreshold, 0, 1, integertype);
+    INSTALL;
+    op = xpost_operator_cons(ctx, ".setvmmarkbudget", (Xpost_Op_Func)setvmmarkbudget, 0, 1, integertype);
+    INSTALL;
+    op = xpost_operator_cons(ctx, ".setvmsavepages", (Xpost_Op_Func)setvmsavepages, 0, 1, booleantype);
+    INSTALL;
     op = xpost_operator_cons(ctx, "vmstatus", (Xpost_Op_Func)vmstatus, 3, 0);
     INSTALL;
     op = xpost_operator_cons(ctx, "globalvmstatus", (Xpost_Op_Func)globalvmstatus, 3, 0);
     INSTALL;
+    op = xpost_operator_cons(ctx, ".vmstatus", (Xpost_Op_Func)Bvmstatus, 1, 1, booleantype);
+    INSTALL;
 
     /* xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
     op = xpost_operator_cons(ctx, "save", (Xpost_Op_Func)Zsave, 1, 0);
@@ -847,13 +847,9 @@ int _flattenpath (Xpost_Context *ctx)
 int xpost_oper_init_path_ops(Xpost_Context *ctx,
                              Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     if (xpost_object_get_type((namegraphicsdict = xpost_name_cons(ctx, "graphicsdict"))) == invalidtype)
         return VMerror;
@@ -959,6 +955,8 @@ int xpost_oper_init_path_ops(Xpost_Context *ctx,
         xpost_array_put(ctx, _arc_start_proc, 5, false_clause);
     }
     xpost_array_put(ctx, _arc_start_proc, 6, xpost_object_cvx(xpost_name_cons(ctx, "ifelse")));
+    /* keep a reference in systemdict so global collections see it */
+    xpost_dict_put(ctx, sd, xpost_name_cons(ctx, ".arcstartproc"), _arc_start_proc);
 
     return 0;
 }
@@ -48,6 +48,7 @@
 #include "xpost_name.h"
 #include "xpost_string.h"
 #include "xpost_dict.h"
+#include "xpost_garbage.h"
 
 //#include "xpost_interpreter.h"
 #include "xpost_operator.h"
@@ -82,10 +83,16 @@ int Vrestore(Xpost_Context *ctx,
         return VMerror;
     }
     z = xpost_stack_count(ctx->lo, vs);
-    while(z > V.save_.lev)
+    /* cut the vm back to the save, if nothing made since is in use */
+    if (z > V.save_.lev && !xpost_save_rollback(ctx->lo, V.save_.lev))
     {
-        xpost_save_restore_snapshot(ctx->lo);
-        z--;
+        while(z > V.save_.lev)
+        {
+            xpost_save_restore_snapshot(ctx->lo);
+            z--;
+        }
+        /* what was allocated since the save is garbage now */
+        (void) xpost_garbage_free_newer(ctx->lo, V.save_.lev + 1);
     }
     printf("restore\n");
     return 0;
@@ -151,13 +158,9 @@ int Zvmstatus(Xpost_Context *ctx)
 int xpost_oper_init_save_ops(Xpost_Context *ctx,
                              Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "save", (Xpost_Op_Func)Zsave, 1, 0);
     INSTALL;
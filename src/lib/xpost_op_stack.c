@@ -70,8 +70,12 @@ int AAexch(Xpost_Context *ctx,
            Xpost_Object x,
            Xpost_Object y)
 {
-    xpost_stack_push(ctx->lo, ctx->os, y);
-    xpost_stack_push(ctx->lo, ctx->os, x);
+    Xpost_Object yx[2];
+
+    yx[0] = y;
+    yx[1] = x;
+    if (!xpost_stack_push_n(ctx->lo, ctx->os, yx, 2))
+        return stackoverflow;
     return 0;
 }
 
@@ -93,15 +97,12 @@ static
 int Icopy(Xpost_Context *ctx,
           Xpost_Object n)
 {
-    int i;
     if (n.int_.val < 0)
         return rangecheck;
     if (n.int_.val > xpost_stack_count(ctx->lo, ctx->os))
         return stackunderflow;
-    for (i=0; i < n.int_.val; i++)
-        if (!xpost_stack_push(ctx->lo, ctx->os,
-                              xpost_stack_topdown_fetch(ctx->lo, ctx->os, n.int_.val - 1)))
-            return stackoverflow;
+    if (!xpost_stack_copy(ctx->lo, ctx->os, n.int_.val))
+        return stackoverflow;
     return 0;
 }
 
@@ -129,48 +130,10 @@ int IIroll(Xpost_Context *ctx,
            Xpost_Object N,
            Xpost_Object J)
 {
-    Xpost_Object *t;
-    Xpost_Object r;
-    int i;
-    int n = N.int_.val;
-    int j = J.int_.val;
-    if (n < 0)
+    if (N.int_.val < 0)
         return rangecheck;
-    if (n == 0) return 0;
-    if (j < 0) j = n - ((- j) % n);
-    j %= n;
-    if (j == 0) return 0;
-
-    t = malloc((n - j) * sizeof(Xpost_Object));
-    for (i = 0; i < n-j; i++)
-    {
-        r = xpost_stack_topdown_fetch(ctx->lo, ctx->os, n - 1 - i);
-        if (xpost_object_get_type(r) == invalidtype){
-	    free(t);
-            return stackunderflow;
-	}
-        t[i] = r;
-    }
-    for (i = 0; i < j; i++)
-    {
-        r = xpost_stack_topdown_fetch(ctx->lo, ctx->os, j - 1 - i);
-        if (xpost_object_get_type(r) == invalidtype){
-	    free(t);
-            return stackunderflow;
-	}
-        if (!xpost_stack_topdown_replace(ctx->lo, ctx->os, n - 1 - i, r)){
-	    free(t);
-            return stackunderflow;
-	}
-    }
-    for (i = 0; i < n-j; i++)
-    {
-        if (!xpost_stack_topdown_replace(ctx->lo, ctx->os, n - j - 1 - i, t[i])){
-	    free(t);
-            return stackunderflow;
-	}
-    }
-    free(t);
+    if (!xpost_stack_roll(ctx->lo, ctx->os, N.int_.val, J.int_.val))
+        return stackunderflow;
     return 0;
 }
 
@@ -182,13 +145,6 @@ int Zclear(Xpost_Context *ctx)
     //Xpost_Stack *s = (void *)(ctx->lo->base + ctx->os);
     //s->top = 0;
     xpost_stack_clear(ctx->lo, ctx->os);
-#if 0
-    if (s->nextseg) /* trim the stack */
-    {
-        xpost_stack_free(ctx->lo, s->nextseg);
-        s->nextseg = 0;
-    }
-#endif
     return 0;
 }
 
@@ -210,13 +166,19 @@ int Zcount(Xpost_Context *ctx)
    discard elements down through mark */
 int xpost_op_cleartomark(Xpost_Context *ctx)
 {
-    Xpost_Object o;
-    do {
-        o = xpost_stack_pop(ctx->lo, ctx->os);
-        if (xpost_object_get_type(o) == invalidtype)
-            return unmatchedmark;
-    } while (o.tag != marktype);
-    return 0;
+    unsigned i;
+    unsigned z;
+    z = xpost_stack_count(ctx->lo, ctx->os);
+    for (i = 0; i < z; i++)
+    {
+        if (xpost_stack_topdown_fetch(ctx->lo, ctx->os, i).tag == marktype)
+        {
+            (void)xpost_stack_pop_n(ctx->lo, ctx->os, NULL, i + 1);
+            return 0;
+        }
+    }
+    xpost_stack_clear(ctx->lo, ctx->os);
+    return unmatchedmark;
 }
 
 /* mark obj1..objN  counttomark  N
@@ -240,13 +202,9 @@ int xpost_op_counttomark(Xpost_Context *ctx)
 int xpost_oper_init_stack_ops(Xpost_Context *ctx,
                               Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "pop", (Xpost_Op_Func)Apop, 0, 1, anytype);
     INSTALL;
     op = xpost_operator_cons(ctx, "exch", (Xpost_Op_Func)AAexch, 2, 2, anytype, anytype);
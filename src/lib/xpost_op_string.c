@@ -291,13 +291,9 @@ int Sforall(Xpost_Context *ctx,
 int xpost_oper_init_string_ops (Xpost_Context *ctx,
                                 Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "string", (Xpost_Op_Func)Istring, 1, 1,
                              integertype);
     INSTALL;
@@ -393,7 +393,6 @@ int AScvs (Xpost_Context *ctx,
     char smark[] = "-mark-";
     char ssave[] = "-save-";
     int n;
-    int ret;
 
     switch(xpost_object_get_type(any))
     {
@@ -462,25 +461,7 @@ int AScvs (Xpost_Context *ctx,
             break;
 
         case operatortype:
-        {
-            unsigned int optadr;
-            Xpost_Operator *optab;
-            Xpost_Operator op;
-            Xpost_Object_Mark nm;
-            ret = xpost_memory_table_get_addr(ctx->gl,
-                                              XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-            if (!ret)
-            {
-                XPOST_LOG_ERR("cannot load optab!");
-                return VMerror;
-            }
-            optab = (void *)(ctx->gl->base + optadr);
-            op = optab[any.mark_.padw];
-            nm.tag = nametype | XPOST_OBJECT_TAG_DATA_FLAG_BANK;
-            nm.pad0 = 0;
-            nm.padw = op.name;
-            any.mark_ = nm;
-        }
+            any = xpost_operator_get_name(any.mark_.padw);
         /*@fallthrough@*/
         case nametype:
             any = xpost_name_get_string(ctx, any);
@@ -500,13 +481,9 @@ int AScvs (Xpost_Context *ctx,
 int xpost_oper_init_type_ops(Xpost_Context *ctx,
                              Xpost_Object sd)
 {
-    Xpost_Operator *optab;
     Xpost_Object n,op;
-    unsigned int optadr;
 
     assert(ctx->gl->base);
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 
     op = xpost_operator_cons(ctx, "type", (Xpost_Op_Func)Atype, 1, 1, anytype);
     INSTALL;
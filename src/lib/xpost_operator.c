@@ -45,12 +45,12 @@
 #include "xpost_memory.h"  // accesses mfile
 #include "xpost_object.h"  // operators are objects
 #include "xpost_stack.h"  // uses a stack for argument passing
-#include "xpost_free.h"  // grow signatures using xpost_free_realloc
 #include "xpost_context.h"
 #include "xpost_error.h"  // operator functions may throw errors
 #include "xpost_string.h"  // uses string function to dump operator name
 #include "xpost_name.h"  // operator objects have associated names
 #include "xpost_dict.h"  // install operators in systemdict, a dict
+#include "xpost_garbage.h"  // arguments moved to hold are seen by incremental marking
 
 //#include "xpost_interpreter.h"  // works with context struct
 #include "xpost_operator.h"  // double-check prototypes
@@ -63,278 +63,161 @@ Xpost_Object _promote_integer_to_real(Xpost_Object o)
     return xpost_real_cons((real)o.int_.val);
 }
 
-/* copied from the header file for reference:
-   typedef struct Xpost_Signature {
-   int (*fp)(Xpost_Context *ctx);
-   int in;
-   unsigned t;
-   int (*checkstack)(Xpost_Context *ctx);
-   int out;
-   } Xpost_Signature;
-
-   typedef struct Xpost_Operator {
-   unsigned name;
-   int n; // number of sigs
-   unsigned sigadr;
-   } Xpost_Operator;
-
-   enum typepat ( anytype = stringtype + 1,
-   floattype, numbertype, proctype };
-
-   #define MAXOPS 20
-*/
+/* the optab: process-global, in C memory, indexed by opcode */
+static
+Xpost_Operator *_xpost_optab = NULL;
 
 /* the number of ops, at any given time. */
 static
 int _xpost_noops = 0;
 
+/* the number of ops _xpost_optab has room for */
 static
-int _stack_none(Xpost_Context *ctx)
-{
-    (void)ctx;
-    return 0;
-}
+int _xpost_maxops = 0;
 
+/* the type code of an object, as matched by the signature masks */
 static
-int _stack_int(Xpost_Context *ctx)
+unsigned _xpost_operator_type_code(Xpost_Object o)
 {
-    Xpost_Object s0;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            return 0;
-        default:
-            return typecheck;
-    }
+    unsigned t = xpost_object_get_type(o);
+    if (t == arraytype && xpost_object_is_exe(o))
+        return XPOST_OPERATOR_TYPE_PROC;
+    return t;
 }
 
+/* compile the type pattern sig->t into sig->mask and sig->promote */
 static
-int _stack_real(Xpost_Context *ctx)
+void _xpost_operator_compile(Xpost_Signature *sig)
 {
-    Xpost_Object s0;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case realtype:
-            return 0;
-        default:
-            return typecheck;
-    }
-}
+    int j;
 
-static
-int _stack_float(Xpost_Context *ctx)
-{
-    Xpost_Object s0;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
+    sig->promote = 0;
+    for (j = 0; j < sig->in; j++)
     {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            xpost_stack_topdown_replace(ctx->lo, ctx->os, 0, s0 = _promote_integer_to_real(s0));
-            /* fallthrough */
-        case realtype:
-            return 0;
-        default:
-            return typecheck;
+        switch (sig->t[j])
+        {
+            case anytype:
+                sig->mask[j] = (1u << XPOST_OPERATOR_NCODES) - 1;
+                break;
+            case floattype:
+                sig->promote |= 1u << j;
+                /* fallthrough */
+            case numbertype:
+                sig->mask[j] = (1u << integertype) | (1u << realtype);
+                break;
+            case proctype:
+                sig->mask[j] = 1u << XPOST_OPERATOR_TYPE_PROC;
+                break;
+            case arraytype:
+                sig->mask[j] = (1u << arraytype) | (1u << XPOST_OPERATOR_TYPE_PROC);
+                break;
+            default:
+                sig->mask[j] = 1u << sig->t[j];
+                break;
+        }
     }
 }
 
+/* may sig match operands whose top two type codes are c0 and c1,
+   either of which may be XPOST_OPERATOR_NCODES for an absent operand */
 static
-int _stack_any(Xpost_Context *ctx)
+int _xpost_operator_may_match(const Xpost_Signature *sig,
+                              unsigned c0,
+                              unsigned c1)
 {
-    if (xpost_stack_count(ctx->lo, ctx->os) >= 1)
+    if (sig->in >= 1 &&
+        (c0 == XPOST_OPERATOR_NCODES || !(sig->mask[0] >> c0 & 1)))
         return 0;
-    return stackunderflow;
-}
-
-static
-int _stack_bool_bool(Xpost_Context *ctx)
-{
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case booleantype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
-            {
-                case invalidtype:
-                    return stackunderflow;
-                case booleantype:
-                    return 0;
-                default:
-                    return typecheck;
-            }
-        default:
-            return typecheck;
-    }
-}
-
-static
-int _stack_int_int(Xpost_Context *ctx)
-{
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
-            {
-                case invalidtype:
-                    return stackunderflow;
-                case integertype:
-                    return 0;
-                default:
-                    return typecheck;
-            }
-        default:
-            return typecheck;
-    }
-}
-
-static
-int _stack_float_float(Xpost_Context *ctx)
-{
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            xpost_stack_topdown_replace(ctx->lo, ctx->os, 0, s0 = _promote_integer_to_real(s0));
-            /* fallthrough */
-        case realtype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
-            {
-                case invalidtype:
-                    return stackunderflow;
-                case integertype:
-                    xpost_stack_topdown_replace(ctx->lo, ctx->os, 1, s1 = _promote_integer_to_real(s1));
-                    /* fallthrough */
-                case realtype:
-                    return 0;
-                default:
-                    return typecheck;
-            }
-        default:
-            return typecheck;
-    }
+    if (sig->in >= 2 &&
+        (c1 == XPOST_OPERATOR_NCODES || !(sig->mask[1] >> c1 & 1)))
+        return 0;
+    return 1;
 }
 
+/* (re)build the dispatch table of an operator with several signatures.
+   without one, xpost_operator_exec tries every signature from the first. */
 static
-int _stack_number_number(Xpost_Context *ctx)
+void _xpost_operator_build_dispatch(Xpost_Operator *op)
 {
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case integertype: /* fallthrough */
-        case realtype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
-            {
-                case invalidtype:
-                    return stackunderflow;
-                case integertype: /* fallthrough */
-                case realtype:
-                    return 0;
-                default:
-                    return typecheck;
-            }
-        default:
-            return typecheck;
-    }
-}
+    unsigned c0, c1;
+    int i;
 
-static
-int _stack_any_any(Xpost_Context *ctx)
-{
-    if (xpost_stack_count(ctx->lo, ctx->os) >= 2)
-        return 0;
-    return stackunderflow;
+    free(op->dispatch);
+    op->dispatch = NULL;
+    if (op->n < 2 || op->n > 255)
+        return;
+    op->dispatch = malloc((XPOST_OPERATOR_NCODES + 1) * (XPOST_OPERATOR_NCODES + 1));
+    if (!op->dispatch)
+        return;
+    for (c0 = 0; c0 <= XPOST_OPERATOR_NCODES; c0++)
+        for (c1 = 0; c1 <= XPOST_OPERATOR_NCODES; c1++)
+        {
+            for (i = 0; i < op->n; i++)
+                if (_xpost_operator_may_match(&op->sig[i], c0, c1))
+                    break;
+            op->dispatch[c0 * (XPOST_OPERATOR_NCODES + 1) + c1] = (byte)i;
+        }
 }
 
-typedef struct {
-    int (*checkstack)(Xpost_Context *ctx);
-    int n;
-    int t[8];
-} Xpost_Check_Stack;
-
-static
-Xpost_Check_Stack _check_stack_funcs[] = {
-    { _stack_none, 0, { 0, 0, 0, 0, 0, 0, 0, 0} },
-    { _stack_int, 1, { integertype } },
-    { _stack_real, 1, { realtype } },
-    { _stack_float, 1, { floattype } },
-    { _stack_any, 1, { anytype } },
-    { _stack_bool_bool, 2, { booleantype, booleantype } },
-    { _stack_int_int, 2, { integertype, integertype } },
-    { _stack_float_float, 2, { floattype, floattype } },
-    { _stack_number_number, 2, { numbertype, numbertype } },
-    { _stack_any_any, 2, { anytype, anytype } }
-};
-
-
-/* allocate the OPTAB structure in VM */
+/* allocate the OPTAB structure, the first time,
+   and reserve its slot in the global memory table,
+   which keeps the special entries after it in place. */
 int xpost_operator_init_optab(Xpost_Context *ctx)
 {
     unsigned ent;
     Xpost_Memory_Table *tab;
     int ret;
 
-    ret = xpost_memory_table_alloc(ctx->gl, MAXOPS * sizeof(Xpost_Operator), 0, &ent);
+    if (!_xpost_optab)
+    {
+        _xpost_optab = calloc(XPOST_OPERATOR_TABLE_INITIAL_SIZE, sizeof *_xpost_optab);
+        if (!_xpost_optab)
+            return 0;
+        _xpost_maxops = XPOST_OPERATOR_TABLE_INITIAL_SIZE;
+    }
+
+    ret = xpost_memory_table_alloc(ctx->gl, 0, 0, &ent);
     if (!ret)
     {
         return 0;
     }
     tab = &ctx->gl->table;
     assert(ent == XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE);
-    tab->tab[ent].sz = 0; // so gc will ignore it
+    xpost_memory_table_entry(tab, ent)->sz = 0; // so gc will ignore it
     //printf("ent: %d\nOPTAB: %d\n", ent, (int)XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE);
 
     return 1;
 }
 
+/* free the OPTAB structure and the signatures */
+void xpost_operator_quit(void)
+{
+    int i;
+
+    for (i = 0; i < _xpost_noops; i++)
+    {
+        free(_xpost_optab[i].sig);
+        free(_xpost_optab[i].dispatch);
+    }
+    free(_xpost_optab);
+    _xpost_optab = NULL;
+    _xpost_noops = 0;
+    _xpost_maxops = 0;
+}
+
 /* print a dump of the operator struct given opcode */
 void xpost_operator_dump(Xpost_Context *ctx,
                          int opcode)
 {
-    Xpost_Operator *optab;
     Xpost_Operator op;
-    Xpost_Object o;
     Xpost_Object str;
     char *s;
-    Xpost_Signature *sig;
-    unsigned int adr;
     uintptr_t fp;
 
-    xpost_memory_table_get_addr(ctx->gl,
-                                XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &adr);
-    optab = (void *)(ctx->gl->base + adr);
-    op = optab[opcode];
-    o.mark_.tag = nametype | XPOST_OBJECT_TAG_DATA_FLAG_BANK;
-    o.mark_.pad0 = 0;
-    o.mark_.padw = op.name;
-    str = xpost_name_get_string(ctx, o);
+    op = _xpost_optab[opcode];
+    str = xpost_name_get_string(ctx, xpost_operator_get_name(opcode));
     s = xpost_string_get_pointer(ctx, str);
-    sig = (void *)(ctx->gl->base + op.sigadr);
-    memcpy(&fp, &sig[0].fp, sizeof fp);
+    memcpy(&fp, &op.sig[0].fp, sizeof fp);
     /*
     printf("<operator %d %d:%*s %p>",
            opcode,
@@ -359,6 +242,16 @@ Xpost_Object xpost_operator_cons_opcode(int opcode)
     return op;
 }
 
+/* the name of an operator, which is always in global vm */
+Xpost_Object xpost_operator_get_name(unsigned opcode)
+{
+    Xpost_Object n;
+    n.mark_.tag = nametype | XPOST_OBJECT_TAG_DATA_FLAG_BANK;
+    n.mark_.pad0 = 0;
+    n.mark_.padw = _xpost_optab[opcode].name;
+    return n;
+}
+
 /* construct an operator object by name
    If function-pointer fp is not NULL, attempts to install a new operator
    in OPTAB, otherwise just perform a lookup.
@@ -378,33 +271,20 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
     int opcode;
     int i;
     unsigned si;
-    unsigned t;
     unsigned vmmode;
     Xpost_Signature *sp;
-    Xpost_Operator *optab;
-    Xpost_Operator  op;
-    unsigned int optadr;
-    int ret;
+    Xpost_Signature sig;
 
     //fprintf(stderr, "name: %s\n", name);
     assert(ctx->gl->base);
+    assert(_xpost_optab);
 
-    ret = xpost_memory_table_get_addr(ctx->gl,
-                                      XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    if (!ret)
-    {
-        XPOST_LOG_ERR("cannot load optab!");
-        return null;
-    }
-    optab = (void *)(ctx->gl->base + optadr);
-
-    if (!(in < XPOST_STACK_SEGMENT_SIZE))
+    if (!(in <= XPOST_OPERATOR_MAX_ARGS))
     {
-        printf("!(in < XPOST_STACK_SEGMENT_SIZE) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
-        fprintf(stderr, "!(in < XPOST_STACK_SEGMENT_SIZE) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
+        printf("!(in <= XPOST_OPERATOR_MAX_ARGS) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
+        fprintf(stderr, "!(in <= XPOST_OPERATOR_MAX_ARGS) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
         exit(EXIT_FAILURE);
     }
-    //assert(in < XPOST_STACK_SEGMENT_SIZE); // or else xpost_operator_exec can't call it using HOLD
 
     vmmode=ctx->vmmode;
     ctx->vmmode = GLOBAL;
@@ -413,108 +293,88 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
         return invalid;
     ctx->vmmode = vmmode;
 
-    optab = (void *)(ctx->gl->base + optadr);
-    for (opcode = 0; optab[opcode].name != nm.mark_.padw; opcode++)
+    for (opcode = 0; opcode < _xpost_noops; opcode++)
     {
-        if (opcode == _xpost_noops) break;
+        if (_xpost_optab[opcode].name == nm.mark_.padw)
+            break;
     }
 
     /* install a new signature (prototype) */
     if (fp)
     {
+        {
+            va_list args;
+            memset(&sig, 0, sizeof sig);
+            va_start(args, in);
+            for (i = in-1; i >= 0; i--) {
+                sig.t[i] = va_arg(args, int);
+            }
+            va_end(args);
+            sig.in = in;
+            sig.out = out;
+            sig.fp = fp;
+            _xpost_operator_compile(&sig);
+        }
+
         if (opcode == _xpost_noops)
         { /* a new operator */
-            unsigned adr;
-            if (_xpost_noops == MAXOPS-1)
+            if (_xpost_noops == _xpost_maxops)
             {
-                XPOST_LOG_ERR("optab too small in xpost_operator.h");
-                XPOST_LOG_ERR("operator %s NOT installed", name);
-                return null;
+                Xpost_Operator *tmp;
+                tmp = realloc(_xpost_optab, 2 * _xpost_maxops * sizeof *_xpost_optab);
+                if (!tmp)
+                {
+                    XPOST_LOG_ERR("cannot grow optab");
+                    XPOST_LOG_ERR("operator %s NOT installed", name);
+                    return null;
+                }
+                _xpost_optab = tmp;
+                _xpost_maxops *= 2;
             }
-            if (!xpost_memory_file_alloc(ctx->gl, sizeof(Xpost_Signature), &adr))
+            sp = malloc(sizeof *sp);
+            if (!sp)
             {
                 XPOST_LOG_ERR("cannot allocate signature block");
                 XPOST_LOG_ERR("operator %s NOT installed", name);
                 return null;
             }
-            optab = (void *)(ctx->gl->base + optadr); // recalc
-            op.name = nm.mark_.padw;
-            op.n = 1;
-            op.sigadr = adr;
-            optab[opcode] = op;
+            _xpost_optab[opcode].sig = sp;
+            _xpost_optab[opcode].dispatch = NULL;
+            _xpost_optab[opcode].name = nm.mark_.padw;
+            _xpost_optab[opcode].n = 1;
+            _xpost_optab[opcode].maxin = 0;
             ++_xpost_noops;
             si = 0;
         }
         else
-        { /* increase sig table by 1 */
-            t = xpost_free_realloc(ctx->gl,
-                                   optab[opcode].sigadr,
-                                   optab[opcode].n * sizeof(Xpost_Signature),
-                                   (optab[opcode].n + 1) * sizeof(Xpost_Signature));
-            if (!t)
+        {
+            /* installed already, by an earlier context */
+            for (si = 0; si < (unsigned)_xpost_optab[opcode].n; si++)
             {
-                XPOST_LOG_ERR("cannot allocate new sig table");
-                XPOST_LOG_ERR("operator %s NOT installed", name);
-                return null;
+                sp = &_xpost_optab[opcode].sig[si];
+                if (sp->fp == sig.fp && sp->in == sig.in && sp->out == sig.out &&
+                    memcmp(sp->t, sig.t, sizeof sig.t) == 0)
+                    goto done;
             }
-            optab = (void *)(ctx->gl->base + optadr); // recalc
-            optab[opcode].sigadr = t;
 
-            si = optab[opcode].n++; /* index of last sig */
-        }
-
-        sp = (void *)(ctx->gl->base + optab[opcode].sigadr);
-        {
-            unsigned int ad;
-            if (!xpost_memory_file_alloc(ctx->gl, in, &ad))
+            /* increase sig table by 1 */
+            sp = realloc(_xpost_optab[opcode].sig,
+                         (_xpost_optab[opcode].n + 1) * sizeof *sp);
+            if (!sp)
             {
-                XPOST_LOG_ERR("cannot allocate type block");
+                XPOST_LOG_ERR("cannot allocate new sig table");
                 XPOST_LOG_ERR("operator %s NOT installed", name);
                 return null;
             }
-            optab = (void *)(ctx->gl->base + optadr); // recalc
-            sp = (void *)(ctx->gl->base + optab[opcode].sigadr); // recalc
-            sp[si].t = ad;
-        }
-        {
-            va_list args;
-            byte *b = (void *)(ctx->gl->base + sp[si].t);
-            va_start(args, in);
-            for (i = in-1; i >= 0; i--) {
-                b[i] = va_arg(args, int);
-            }
-            va_end(args);
-            sp[si].in = in;
-            sp[si].out = out;
-            sp[si].fp = (int(*)(Xpost_Context *))fp;
-            sp[si].checkstack = NULL;
-            {
-                int j;
-                int k;
-                int pass;
-                for (j = 0; j < (int)(sizeof _check_stack_funcs/sizeof*_check_stack_funcs); j++)
-                {
-                    if (_check_stack_funcs[j].n == sp[si].in)
-                    {
-                        pass = 1;
-                        for (k=0; k < _check_stack_funcs[j].n; k++)
-                        {
-                            if (b[k] != _check_stack_funcs[j].t[k])
-                            {
-                                pass = 0;
-                                break;
-                            }
-                        }
-                        if (pass)
-                        {
-                            sp[si].checkstack = _check_stack_funcs[j].checkstack;
-                            break;
-                        }
-                    }
-                }
-            }
-            //sp[si].checkstack = NULL;
+            _xpost_optab[opcode].sig = sp;
+
+            si = _xpost_optab[opcode].n++; /* index of last sig */
         }
+
+        _xpost_optab[opcode].sig[si] = sig;
+        if (_xpost_optab[opcode].maxin < in)
+            _xpost_optab[opcode].maxin = in;
+        _xpost_operator_build_dispatch(&_xpost_optab[opcode]);
     }
     else if (opcode == _xpost_noops)
     {
@@ -522,14 +382,58 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
         return null;
     }
 
+  done:
     o.tag = operatortype;
     o.mark_.padw = opcode;
     return o;
 }
 
-/* clear hold and pop n objects from opstack to hold stack.
-   The hold stack is used as temporary storage to hold the
-   arguments for an operator-function call.
+/* the number of installed operators, recorded in a vm image */
+int xpost_operator_count(void)
+{
+    return _xpost_noops;
+}
+
+/* FNV-1a over the names, signature counts, argument counts and type
+   patterns of the installed operators. A vm image holds operator
+   objects by opcode and their names by index, so it can only be loaded
+   where the same operators have been installed in the same order. */
+unsigned int xpost_operator_digest(void)
+{
+    unsigned int h = 2166136261u;
+    int opcode;
+    int i;
+    int k;
+
+#define XPOST_OPERATOR_DIGEST(x) (h = (h ^ (unsigned int)(x)) * 16777619u)
+    XPOST_OPERATOR_DIGEST(_xpost_noops);
+    for (opcode = 0; opcode < _xpost_noops; opcode++)
+    {
+        XPOST_OPERATOR_DIGEST(_xpost_optab[opcode].name);
+        XPOST_OPERATOR_DIGEST(_xpost_optab[opcode].n);
+        for (i = 0; i < _xpost_optab[opcode].n; i++)
+        {
+            Xpost_Signature *sp = &_xpost_optab[opcode].sig[i];
+            XPOST_OPERATOR_DIGEST(sp->in);
+            XPOST_OPERATOR_DIGEST(sp->out);
+            for (k = 0; k < sp->in; k++)
+                XPOST_OPERATOR_DIGEST(sp->t[k]);
+        }
+    }
+#undef XPOST_OPERATOR_DIGEST
+    return h;
+}
+
+/* set hold to the top n objects of the opstack and drop them
+   from the opstack, returning a pointer to the first of them
+   where they still lie in the opstack array.
+   The operator-function is called directly with the objects
+   at this pointer, so the arguments are never pushed or popped
+   one at a time.
+   The hold stack keeps a block copy of the arguments, because
+   they are no longer on the opstack and the operator-function may
+   allocate, which may collect garbage; and because its own pushes
+   may overwrite them in the opstack array.
    If the operator-function does not itself call xpost_operator_exec,
    the arguments may be restored by xpost_interpreter.c:_on_error().
    xpost_operator_exec checks its argument with ctx->currentobject
@@ -545,24 +449,26 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
    operator error.
 */
 static
-void _xpost_operator_push_args_to_hold(Xpost_Context *ctx,
-                                       Xpost_Memory_File *mem,
-                                       unsigned stacadr,
-                                       int n)
+Xpost_Object *_xpost_operator_push_args_to_hold(Xpost_Context *ctx,
+                                                Xpost_Memory_File *mem,
+                                                unsigned stacadr,
+                                                int n)
 {
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stacadr);
+    Xpost_Stack *h = (Xpost_Stack *)(ctx->lo->base + ctx->hold);
+    Xpost_Object *args;
     int j;
 
-    assert(n < XPOST_MEMORY_TABLE_SIZE);
-    xpost_stack_clear(ctx->lo, ctx->hold);
-    for (j = n; j--;)
-    {  /* copy */
-        xpost_stack_push(ctx->lo, ctx->hold,
-                         xpost_stack_topdown_fetch(mem, stacadr, j));
-    }
-    for (j = n; j--;)
-    {  /* pop */
-        (void)xpost_stack_pop(mem, stacadr);
-    }
+    assert(n < XPOST_STACK_INITIAL_SIZE); /* hold never grows */
+    assert((unsigned int)n <= s->top);
+    s->top -= n;
+    args = XPOST_STACK_DATA(mem, s) + s->top;
+    memcpy(XPOST_STACK_DATA(ctx->lo, h), args, n * sizeof(Xpost_Object));
+    h->top = n;
+    if (ctx->lo->marking) /* hold may have been scanned already */
+        for (j = 0; j < n; j++)
+            xpost_garbage_shade(ctx->lo, args[j]);
+    return args;
 }
 
 /* execute an operator function by opcode
@@ -571,96 +477,73 @@ void _xpost_operator_push_args_to_hold(Xpost_Context *ctx,
 int xpost_operator_exec(Xpost_Context *ctx,
                         unsigned opcode)
 {
-    Xpost_Operator *optab;
-    Xpost_Operator op;
-    Xpost_Signature *sp;
+    const Xpost_Operator *op;
+    const Xpost_Signature *sp;
     int i,j;
-    int pass;
-    int err = unregistered;
-    Xpost_Stack *hold;
+    Xpost_Stack *os;
+    Xpost_Object *top; /* one past the top of the opstack */
+    unsigned code[XPOST_OPERATOR_MAX_ARGS];
+    int k;
+    Xpost_Object *args;
     int ct;
-    unsigned int optadr;
     int ret;
 
-    ret = xpost_memory_table_get_addr(ctx->gl,
-                                      XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    if (!ret)
+    if (opcode >= (unsigned)_xpost_noops)
     {
-        XPOST_LOG_ERR("cannot load optab!");
-        return VMerror;
+        XPOST_LOG_ERR("opcode does not index a valid operator");
+        return unregistered;
     }
-    optab = (void *)(ctx->gl->base + optadr);
-    op = optab[opcode];
-    sp = (void *)(ctx->gl->base + op.sigadr);
+    op = &_xpost_optab[opcode];
+    sp = op->sig;
 
-    ct = xpost_stack_count(ctx->lo, ctx->os);
-    if (op.n == 0)
+    if (op->n == 0)
     {
         XPOST_LOG_ERR("operator has no signatures");
         return unregistered;
     }
-    for (i =0 ; i < op.n; i++)
-    { /* try each signature */
-        byte *t;
 
-        /* call signature's stack-checking proc, if available */
-        if (sp[i].checkstack)
-        {
-            if ((ret = sp[i].checkstack(ctx)))
-            {
-                err = ret;
-                continue;
-            }
-            goto call;
-        }
-
-        /* check stack size */
+    /* type codes of the operands any signature looks at */
+    os = (Xpost_Stack *)(ctx->lo->base + ctx->os);
+    ct = os->top;
+    top = XPOST_STACK_DATA(ctx->lo, os) + ct;
+    k = op->maxin < ct ? op->maxin : ct;
+    for (j = 0; j < k; j++)
+        code[j] = _xpost_operator_type_code(top[-1 - j]);
+
+    /* skip the signatures the top two operands rule out */
+    i = 0;
+    if (op->dispatch)
+        i = op->dispatch[(k > 0 ? code[0] : XPOST_OPERATOR_NCODES) * (XPOST_OPERATOR_NCODES + 1)
+                         + (k > 1 ? code[1] : XPOST_OPERATOR_NCODES)];
+    for ( ; i < op->n; i++)
+    { /* try each signature */
         if (ct < sp[i].in)
-        {
-            pass = 0;
-            err = stackunderflow;
             continue;
-        }
-
-        /* check type-pattern against stack */
-        pass = 1;
-        t = (void *)(ctx->gl->base + sp[i].t);
-        for (j=0; j < sp[i].in; j++)
-        {
-            Xpost_Object el = xpost_stack_topdown_fetch(ctx->lo, ctx->os, j);
-            if (t[j] == anytype)
-                continue;
-            if (t[j] == xpost_object_get_type(el))
-                continue;
-            if ((t[j] == numbertype) &&
-                (((xpost_object_get_type(el) == integertype) ||
-                  (xpost_object_get_type(el) == realtype))))
-                continue;
-            if (t[j] == floattype)
-            {
-                if (xpost_object_get_type(el) == integertype)
-                {
-                    if (!xpost_stack_topdown_replace(ctx->lo, ctx->os, j, el = _promote_integer_to_real(el)))
-                        return unregistered;
-                    continue;
-                }
-                if (xpost_object_get_type(el) == realtype)
-                    continue;
-            }
-            if ((t[j] == proctype) &&
-                (xpost_object_get_type(el) == arraytype) &&
-                xpost_object_is_exe(el))
-                continue;
-            pass = 0;
-            err = typecheck;
-            break;
-        }
-
-        if (pass) goto call;
+        for (j = 0; j < sp[i].in; j++)
+            if (!(sp[i].mask[j] >> code[j] & 1))
+                break;
+        if (j == sp[i].in)
+            goto call;
     }
-    return err;
+    /* the error is that of the last signature, checked from the top down */
+    sp += op->n - 1;
+    for (j = 0; j < sp->in; j++)
+    {
+        if (j >= ct)
+            return stackunderflow;
+        if (!(sp->mask[j] >> _xpost_operator_type_code(top[-1 - j]) & 1))
+            return typecheck;
+    }
+    return typecheck;
 
   call:
+    if (sp[i].promote)
+    {
+        for (j = 0; j < sp[i].in; j++)
+            if ((sp[i].promote >> j & 1) && code[j] == integertype)
+                top[-1 - j] = _promote_integer_to_real(top[-1 - j]);
+    }
+
     /* If we're executing the context's "currentobject",
        set the number of arguments consumed in the pad0 of currentobject,
        and set a flag declaring that this has been done.
@@ -682,8 +565,7 @@ int xpost_operator_exec(Xpost_Context *ctx,
         ctx->currentobject.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_OPARGSINHOLD;
     }
 
-    _xpost_operator_push_args_to_hold(ctx, ctx->lo, ctx->os, sp[i].in);
-    hold = (void *)(ctx->lo->base + ctx->hold);
+    args = _xpost_operator_push_args_to_hold(ctx, ctx->lo, ctx->os, sp[i].in);
 
     switch(sp[i].in)
     {
@@ -691,29 +573,29 @@ int xpost_operator_exec(Xpost_Context *ctx,
             ret = ((int(*)(Xpost_Context*))sp[i].fp)(ctx); break;
         case 1:
             ret = ((int(*)(Xpost_Context*,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0]); break;
+                (ctx, args[0]); break;
         case 2:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1]); break;
+                (ctx, args[0], args[1]); break;
         case 3:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2]); break;
+                (ctx, args[0], args[1], args[2]); break;
         case 4:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3]); break;
+                (ctx, args[0], args[1], args[2], args[3]); break;
         case 5:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4]); break;
         case 6:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4], hold->data[5]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4], args[5]); break;
         case 7:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4], hold->data[5], hold->data[6]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4], args[5], args[6]); break;
         case 8:
             ret =
                 ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4], hold->data[5], hold->data[6], hold->data[7]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7]); break;
         default:
             ret = unregistered;
     }
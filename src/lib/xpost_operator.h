@@ -41,6 +41,15 @@
  * xpost_operator_init_optab is called to initialize the optab structure itself.
  * xpost_oplib.c:initop is called to populate the optab structure.
  *
+ * The optab and the signatures live in C memory, not in vm.
+ * They are global to the process, built as the operators are
+ * installed by the first context and only read after that;
+ * later contexts installing the same operators find them already
+ * there. So xpost_operator_exec reaches an operator's signatures
+ * and type patterns without going through the memory table, and
+ * vm holds no function-pointers, which lets a vm image
+ * (xpost_image.c) be loaded as it was written.
+ *
  * nb. Since xpost_operator_cons does a linear search through the optab,
  * an obvious optimisation would be to factor-out calls to
  * xpost_operator_cons from main-line code. Pre-initialize an object
@@ -48,16 +57,16 @@
  * a global struct of "opcuts" (operator object shortcuts),
  * but here it would need to be "global", either in global-vm
  * or in the context struct.
- * One goal of the planned "quick-launch" option is to remove
- * these lookups from the initialization, too. One requirement
- * for the quick-launch is removing all function-pointers from vm.
  *
  * ----
- * To speed-up typechecks,
- * a `int (*check)()` function pointer is added to the signature
- * which directly implements the stack-checking performed by
- * xpost_operator_exec (but without the nasty loops).
- * xpost_operator_exec would then call op.sig[i].check() if not null.
+ * To speed-up typechecks, xpost_operator_cons compiles the type
+ * pattern of each signature into a bitmask of the type codes
+ * accepted at each argument position. xpost_operator_exec reads the
+ * type codes of the top few operands once and tests them against
+ * the masks. An operator with several signatures also gets a table,
+ * indexed by the type codes of the top two operands, of the first
+ * signature which may match them, so eg. `add` or `get` goes
+ * straight to the right one.
  *
  * @{
  */
@@ -67,33 +76,60 @@
  */
 typedef int (*Xpost_Op_Func)();
 
+/**
+ * @brief the most arguments an operator function may take
+ *
+ * xpost_operator_exec calls the function with this many objects at most.
+ */
+#define XPOST_OPERATOR_MAX_ARGS 8
+
+/**
+ * @brief type code of an executable array, after the object types
+ *
+ * The type codes matched by a signature are the object types and this,
+ * so that proctype is a single bit.
+ */
+#define XPOST_OPERATOR_TYPE_PROC XPOST_OBJECT_NTYPES
+
+/**
+ * @brief number of type codes, and the code of an absent operand
+ */
+#define XPOST_OPERATOR_NCODES (XPOST_OPERATOR_TYPE_PROC + 1)
+
 /**
  * @brief operator signature structure
  *
- * A signature contains a stack-pattern, an optional stack-checking
- * function, and an operator function.
+ * A signature contains a stack-pattern, compiled into masks,
+ * and an operator function.
+ * It is 64 bytes on 64-bit hosts, one cache line.
  */
 typedef struct Xpost_Signature
 {
     Xpost_Op_Func fp;  /* function-pointer which implements the operator action */
     int in;       /* number of argument objects */
-    unsigned t;   /* memory address of array of ints representing argument types */
-    int (*checkstack)(Xpost_Context *ctx);  /* stack-checking function to bypass generic type-check loop */
     int out;      /* number of output objects */
+    unsigned promote; /* bit j set: promote an integer at position j to real */
+    byte t[XPOST_OPERATOR_MAX_ARGS]; /* argument types, t[0] for the top of the stack */
+    unsigned mask[XPOST_OPERATOR_MAX_ARGS]; /* bit c of mask[j] set: type code c matches t[j] */
 } Xpost_Signature;
 
 /**
  * @brief operator structure
  *
  * An operator structure, which inhabits the operator table,
- * contains a "pointer" to an array of signatures
- * and the length of that array.
+ * points to an array of signatures and holds the length of that array.
+ * An operator with several signatures also has a dispatch table of
+ * XPOST_OPERATOR_NCODES + 1 squared entries, indexed by the type codes of
+ * the top and second operands, giving the first signature which may
+ * match, or n if none may.
  */
 typedef struct Xpost_Operator
 {
+    Xpost_Signature *sig; /* array of signatures */
+    byte *dispatch;  /* first candidate signature by top two type codes, or NULL */
     unsigned name;   /* name-stack index of operator's name */
     int n;           /* number of signatures */
-    unsigned sigadr; /* memory address of array of signatures */
+    int maxin;       /* greatest number of arguments of any signature */
 } Xpost_Operator;
 
 
@@ -114,9 +150,9 @@ enum typepat
     proctype };
 
 /**
- * @brief constant size of optab structure
+ * @brief initial size of the optab structure (which then grows, automatically)
  */
-#define MAXOPS 250
+#define XPOST_OPERATOR_TABLE_INITIAL_SIZE 256
 
 /**
  * @brief initial size of systemdict (which then grows, automatically)
@@ -124,10 +160,16 @@ enum typepat
 #define SDSIZE 10
 
 /**
- * @brief allocate the optab structure
+ * @brief allocate the optab structure, if not yet allocated,
+ *        and reserve its old slot in the global memory table
  */
 int xpost_operator_init_optab(Xpost_Context *ctx);
 
+/**
+ * @brief free the optab structure
+ */
+void xpost_operator_quit(void);
+
 /**
  * @brief output a text dump of the operator contents
  */
@@ -149,6 +191,22 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
                                  int in,
                                  ...);
 
+/**
+ * @brief return the name of an operator, as a global name object
+ */
+Xpost_Object xpost_operator_get_name(unsigned opcode);
+
+/**
+ * @brief return the number of installed operators
+ */
+int xpost_operator_count(void);
+
+/**
+ * @brief return a hash of the names, signatures and type patterns
+ *        of the installed operators, recorded in a vm image
+ */
+unsigned int xpost_operator_digest(void);
+
 /**
  * @brief execute an operator
  */
@@ -159,21 +217,12 @@ int xpost_operator_exec(Xpost_Context *ctx,
  * @brief helper macro for installing an operator
  *
  * The INSTALL macro
- * 1. refreshes the optab pointer
- * 2. extracts the name index from the operator referred to by object op
- * 3. constructs a name object n
- * 4. defines the name/operator-object pair in systemdict
- * 5. refreshes the optab pointer yet again
+ * 1. constructs a name object n from the operator referred to by object op
+ * 2. defines the name/operator-object pair in systemdict
  */
 #define INSTALL \
-    xpost_memory_table_get_addr(ctx->gl, \
-            XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr), \
-    optab = (void *)(ctx->gl->base + optadr), \
-    n.mark_.tag = nametype|XPOST_OBJECT_TAG_DATA_FLAG_BANK, \
-    n.mark_.pad0 = 0, \
-    n.mark_.padw = optab[op.mark_.padw].name, \
-    xpost_dict_put(ctx, sd, n, op), \
-    optab = (void *)(ctx->gl->base + optadr); // recalc
+    n = xpost_operator_get_name(op.mark_.padw), \
+    xpost_dict_put(ctx, sd, n, op);
 
 /**
  * @}
@@ -104,8 +104,6 @@ int xpost_oplib_init_ops(Xpost_Context *ctx)
     Xpost_Object sd;
     Xpost_Memory_Table *tab;
     unsigned ent;
-    Xpost_Operator *optab;
-    unsigned int optadr;
 
     sd = xpost_dict_cons (ctx, SDSIZE);
     if (xpost_object_get_type(sd) == nulltype)
@@ -113,14 +111,12 @@ int xpost_oplib_init_ops(Xpost_Context *ctx)
         XPOST_LOG_ERR("cannot allocate systemdict");
         return 0;
     }
-    xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "systemdict"), sd);
     xpost_stack_push(ctx->lo, ctx->ds, sd); // push systemdict on dictstack
+    xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "systemdict"), sd);
     ent = xpost_object_get_ent(sd);
     tab = &ctx->gl->table;
-    tab->tab[ent].sz = 0; // make systemdict immune to collection
+    xpost_memory_table_entry(tab, ent)->sz = 0; // make systemdict immune to collection
 
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
 #ifdef DEBUGOP
     xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
     puts("");
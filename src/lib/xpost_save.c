@@ -33,6 +33,7 @@
 #endif
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "xpost.h"
@@ -40,7 +41,11 @@
 #include "xpost_memory.h"  /* save/restore works with mtabs */
 #include "xpost_object.h"  /* save/restore examines objects */
 #include "xpost_stack.h"  /* save/restore manipulates (internal) stacks */
+#include "xpost_free.h"  /* restore frees the copies */
 #include "xpost_error.h"
+#include "xpost_garbage.h"  /* copies are seen by incremental marking */
+#include "xpost_context.h"
+#include "xpost_dict.h"  /* restored dicts invalidate name lookups */
 
 #include "xpost_save.h"  /* double-check prototypes */
 
@@ -59,8 +64,164 @@ typedef struct {
 } saverec_;
 */
 
+/* the pages saved at the current save level are kept in an
+   open-addressed hash set of ent and page pairs.
+   ent 0 is the free list and never saved, so it marks an empty slot.
+   the set only saves copying a page twice: a second copy would be
+   restored before the first, and undone by it. */
+static
+unsigned int _xpost_save_page_hash(unsigned int ent,
+                                   unsigned int page)
+{
+    return (ent * 2654435761u) ^ (page * 40503u);
+}
+
+/* is page of ent in the set */
+static
+int _xpost_save_page_find(Xpost_Memory_File *mem,
+                          unsigned int ent,
+                          unsigned int page)
+{
+    unsigned int mask = mem->saved_pages_max - 1;
+    unsigned int i;
+
+    if (!mem->saved_pages_max)
+        return 0;
+    for (i = _xpost_save_page_hash(ent, page) & mask;
+         mem->saved_pages[2 * i];
+         i = (i + 1) & mask)
+    {
+        if (mem->saved_pages[2 * i] == ent && mem->saved_pages[2 * i + 1] == page)
+            return 1;
+    }
+    return 0;
+}
+
+/* put page of ent in the set, which is kept at most half full */
+static
+int _xpost_save_page_add(Xpost_Memory_File *mem,
+                         unsigned int ent,
+                         unsigned int page)
+{
+    unsigned int mask;
+    unsigned int i;
+
+    if ((mem->nsaved_pages + 1) * 2 > mem->saved_pages_max)
+    {
+        unsigned int max = mem->saved_pages_max ? mem->saved_pages_max * 2 : 256;
+        unsigned int *old = mem->saved_pages;
+        unsigned int oldmax = mem->saved_pages_max;
+        unsigned int j;
+
+        mem->saved_pages = calloc(max * 2, sizeof *mem->saved_pages);
+        if (!mem->saved_pages)
+        {
+            XPOST_LOG_ERR("cannot grow saved page set to %u entries", max);
+            mem->saved_pages = old;
+            return 0;
+        }
+        mem->saved_pages_max = max;
+        mem->nsaved_pages = 0;
+        for (j = 0; j < oldmax; j++)
+            if (old[2 * j])
+                (void) _xpost_save_page_add(mem, old[2 * j], old[2 * j + 1]);
+        free(old);
+    }
+    mask = mem->saved_pages_max - 1;
+    for (i = _xpost_save_page_hash(ent, page) & mask;
+         mem->saved_pages[2 * i];
+         i = (i + 1) & mask)
+        ;
+    mem->saved_pages[2 * i] = ent;
+    mem->saved_pages[2 * i + 1] = page;
+    ++mem->nsaved_pages;
+    return 1;
+}
+
+/* empty the set */
+static
+void _xpost_save_page_clear(Xpost_Memory_File *mem)
+{
+    if (mem->nsaved_pages)
+        memset(mem->saved_pages, 0,
+               mem->saved_pages_max * 2 * sizeof *mem->saved_pages);
+    mem->nsaved_pages = 0;
+}
+
+/* fill the set from the saverecs of the current save level,
+   after the level above it is restored */
+static
+void _xpost_save_page_reload(Xpost_Memory_File *mem,
+                             unsigned int vs)
+{
+    Xpost_Object sav;
+    Xpost_Object rec;
+    unsigned int cnt;
+    unsigned int i;
+
+    _xpost_save_page_clear(mem);
+    if (xpost_stack_count(mem, vs) == 0)
+        return;
+    sav = xpost_stack_topdown_fetch(mem, vs, 0);
+    cnt = xpost_stack_count(mem, sav.save_.stk);
+    for (i = 0; i < cnt; i++)
+    {
+        rec = xpost_stack_bottomup_fetch(mem, sav.save_.stk, i);
+        if (rec.saverec_.tag & XPOST_SAVE_REC_PAGE)
+            (void) _xpost_save_page_add(mem, rec.saverec_.src, rec.saverec_.pad);
+    }
+}
+
+/* number of names in the name stack of mem, 0 if it has none yet */
+static
+unsigned int _xpost_save_name_count(Xpost_Memory_File *mem)
+{
+    unsigned int adr;
+
+    if (mem->table.nextent <= XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK ||
+        !xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &adr) ||
+        !adr)
+        return 0;
+    return xpost_stack_count(mem, adr);
+}
+
+/* record the extent of mem as the mark of save level lev.
+   the marks are indexed by level, so a level whose outer level
+   could not be recorded goes without. */
+static
+void _xpost_save_mark(Xpost_Memory_File *mem,
+                      unsigned int lev)
+{
+    Xpost_Memory_Save_Mark *m;
+
+    if (mem->nsave_marks > lev)
+        mem->nsave_marks = lev;
+    if (mem->nsave_marks < lev)
+        return;
+    if (lev >= mem->save_marks_max)
+    {
+        unsigned int max = mem->save_marks_max ? mem->save_marks_max * 2 : 16;
+        void *tmp = realloc(mem->save_marks, max * sizeof *mem->save_marks);
+        if (!tmp)
+        {
+            XPOST_LOG_ERR("cannot grow save marks to %u entries", max);
+            return;
+        }
+        mem->save_marks = tmp;
+        mem->save_marks_max = max;
+    }
+    m = &mem->save_marks[lev];
+    m->used = mem->used;
+    m->nextent = mem->table.nextent;
+    m->names = _xpost_save_name_count(mem);
+    m->spoiled = 0;
+    mem->nsave_marks = lev + 1;
+}
+
 /* create a stack in slot XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK.
-   sz is 0 so gc will ignore it. */
+   sz is 0 so gc will ignore it.
+   large arrays are saved a page at a time unless `setvmsavepages`
+   says otherwise. */
 int xpost_save_init(Xpost_Memory_File *mem)
 {
     unsigned t;
@@ -77,7 +238,8 @@ int xpost_save_init(Xpost_Memory_File *mem)
 
     xpost_stack_init(mem, &t);
     tab = &mem->table;
-    tab->tab[ent].adr = t;
+    xpost_memory_table_entry(tab, ent)->adr = t;
+    mem->save_pages = 1;
 
     return 1;
 }
@@ -99,8 +261,10 @@ Xpost_Object xpost_save_create_snapshot_object(Xpost_Memory_File *mem)
         return null;
     }
     v.save_.lev = xpost_stack_count(mem, vs);
+    _xpost_save_mark(mem, v.save_.lev); /* before the saverec stack, which goes with the level */
     xpost_stack_init(mem, &v.save_.stk);
     xpost_stack_push(mem, vs, v);
+    _xpost_save_page_clear(mem); /* nothing is saved at the new level */
     return v;
 }
 
@@ -113,11 +277,12 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem,
                                  unsigned ent)
 {
     Xpost_Memory_Table *tab;
+    unsigned int mk;
     unsigned int llev;
     unsigned int tlev;
+    unsigned int lev;
     unsigned int vs;
     int ret;
-    Xpost_Object sav;
 
     ret = xpost_memory_table_get_addr(mem,
                                       XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
@@ -127,23 +292,26 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem,
         return 0;
     }
 
-    if (xpost_stack_count(mem, vs) == 0)
+    lev = xpost_stack_count(mem, vs);
+    if (lev == 0)
         return 1;
 
-    sav = xpost_stack_topdown_fetch(mem, vs, 0);
     tab = &mem->table;
     if (ent >= tab->nextent)
     {
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    tlev = (tab->tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
+    mk = xpost_memory_table_entry(tab, ent)->mark;
+    tlev = (mk & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
         >> XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET;
-    llev = (tab->tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
+    llev = (mk & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
         >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET;
 
-    return llev < sav.save_.lev ?
-        tlev == sav.save_.lev : 1;
+    /* new allocations are stamped with the save-stack count,
+       so the top save object's lev is one less than the current level */
+    return llev < lev ?
+        tlev == lev : 1;
 }
 
 /* make a clone of ent, return new ent */
@@ -151,18 +319,17 @@ static
 unsigned int _copy_ent(Xpost_Memory_File *mem,
                        unsigned ent)
 {
-    Xpost_Memory_Table *tab;
+    Xpost_Memory_Table_Entry *src;
+    Xpost_Memory_Table_Entry *dst;
     unsigned new;
-    unsigned int adr;
-    int ret;
 
-    tab = &mem->table;
-    if (ent >= tab->nextent)
+    if (ent >= mem->table.nextent)
     {
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    if (!xpost_memory_table_alloc(mem, tab->tab[ent].sz, tab->tab[ent].tag, &new))
+    src = xpost_memory_table_entry(&mem->table, ent);
+    if (!xpost_memory_table_alloc(mem, src->sz, src->tag, &new))
     {
         XPOST_LOG_ERR("cannot allocate entity to backup object");
         return 0;
@@ -173,16 +340,10 @@ unsigned int _copy_ent(Xpost_Memory_File *mem,
                       new, XPOST_OBJECT_COMP_MAX_ENT);
         return 0;
     }
-    tab = &mem->table; //recalc
-    ret = xpost_memory_table_get_addr(mem, new, &adr);
-    if (!ret)
-    {
-        XPOST_LOG_ERR("cannot find table for ent %u", ent);
-        return 0;
-    }
-    memcpy(mem->base + adr,
-           mem->base + tab->tab[ent].adr,
-           tab->tab[ent].sz);
+    dst = xpost_memory_table_entry(&mem->table, new);
+    memcpy(mem->base + dst->adr,
+           mem->base + src->adr,
+           src->sz);
 
     XPOST_LOG_INFO("ent %u copied to ent %u in %s", ent, new, mem->fname);
     return new;
@@ -196,6 +357,7 @@ int xpost_save_save_ent(Xpost_Memory_File *mem,
                         unsigned ent)
 {
     Xpost_Memory_Table *tab;
+    Xpost_Memory_Table_Entry *te;
     Xpost_Object o;
     unsigned tlev;
     Xpost_Object sav;
@@ -218,9 +380,10 @@ int xpost_save_save_ent(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    tlev = sav.save_.lev;
-    tab->tab[ent].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK; // clear TLEV field
-    tab->tab[ent].mark |= (tlev << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);  // set TLEV field
+    tlev = sav.save_.lev + 1; /* the save-stack count */
+    te = xpost_memory_table_entry(tab, ent);
+    te->mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK; // clear TLEV field
+    te->mark |= (tlev << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);  // set TLEV field
 
     o.saverec_.tag = tag;
     o.saverec_.pad = pad;
@@ -233,15 +396,96 @@ int xpost_save_save_ent(Xpost_Memory_File *mem,
     }
 
     o.saverec_.cpy = cpy;
+    if (mem->marking)
+        xpost_garbage_rescan(mem, cpy, tag);
+    xpost_stack_push(mem, sav.save_.stk, o);
+    return 1;
+}
+
+/* copy the page of array ent containing byte off
+   and push a page saverec, unless it is already saved at this level.
+   arrays of a page or less, and dicts, are saved whole. */
+int xpost_save_save_page(Xpost_Memory_File *mem,
+                         unsigned tag,
+                         unsigned pad,
+                         unsigned ent,
+                         unsigned off)
+{
+    Xpost_Memory_Table_Entry *te;
+    Xpost_Object o;
+    Xpost_Object sav;
+    unsigned int adr;
+    unsigned int page;
+    unsigned int len;
+    unsigned int cpy;
+    int ret;
+
+    if (ent >= mem->table.nextent)
+    {
+        XPOST_LOG_ERR("cannot find table for ent %u", ent);
+        return 0;
+    }
+    te = xpost_memory_table_entry(&mem->table, ent);
+    if (!mem->save_pages || tag != arraytype || te->used <= XPOST_SAVE_PAGE_SIZE)
+        return xpost_save_save_ent(mem, tag, pad, ent);
+
+    page = off / XPOST_SAVE_PAGE_SIZE;
+    if (page * XPOST_SAVE_PAGE_SIZE >= te->used)
+        return 1; /* outside the array, the put will fail */
+    if (_xpost_save_page_find(mem, ent, page))
+        return 1;
+    len = te->used - page * XPOST_SAVE_PAGE_SIZE;
+    if (len > XPOST_SAVE_PAGE_SIZE)
+        len = XPOST_SAVE_PAGE_SIZE;
+
+    ret = xpost_memory_table_get_addr(mem,
+            XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &adr);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot load save stack");
+        return 0;
+    }
+    sav = xpost_stack_topdown_fetch(mem, adr, 0);
+
+    if (!xpost_memory_table_alloc(mem, len, arraytype, &cpy))
+    {
+        XPOST_LOG_ERR("cannot allocate entity to backup page");
+        return 0;
+    }
+    if (cpy > XPOST_OBJECT_COMP_MAX_ENT)
+    {
+        XPOST_LOG_ERR("ent number %u exceeds object storage max %u",
+                      cpy, XPOST_OBJECT_COMP_MAX_ENT);
+        return 0;
+    }
+    te = xpost_memory_table_entry(&mem->table, ent);
+    memcpy(mem->base + xpost_memory_table_entry(&mem->table, cpy)->adr,
+           mem->base + te->adr + page * XPOST_SAVE_PAGE_SIZE,
+           len);
+
+    o.saverec_.tag = tag | XPOST_SAVE_REC_PAGE;
+    o.saverec_.pad = page;
+    o.saverec_.src = ent;
+    o.saverec_.cpy = cpy;
+    if (mem->marking)
+        xpost_garbage_rescan(mem, cpy, arraytype);
     xpost_stack_push(mem, sav.save_.stk, o);
+    (void) _xpost_save_page_add(mem, ent, page);
     return 1;
 }
 
 /* for each saverec from current save stack
-        exchange adrs between src and cpy
+        exchange adrs between src and cpy,
+        or copy a saved page back into src
+        free cpy
         pop saverec
-    pop save stack */
-void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
+    pop save stack, free its stack of saverecs.
+   if the memory file is about to be cut back to cut, src instead keeps
+   its storage and the copy is copied back into it, and what lies past
+   the cut is left to go with it. */
+static
+void _xpost_save_restore(Xpost_Memory_File *mem,
+                         const Xpost_Memory_Save_Mark *cut)
 {
     unsigned int v;
     Xpost_Object sav;
@@ -259,11 +503,18 @@ void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
     sav = xpost_stack_pop(mem, v); // save-object (stack of saverec_'s)
     if (xpost_object_get_type(sav) == invalidtype)
         return;
+    ++xpost_dict_epoch; /* dicts get back their old keys */
+    if (mem->name_bindings)
+        xpost_dict_unbind_names(mem); /* and systemdict may be one */
+    if (mem->nsave_marks > sav.save_.lev)
+        mem->nsave_marks = sav.save_.lev;
     cnt = xpost_stack_count(mem, sav.save_.stk);
     XPOST_LOG_INFO("restoring %u save records", cnt);
     while (cnt--)
     {
         Xpost_Object rec;
+        Xpost_Memory_Table_Entry *src;
+        Xpost_Memory_Table_Entry *cpy;
         unsigned hold;
 
         rec = xpost_stack_pop(mem, sav.save_.stk);
@@ -282,11 +533,128 @@ void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
             XPOST_LOG_ERR("cannot find table for ent %u", cent);
             return;
         }
-        hold = tab->tab[sent].adr;                 // tmp = src
-        tab->tab[sent].adr = tab->tab[cent].adr;  // src = cpy
-        tab->tab[cent].adr = hold;                 // cpy = tmp
+        xpost_memory_discard_code(mem, sent, sent + 1); /* the array gets back its old contents */
+        src = xpost_memory_table_entry(tab, sent);
+        cpy = xpost_memory_table_entry(tab, cent);
+        if (rec.saverec_.tag & XPOST_SAVE_REC_PAGE)
+        {
+            memcpy(mem->base + src->adr + rec.saverec_.pad * XPOST_SAVE_PAGE_SIZE,
+                   mem->base + cpy->adr,
+                   cpy->used);
+            if (mem->marking)
+                xpost_garbage_rescan(mem, sent, arraytype);
+            if (mem->nursery_limit)
+                xpost_garbage_remember_ent(mem, sent);
+            if (!cut || cent < cut->nextent)
+                (void) xpost_free_memory_ent(mem, cent);
+            continue;
+        }
+        if (cut)
+        {
+            memcpy(mem->base + src->adr,
+                   mem->base + cpy->adr,
+                   src->sz < cpy->sz ? src->sz : cpy->sz);
+        }
+        else
+        {
+            hold = src->adr;                 // tmp = src
+            src->adr = cpy->adr;             // src = cpy
+            cpy->adr = hold;                 // cpy = tmp
+            hold = src->sz;                  // dicgrow may have
+            src->sz = cpy->sz;               // changed the size
+            cpy->sz = hold;
+            xpost_memory_save_marks_spoil(mem, sent, src->adr);
+        }
+        /* the tlev of this level is reused by the next save */
+        src->mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK;
+        if (mem->marking)
+            xpost_garbage_rescan(mem, sent, rec.saverec_.tag);
+        if (mem->nursery_limit)
+            xpost_garbage_remember_ent(mem, sent);
+        /* the copy now holds the discarded contents */
+        if (!cut || cent < cut->nextent)
+            (void) xpost_free_memory_ent(mem, cent);
+    }
+    if (!cut)
+        xpost_stack_free(mem, sav.save_.stk);
+    _xpost_save_page_reload(mem, v);
+}
+
+void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
+{
+    _xpost_save_restore(mem, NULL);
+}
+
+/* restore every save level above lev and cut the memory file and its
+   table back to their extent when level lev began, instead of freeing
+   what was allocated since. this is possible if all of that is arrays,
+   dicts and strings with storage of their own past the cut, or in the
+   nursery, and nothing refers to it any more, and nothing older has
+   been given storage past the cut.
+   the check looks at the ents past the cut and the stacks, not the
+   whole table. */
+int xpost_save_rollback(Xpost_Memory_File *mem,
+                        unsigned int lev)
+{
+    Xpost_Memory_Save_Mark m;
+    Xpost_Memory_Table_Entry *te;
+    unsigned int vs;
+    unsigned int ent;
+    unsigned int cut;
+    unsigned int i, n;
+
+    if (lev >= mem->nsave_marks || mem->marking)
+        return 0;
+    m = mem->save_marks[lev];
+    if (m.spoiled || m.nextent > mem->table.nextent || m.used > mem->used ||
+        mem->nursery_limit > m.used ||
+        _xpost_save_name_count(mem) != m.names)
+        return 0;
+    if (!xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs) ||
+        !xpost_stack_is_below(mem, vs, m.used))
+        return 0;
+    for (ent = m.nextent; ent < mem->table.nextent; ent++)
+    {
+        te = xpost_memory_table_entry(&mem->table, ent);
+        if ((te->mark & XPOST_MEMORY_TABLE_MARK_DATA_FREE_MASK) ||
+            (te->tag != arraytype && te->tag != dicttype && te->tag != stringtype))
+            return 0;
+        if (te->sz && te->adr < m.used && !XPOST_MEMORY_IS_YOUNG(mem, te->adr))
+            return 0;
+    }
+    if (xpost_garbage_newer_in_use(mem, lev + 1, m.nextent, m.used))
+        return 0;
+
+    while ((unsigned int)xpost_stack_count(mem, vs) > lev)
+        _xpost_save_restore(mem, &m);
+
+    xpost_memory_discard_code(mem, m.nextent, mem->table.nextent);
+    for (ent = m.nextent; ent < mem->table.nextent; ent++)
+        memset(xpost_memory_table_entry(&mem->table, ent), 0, sizeof *te);
+    for (i = n = 0; i < mem->nyoung; i++)
+        if (mem->young[i] < m.nextent)
+            mem->young[n++] = mem->young[i];
+    mem->nyoung = n;
+    for (i = n = 0; i < mem->nremembered; i++)
+        if (mem->remembered[i] < m.nextent)
+            mem->remembered[n++] = mem->remembered[i];
+    mem->nremembered = n;
+    if (mem->sweep_limit > m.nextent)
+    {
+        mem->sweep_limit = m.nextent;
+        if (mem->sweep > m.nextent)
+            mem->sweep = m.nextent;
     }
-    //xpost_stack_free(mem, sav.save_.stk);
+
+    /* mem->allocated is left alone, so collections are as frequent as before,
+       but the collector is told the cut was garbage */
+    cut = mem->used - m.used;
+    mem->gc.cut += cut;
+    XPOST_LOG_INFO("restore cut %s back by %u bytes and %u ents",
+                   mem->fname, cut, mem->table.nextent - m.nextent);
+    mem->table.nextent = m.nextent;
+    mem->used = m.used;
+    return 1;
 }
 
 #ifdef TESTMODULE_V
@@ -60,7 +60,22 @@
  *     -- saverec
  *     -- saverec = { src=foo_ent, cpy=bar_ent }
  *
+ *  An array larger than a page may instead be saved a page at a time,
+ *  copy-on-write: the first put into each page after a save copies just
+ *  that page, and its saverec has the XPOST_SAVE_REC_PAGE flag in its tag
+ *  and the page number in pad. Restore copies the page back.
+ *
+ */
+
+/**
+ * Size of the pages of an array saved by xpost_save_save_page()
  */
+#define XPOST_SAVE_PAGE_SIZE 4096
+
+/**
+ * Flag in the tag of a saverec whose copy holds a single page of its source
+ */
+#define XPOST_SAVE_REC_PAGE 0x8000
 
 /*
  * @brief initialize the save stack for memory file.
@@ -83,9 +98,30 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem, unsigned ent);
  */
 int xpost_save_save_ent(Xpost_Memory_File *mem, unsigned tag, unsigned pad, unsigned ent);
 
+/*
+ * @brief add the page of ent containing byte off to current snapshot
+ *
+ * Only the page is copied if mem->save_pages is set and the ent is an
+ * array larger than a page, otherwise this is xpost_save_save_ent().
+ */
+int xpost_save_save_page(Xpost_Memory_File *mem, unsigned tag, unsigned pad, unsigned ent, unsigned off);
+
 /*
  * @brief rewind the stack 1 level, reverting memory to previous snapshot.
  */
 void xpost_save_restore_snapshot(Xpost_Memory_File *mem);
 
+/*
+ * @brief restore every level above lev at once by cutting the memory
+ *        file back to its extent when level lev began.
+ *
+ * Each save records mem->used and the table's nextent in
+ * mem->save_marks. If nothing allocated since is still in use, the
+ * levels are restored and everything past the marks is discarded
+ * without going through the free list. Otherwise nothing is done.
+ *
+ * returns 1 if the levels were restored, 0 if not.
+ */
+int xpost_save_rollback(Xpost_Memory_File *mem, unsigned int lev);
+
 #endif
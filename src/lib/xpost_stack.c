@@ -32,7 +32,9 @@
 # include <config.h>
 #endif
 
+#include <limits.h> /* UINT_MAX */
 #include <stdlib.h> /* NULL */
+#include <string.h> /* memcpy */
 
 #include "xpost.h"
 #include "xpost_log.h"
@@ -40,35 +42,59 @@
 #include "xpost_memory.h"
 #include "xpost_error.h"
 #include "xpost_stack.h"
+#include "xpost_free.h"
+#include "xpost_garbage.h" /* pushes are seen by incremental marking */
 
 /*
- * The stack type is a chain of segments.
+ * The stack type is a header and a contiguous array of objects.
  *
- * root->prevseg == top segment
- * tail->nextseg == 0
+ * data[0] is the bottom, data[top - 1] is the top.
+ * A full array is replaced by one twice its size.
  *
 
 typedef struct
 {
-    unsigned int nextseg;
-    unsigned int prevseg;
+    unsigned int data;
     unsigned int top;
-    Xpost_Object data[XPOST_STACK_SEGMENT_SIZE];
+    unsigned int max;
 } Xpost_Stack;
 */
 
-/* allocate memory for one stack segment */
+/* give a block of raw memory an entry and put it on the free list,
+   without allocating, so it may be called from restore. */
+static
+int _xpost_stack_free_block(Xpost_Memory_File *mem,
+                            unsigned int adr,
+                            unsigned int sz)
+{
+    unsigned int e;
+
+    if (!xpost_memory_table_alloc_ent(mem, adr, sz, 0, &e))
+    {
+        XPOST_LOG_ERR("cannot free stack block at %u", adr);
+        return 0;
+    }
+    (void) xpost_free_memory_ent(mem, e);
+    return 1;
+}
+
+/* allocate the header and the object array.
+   the array is raw memory, so compaction does not move it. */
 XPCHECKAPI int xpost_stack_init(Xpost_Memory_File *mem,
                                 unsigned int *paddr)
 {
     unsigned int adr;
+    unsigned int data;
     Xpost_Stack *s;
 
-    xpost_memory_file_alloc(mem, sizeof(Xpost_Stack), &adr);
+    if (!xpost_memory_file_alloc(mem, sizeof(Xpost_Stack), &adr))
+        return 0;
+    if (!xpost_memory_file_alloc(mem, XPOST_STACK_INITIAL_SIZE * sizeof(Xpost_Object), &data))
+        return 0;
     s = (Xpost_Stack *)(mem->base + adr);
-    s->nextseg = 0;
-    s->prevseg = adr;
+    s->data = data;
     s->top = 0;
+    s->max = XPOST_STACK_INITIAL_SIZE;
     *paddr = adr;
     return 1;
 }
@@ -78,101 +104,208 @@ void xpost_stack_clear(Xpost_Memory_File *mem,
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
     s->top = 0;
-    s->prevseg = stackadr;
 }
 
 void xpost_stack_dump(Xpost_Memory_File *mem,
                       unsigned int stackadr)
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    Xpost_Object *data = XPOST_STACK_DATA(mem, s);
     unsigned int i;
-    unsigned int a;
 
-    a = 0;
-    while (1)
+    for (i = 0; i < s->top; i++)
     {
-        for (i = 0; i < s->top; i++)
-        {
-            XPOST_LOG_DUMP("%d:", a++);
-            xpost_object_dump(s->data[i]);
-        }
-        if (i != XPOST_STACK_SEGMENT_SIZE)
-            break;
-        if (s->nextseg == 0)
-            break;
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
+        XPOST_LOG_DUMP("%d:", i);
+        xpost_object_dump(data[i]);
     }
 }
 
-/* deallocate stack segment and any chained segments */
+/* deallocate the object array and the header. */
 XPCHECKAPI void xpost_stack_free(Xpost_Memory_File *mem,
                                  unsigned int stackadr)
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Memory_Table *tab;
-    unsigned int e;
 
-    if (s->nextseg)
-        xpost_stack_free(mem, s->nextseg);
-    xpost_memory_table_alloc(mem, 0, 0, &e); /* allocate entry with 0 size */
-    tab = &mem->table;
-    tab->tab[e].adr = stackadr; /* insert address */
-    tab->tab[e].sz = sizeof(Xpost_Stack); /* insert size */
-    /* discard */
+    if (!_xpost_stack_free_block(mem, s->data, s->max * sizeof(Xpost_Object)))
+        return;
+    (void) _xpost_stack_free_block(mem, stackadr, sizeof(Xpost_Stack));
+}
+
+/* check that neither the header nor the array was allocated
+   at or after adr */
+int xpost_stack_is_below(Xpost_Memory_File *mem,
+                         unsigned int stackadr,
+                         unsigned int adr)
+{
+    return stackadr < adr &&
+        ((Xpost_Stack *)(mem->base + stackadr))->data < adr;
 }
 
 int xpost_stack_count(Xpost_Memory_File *mem,
                       unsigned int stackadr)
+{
+    return ((Xpost_Stack *)(mem->base + stackadr))->top;
+}
+
+/* replace the object array with one doubled until it holds
+   n more objects than are in use.
+   the allocation may move mem->base. */
+static
+int _xpost_stack_grow(Xpost_Memory_File *mem,
+                      unsigned int stackadr,
+                      unsigned int n)
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
-    unsigned int ct = 0;
-    while (s->top == XPOST_STACK_SEGMENT_SIZE)
+    unsigned int old = s->data;
+    unsigned int oldmax = s->max;
+    unsigned int max = oldmax;
+    unsigned int adr;
+
+    if (n > UINT_MAX / sizeof(Xpost_Object) - s->top)
+        return 0;
+    while (max - s->top < n)
     {
-        ct += XPOST_STACK_SEGMENT_SIZE;
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
+        if (max > UINT_MAX / 2 / sizeof(Xpost_Object))
+            return 0;
+        max *= 2;
     }
-    return ct + s->top;
+    if (!xpost_memory_file_alloc(mem, max * sizeof(Xpost_Object), &adr))
+        return 0;
+    s = (Xpost_Stack *)(mem->base + stackadr);
+    memcpy(mem->base + adr, mem->base + old, s->top * sizeof(Xpost_Object));
+    s->data = adr;
+    s->max = max;
+    return _xpost_stack_free_block(mem, old, oldmax * sizeof(Xpost_Object));
 }
 
 XPCHECKAPI int xpost_stack_push(Xpost_Memory_File *mem,
                                 unsigned int stackadr,
                                 Xpost_Object obj)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = (Xpost_Stack *)(mem->base + root->prevseg); /* load top segment */
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
     if (xpost_object_get_type(obj) == invalidtype)
         return 0;
+    if (mem->marking)
+        xpost_garbage_shade(mem, obj);
+
+    if (s->top == s->max)
+    {
+        if (!_xpost_stack_grow(mem, stackadr, 1))
+            return 0;
+        s = (Xpost_Stack *)(mem->base + stackadr);
+    }
+    XPOST_STACK_DATA(mem, s)[s->top++] = obj; /* push value */
+
+    return 1;
+}
+
+/* objs must not point into mem, which may move if the array grows. */
+XPCHECKAPI int xpost_stack_push_n(Xpost_Memory_File *mem,
+                                  unsigned int stackadr,
+                                  const Xpost_Object *objs,
+                                  unsigned int n)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        if (xpost_object_get_type(objs[i]) == invalidtype)
+            return 0;
+        if (mem->marking)
+            xpost_garbage_shade(mem, objs[i]);
+    }
+
+    if (s->max - s->top < n)
+    {
+        if (!_xpost_stack_grow(mem, stackadr, n))
+            return 0;
+        s = (Xpost_Stack *)(mem->base + stackadr);
+    }
+    memcpy(XPOST_STACK_DATA(mem, s) + s->top, objs, n * sizeof(Xpost_Object));
+    s->top += n;
+
+    return 1;
+}
+
+XPCHECKAPI int xpost_stack_pop_n(Xpost_Memory_File *mem,
+                                 unsigned int stackadr,
+                                 Xpost_Object *objs,
+                                 unsigned int n)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+
+    if (n > s->top)
+        return 0;
+    s->top -= n;
+    if (objs)
+        memcpy(objs, XPOST_STACK_DATA(mem, s) + s->top, n * sizeof(Xpost_Object));
+    return 1;
+}
+
+/* duplicate the top n objects.
+   no shading is needed: they are already on this stack. */
+int xpost_stack_copy(Xpost_Memory_File *mem,
+                     unsigned int stackadr,
+                     unsigned int n)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+
+    if (n > s->top)
+        return 0;
+    if (s->max - s->top < n)
+    {
+        if (!_xpost_stack_grow(mem, stackadr, n))
+            return 0;
+        s = (Xpost_Stack *)(mem->base + stackadr);
+    }
+    memcpy(XPOST_STACK_DATA(mem, s) + s->top,
+           XPOST_STACK_DATA(mem, s) + s->top - n,
+           n * sizeof(Xpost_Object));
+    s->top += n;
+    return 1;
+}
 
-    s->data[s->top++] = obj; /* push value */
+static
+void _xpost_stack_reverse(Xpost_Object *a,
+                          unsigned int n)
+{
+    Xpost_Object t;
+    unsigned int i;
 
-    /* if push filled the topmost segment, link a new one. */
-    if (s->top == XPOST_STACK_SEGMENT_SIZE)
+    for (i = 0; i < n / 2; i++)
     {
-        if (s->nextseg == 0)
-        {
-            size_t stadr;
-            unsigned int newst;
-            int ret;
-
-            stadr = (unsigned char *)s - mem->base;
-            ret = xpost_stack_init(mem, &newst);
-            if (!ret)
-                return 0;
-            s = (Xpost_Stack *)(mem->base + stadr);
-            root = (Xpost_Stack *)(mem->base + stackadr);
-            s->nextseg = newst;
-            root->prevseg = newst; //root->prev==top
-            ((Xpost_Stack *)(mem->base + newst))->prevseg = stadr;
-        }
-        else
-        {
-            root->prevseg = s->nextseg;
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            s->top = 0;
-        }
+        t = a[i];
+        a[i] = a[n - 1 - i];
+        a[n - 1 - i] = t;
     }
+}
+
+/* rotate the top n objects by j in place, by three reversals.
+   the top j objects end up beneath the other n - j. */
+int xpost_stack_roll(Xpost_Memory_File *mem,
+                     unsigned int stackadr,
+                     unsigned int n,
+                     int j)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    Xpost_Object *a;
 
+    if (n > s->top)
+        return 0;
+    if (n == 0)
+        return 1;
+    if (j < 0)
+        j = n - ((unsigned int)-(j + 1) % n) - 1;
+    j = (unsigned int)j % n;
+    if (j == 0)
+        return 1;
+
+    a = XPOST_STACK_DATA(mem, s) + s->top - n;
+    _xpost_stack_reverse(a, n);
+    _xpost_stack_reverse(a, j);
+    _xpost_stack_reverse(a + j, n - j);
     return 1;
 }
 
@@ -180,29 +313,15 @@ Xpost_Object xpost_stack_topdown_fetch(Xpost_Memory_File *mem,
                                        unsigned int stackadr,
                                        int idx)
 {
-#if 0
-    int i = idx;
-    int cnt = xpost_stack_count(mem, stackadr);
-    if (idx >= cnt) return invalid;
-    return xpost_stack_bottomup_fetch(mem, stackadr, cnt - 1 - i);
-#else
-    int i = idx;
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    if (s->prevseg) s = (Xpost_Stack *)(mem->base + s->prevseg); /* find top seg */
-
-    while (i >= (signed)(s->top)){
-        i -= s->top;
-        if (s == (Xpost_Stack *)(mem->base + stackadr)){
-            XPOST_LOG_ERR("%d can't find stack segment for index -%d in stack of size %u",
-                    unregistered, idx,
-                    xpost_stack_count(mem, stackadr));
-            return invalid;
-        }
-        s = (Xpost_Stack *)(mem->base + s->prevseg);
+    if (idx < 0 || (unsigned int)idx >= s->top)
+    {
+        XPOST_LOG_ERR("%d can't find index -%d in stack of size %u",
+                      unregistered, idx, s->top);
+        return invalid;
     }
-    return s->data[s->top - 1 - i];
-#endif
+    return XPOST_STACK_DATA(mem, s)[s->top - 1 - idx];
 }
 
 int xpost_stack_topdown_replace(Xpost_Memory_File *mem,
@@ -210,56 +329,29 @@ int xpost_stack_topdown_replace(Xpost_Memory_File *mem,
                                 int idx,
                                 Xpost_Object obj)
 {
-#if 0
-    int i = idx;
-    int cnt = xpost_stack_count(mem, stackadr);
-    if (idx >= cnt) return 0;
-    return xpost_stack_bottomup_replace(mem, stackadr, cnt - 1 - i, obj);
-#else
-    int i = idx;
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
-    if (s->prevseg) s = (Xpost_Stack *)(mem->base + s->prevseg); /* find top seg */
-
-    while (i >= (signed)(s->top)){
-        i -= s->top;
-        if (s == (Xpost_Stack *)(mem->base + stackadr)){
-            XPOST_LOG_ERR("%d can't find stack segment for index -%d in stack of size %u",
-                    unregistered, idx,
-                    xpost_stack_count(mem, stackadr));
-            return 0;
-        }
-        s = (Xpost_Stack *)(mem->base + s->prevseg);
+
+    if (idx < 0 || (unsigned int)idx >= s->top)
+    {
+        XPOST_LOG_ERR("%d can't find index -%d in stack of size %u",
+                      unregistered, idx, s->top);
+        return 0;
     }
-    s->data[s->top - 1 - i] = obj;
+    if (mem->marking)
+        xpost_garbage_shade(mem, obj);
+    XPOST_STACK_DATA(mem, s)[s->top - 1 - idx] = obj;
     return 1;
-#endif
 }
 
 Xpost_Object xpost_stack_bottomup_fetch(Xpost_Memory_File *mem,
                                         unsigned int stackadr,
                                         int idx)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = root;
-    int i = idx;
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    /* find desired segment */
-    while (i >= XPOST_STACK_SEGMENT_SIZE)
-    {
-        i -= XPOST_STACK_SEGMENT_SIZE;
-        if (s->nextseg == 0)
-        {
-            XPOST_LOG_ERR("%d can't find stack segment for index %d in stack of size %u",
-                    unregistered, idx,
-                    xpost_stack_count(mem, stackadr));
-            return invalid;
-        }
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
-    }
-    if (i >= (signed)s->top){
+    if (idx < 0 || (unsigned int)idx >= s->top)
         return invalid;
-    }
-    return s->data[i];
+    return XPOST_STACK_DATA(mem, s)[idx];
 }
 
 int xpost_stack_bottomup_replace(Xpost_Memory_File *mem,
@@ -267,49 +359,22 @@ int xpost_stack_bottomup_replace(Xpost_Memory_File *mem,
                                  int idx,
                                  Xpost_Object obj)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = root;
-    int i = idx;
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    /* find desired segment */
-    while (i >= XPOST_STACK_SEGMENT_SIZE)
-    {
-        i -= XPOST_STACK_SEGMENT_SIZE;
-        if (s->nextseg == 0)
-        {
-            XPOST_LOG_ERR("%d can't find stack segment for index %d in stack of size %u",
-                          unregistered, idx,
-                          xpost_stack_count(mem, stackadr));
-            return 0;
-        }
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
-    }
-    if (i >= (signed)s->top){
+    if (idx < 0 || (unsigned int)idx >= s->top)
         return 0;
-    }
-    s->data[i] = obj;
+    if (mem->marking)
+        xpost_garbage_shade(mem, obj);
+    XPOST_STACK_DATA(mem, s)[idx] = obj;
     return 1;
 }
 
 XPCHECKAPI Xpost_Object xpost_stack_pop(Xpost_Memory_File *mem,
                                         unsigned int stackadr)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = (Xpost_Stack *)(mem->base + root->prevseg); /* load top seg */
-
-    if (s->top == 0) /* back up if top is empty */
-    {
-        if (s != root)
-        {
-            unsigned int soff = s->prevseg;
-            s = (Xpost_Stack *)(mem->base + soff);
-            root->prevseg = soff; // update root->top
-        }
-        else /* can't back up if stack is empty */
-        {
-            return invalid;
-        }
-    }
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    return s->data[--s->top]; /* pop value */
+    if (s->top == 0) /* can't pop if stack is empty */
+        return invalid;
+    return XPOST_STACK_DATA(mem, s)[--s->top]; /* pop value */
 }
@@ -43,37 +43,43 @@
  * @file xpost_stack.h
  * @brief stack functions
  *
- * Stacks are built from a chain of tables, a hybrid
- * array/linked-list data structure.
+ * A stack is a small header holding the vm address of a contiguous
+ * array of objects, the number of objects in use and the capacity.
+ * The array doubles when a push fills it, so push, pop and indexing
+ * are plain index arithmetic on the array.
  * @{
  */
 
 /**
- * @brief Number of objects in one segment of the stack.
+ * @brief Number of objects in a newly created stack.
  *
  * This parameter may be tuned for performance.
- * Most stack operations are performed on the top few entries,
- * which are at the tail of a linked list of stack segments.
- *
- * For performance, this parameter should be set to be slightly
- * larger than expected maximum size (or the average, if the
- * maximum is very large; however, there is currently no provision
- * for shrinking the size of a stack and returning memory).
+ * Every save object carries a stack of save records, so it
+ * should not be very large; the operand, execution and dictionary
+ * stacks grow past it by doubling.
  *
  * For testing, this parameter should be set very small,
  * but it must be large enough to hold all parameters in a
  * type-checked postscript operator. cf. xpost_operator.c:holdn()
  */
-#define XPOST_STACK_SEGMENT_SIZE 1000
+#define XPOST_STACK_INITIAL_SIZE 250
 
 typedef struct
 {
-    unsigned int nextseg;
-    unsigned int prevseg;
-    unsigned int top;
-    Xpost_Object data[XPOST_STACK_SEGMENT_SIZE];
+    unsigned int data; /* vm address of the object array */
+    unsigned int top;  /* number of objects in use */
+    unsigned int max;  /* capacity of the object array */
 } Xpost_Stack;
 
+/**
+ * @def XPOST_STACK_DATA
+ * @brief The object array of the stack header @p s in @p mem.
+ *
+ * The pointer is invalidated by anything which may grow @p mem.
+ */
+#define XPOST_STACK_DATA(mem, s) \
+    ((Xpost_Object *)((mem)->base + (s)->data))
+
 /**
  * @brief Create a stack data structure, returns vm address in addr.
  */
@@ -90,10 +96,17 @@ void xpost_stack_clear(Xpost_Memory_File *mem, unsigned int stackadr);
 void xpost_stack_dump(Xpost_Memory_File *mem, unsigned int stackadr);
 
 /**
- * @brief Free a stack, and all succeeding segments.
+ * @brief Free a stack and its object array.
  */
 XPCHECKAPI void xpost_stack_free(Xpost_Memory_File *mem, unsigned int stackadr);
 
+/**
+ * @brief Return 1 if the stack and its object array lie below vm address adr.
+ */
+int xpost_stack_is_below(Xpost_Memory_File *mem,
+                         unsigned int stackadr,
+                         unsigned int adr);
+
 /**
  * @brief Count elements in stack.
  */
@@ -106,6 +119,40 @@ XPCHECKAPI int xpost_stack_push(Xpost_Memory_File *mem,
                                 unsigned int stackadr,
                                 Xpost_Object obj);
 
+/**
+ * @brief Put n objects on top of the stack, objs[n - 1] on top.
+ *
+ * @p objs must not point into @p mem.
+ */
+XPCHECKAPI int xpost_stack_push_n(Xpost_Memory_File *mem,
+                                  unsigned int stackadr,
+                                  const Xpost_Object *objs,
+                                  unsigned int n);
+
+/**
+ * @brief Remove the top n objects, storing them in objs (if not NULL)
+ * with the former top in objs[n - 1].
+ */
+XPCHECKAPI int xpost_stack_pop_n(Xpost_Memory_File *mem,
+                                 unsigned int stackadr,
+                                 Xpost_Object *objs,
+                                 unsigned int n);
+
+/**
+ * @brief Duplicate the top n objects.
+ */
+int xpost_stack_copy(Xpost_Memory_File *mem,
+                     unsigned int stackadr,
+                     unsigned int n);
+
+/**
+ * @brief Roll the top n objects j times, as the postscript roll operator.
+ */
+int xpost_stack_roll(Xpost_Memory_File *mem,
+                     unsigned int stackadr,
+                     unsigned int n,
+                     int j);
+
 /**
  * @brief Index the stack from the top down, fetching object.
  */
@@ -116,7 +116,7 @@ char *xpost_string_get_pointer(Xpost_Context *ctx,
     unsigned int ent = xpost_object_get_ent(S);
     mem = xpost_context_select_memory(ctx, S) /*S.tag&FBANK?ctx->gl:ctx->lo*/;
     tab = &mem->table;
-    return (void *)(mem->base + tab->tab[ent].adr + S.comp_.off);
+    return (void *)(mem->base + xpost_memory_table_entry(tab, ent)->adr + S.comp_.off);
 }
 
 
@@ -4,8 +4,10 @@ check_PROGRAMS = src/tests/xpost_suite
 src_tests_xpost_suite_SOURCES = \
 src/tests/xpost_suite.c \
 src/tests/xpost_suite.h \
+src/tests/xpost_test_dict.c \
 src/tests/xpost_test_main.c \
 src/tests/xpost_test_memory.c \
+src/tests/xpost_test_save.c \
 src/tests/xpost_test_stack.c
 
 src_tests_xpost_suite_CPPFLAGS = \
@@ -48,7 +48,9 @@ typedef struct
 
 static const Xpost_Test_Case _tests[] = {
     { "Main", xpost_test_main },
+    { "Dict", xpost_test_dict },
     { "Memory", xpost_test_memory },
+    { "Save", xpost_test_save },
     { "Stack", xpost_test_stack },
     { NULL, NULL }
 };
@@ -32,8 +32,10 @@
 #ifndef XPOST_SUITE_H_
 #define XPOST_SUITE_H_
 
+void xpost_test_dict(TCase *tc);
 void xpost_test_main(TCase *tc);
 void xpost_test_memory(TCase *tc);
+void xpost_test_save(TCase *tc);
 void xpost_test_stack(TCase *tc);
 
 #endif
@@ -0,0 +1,87 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * Copyright (C) 2013-2016, Vincent Torri
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <check.h>
+
+#include "xpost.h"
+#include "xpost_memory.h"
+#include "xpost_object.h"
+#include "xpost_context.h"
+#include "xpost_dict.h"
+#include "xpost_name.h"
+#include "xpost_op_dict.h"
+
+#include "xpost_suite.h"
+
+START_TEST(xpost_dict_operators_bound)
+{
+    static const char *ops[] = {
+        "add", "dup", "exch", "pop", "if", "ifelse", "for", "repeat",
+        "def", "load", "get", "put", "index", "roll", "moveto", "lineto"
+    };
+    Xpost_Context *ctx;
+    Xpost_Object k, v;
+    unsigned int i;
+
+    xpost_init();
+
+    ctx = xpost_create("null", XPOST_OUTPUT_DEFAULT, NULL,
+                       XPOST_SHOWPAGE_DEFAULT, XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_IGNORE_SIZE, 0, 0);
+    ck_assert(ctx != NULL);
+
+    /* systemdict grows as the operators are installed: its names must not be
+       taken for keys of another dict */
+    for (i = 0; i < sizeof ops / sizeof *ops; i++)
+    {
+        k = xpost_name_cons(ctx, ops[i]);
+        ck_assert(k.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK);
+        ck_assert(k.mark_.padw < ctx->gl->name_bindings_max);
+        ck_assert(ctx->gl->name_bindings[k.mark_.padw]
+                  != XPOST_DICT_NAME_SHADOWED);
+        ck_assert_int_eq(xpost_op_dict_stack_lookup(ctx, k, &v), 1);
+        ck_assert(ctx->gl->name_bindings[k.mark_.padw]
+                  != XPOST_DICT_NAME_SHADOWED);
+    }
+
+    xpost_destroy(ctx);
+    xpost_quit();
+}
+END_TEST
+
+void xpost_test_dict(TCase *tc)
+{
+    tcase_add_test(tc, xpost_dict_operators_bound);
+}
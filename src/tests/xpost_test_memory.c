@@ -41,6 +41,7 @@
 #include "xpost.h"
 #include "xpost_log.h"
 #include "xpost_memory.h"
+#include "xpost_free.h"
 
 #include "xpost_suite.h"
 
@@ -187,6 +188,172 @@ START_TEST(xpost_memory_tab_alloc)
 }
 END_TEST
 
+static int
+_xpost_test_memory_initializing(void)
+{
+    return 1;
+}
+
+START_TEST(xpost_memory_free_bins)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned int small, large, ent;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL,
+                                 _xpost_test_memory_initializing, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_free_init(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    ret = xpost_memory_table_alloc(&mem, 24, 0, &small);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_alloc(&mem, 4000, 0, &large);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_free_memory_ent(&mem, small), 24);
+    ck_assert_int_eq (xpost_free_memory_ent(&mem, large), 4000);
+
+    /* a slightly smaller request is satisfied from the same bin */
+    ret = xpost_memory_table_alloc(&mem, 20, 0, &ent);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (ent, small);
+
+    /* a much smaller large request must not take the big block */
+    ret = xpost_memory_table_alloc(&mem, 2000, 0, &ent);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(ent != large);
+    ret = xpost_memory_table_alloc(&mem, 3000, 0, &ent);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (ent, large);
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* read a link from the storage of the free list */
+static unsigned int
+_xpost_test_memory_link(Xpost_Memory_File *mem, unsigned int adr)
+{
+    unsigned int link;
+    memcpy(&link, mem->base + adr, sizeof link);
+    return link;
+}
+
+START_TEST(xpost_memory_free_tree_same_size)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned int ents[1000];
+    unsigned int n = sizeof ents / sizeof ents[0];
+    unsigned int ent;
+    unsigned int adr;
+    unsigned int root;
+    unsigned int len;
+    unsigned int i;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL,
+                                 _xpost_test_memory_initializing, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_free_init(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    for (i = 0; i < n; i++)
+    {
+        ret = xpost_memory_table_alloc(&mem, 2000, 0, &ents[i]);
+        ck_assert_int_eq (ret, 1);
+    }
+    for (i = 0; i < n; i++)
+        ck_assert_int_eq (xpost_free_memory_ent(&mem, ents[i]), 2000);
+
+    /* they all hang off one node of the tree */
+    ret = xpost_memory_table_get_addr(&mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &adr);
+    ck_assert_int_eq (ret, 1);
+    root = _xpost_test_memory_link(&mem, adr + XPOST_FREE_TREE * sizeof(unsigned int));
+    ck_assert(root != 0);
+    ret = xpost_memory_table_get_addr(&mem, root, &adr);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (_xpost_test_memory_link(&mem, adr + XPOST_FREE_TREE_LEFT), 0);
+    ck_assert_int_eq (_xpost_test_memory_link(&mem, adr + XPOST_FREE_TREE_RIGHT), 0);
+    for (len = 0, ent = root; ent; len++)
+    {
+        ret = xpost_memory_table_get_addr(&mem, ent, &adr);
+        ck_assert_int_eq (ret, 1);
+        ent = _xpost_test_memory_link(&mem, adr + XPOST_FREE_TREE_SAME);
+    }
+    ck_assert_int_eq (len, n);
+
+    /* every one of them is an exact fit */
+    for (i = 0; i < n; i++)
+    {
+        ret = xpost_memory_table_alloc(&mem, 2000, 0, &ent);
+        ck_assert_int_eq (ret, 1);
+        ck_assert(ent >= ents[0] && ent <= ents[n - 1]);
+    }
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_memory_stats)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned int small, ent;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL,
+                                 _xpost_test_memory_initializing, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_free_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    memset(&mem.stats, 0, sizeof mem.stats);
+
+    ret = xpost_memory_table_alloc(&mem, 24, 5, &small);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_alloc(&mem, 40, 16, &ent);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_free_memory_ent(&mem, small), 24);
+    ret = xpost_memory_table_alloc(&mem, 20, 5, &ent);
+    ck_assert_int_eq (ret, 1);
+    /* an unknown tag is counted with tag 0 */
+    ret = xpost_memory_table_alloc(&mem, 8, 1000, &ent);
+    ck_assert_int_eq (ret, 1);
+
+    ck_assert_int_eq (mem.stats.allocs[5], 2);
+    ck_assert_int_eq (mem.stats.bytes[5], 44);
+    ck_assert_int_eq (mem.stats.allocs[16], 1);
+    ck_assert_int_eq (mem.stats.allocs[0], 1);
+    ck_assert_int_eq (mem.stats.free_list_hits, 1);
+    ck_assert_int_eq (mem.stats.free_list_misses, 3);
+
+    ret = xpost_memory_file_grow(&mem, 4096);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (mem.stats.grows, 1);
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
 void xpost_test_memory(TCase *tc)
 {
     tcase_add_test(tc, xpost_memory_init_simple);
@@ -195,4 +362,7 @@ void xpost_test_memory(TCase *tc)
     tcase_add_test(tc, xpost_memory_grow);
     tcase_add_test(tc, xpost_memory_tab_init);
     tcase_add_test(tc, xpost_memory_tab_alloc);
+    tcase_add_test(tc, xpost_memory_free_bins);
+    tcase_add_test(tc, xpost_memory_free_tree_same_size);
+    tcase_add_test(tc, xpost_memory_stats);
 }
@@ -0,0 +1,100 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * Copyright (C) 2013-2016, Vincent Torri
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <check.h>
+
+#include "xpost.h"
+
+#include "xpost_suite.h"
+
+#define XPOST_TEST_SAVE_PPM "xpost_test_save.ppm"
+
+/* draw a page inside save/restore, as groff's /EP{level0 restore showpage}
+   does, and count the dark samples of the page the ppm device writes */
+static long
+_xpost_test_save_dark_samples(void)
+{
+    static const char *prog =
+        "/level0 save def "
+        "newpath 10 10 moveto 50 30 lineto stroke "
+        "level0 restore showpage";
+    Xpost_Context *ctx;
+    FILE *f;
+    char magic[3];
+    int width, height, max, v;
+    long dark;
+
+    remove(XPOST_TEST_SAVE_PPM);
+    ctx = xpost_create("ppm", XPOST_OUTPUT_FILENAME, XPOST_TEST_SAVE_PPM,
+                       XPOST_SHOWPAGE_RETURN, XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_USE_SIZE, 60, 40);
+    ck_assert(ctx != NULL);
+    xpost_run(ctx, XPOST_INPUT_STRING, prog, strlen(prog));
+    xpost_destroy(ctx);
+
+    f = fopen(XPOST_TEST_SAVE_PPM, "r");
+    ck_assert(f != NULL);
+    ck_assert_int_eq(fscanf(f, "%2s %d %d %d", magic, &width, &height, &max), 4);
+    ck_assert_str_eq(magic, "P3");
+    ck_assert_int_eq(width, 60);
+    ck_assert_int_eq(height, 40);
+    dark = 0;
+    while (fscanf(f, "%d", &v) == 1)
+        if (v < max / 2)
+            dark++;
+    fclose(f);
+    remove(XPOST_TEST_SAVE_PPM);
+
+    return dark;
+}
+
+START_TEST(xpost_save_restore_keeps_page)
+{
+    xpost_init();
+
+    /* the page is not part of vm: restore must not erase it */
+    ck_assert(_xpost_test_save_dark_samples() > 0);
+
+    xpost_quit();
+}
+END_TEST
+
+void xpost_test_save(TCase *tc)
+{
+    tcase_add_test(tc, xpost_save_restore_keeps_page);
+}
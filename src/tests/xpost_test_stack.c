@@ -34,6 +34,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h> /* malloc free */
 
 #include <check.h>
 
@@ -42,6 +43,7 @@
 #include "xpost_memory.h"
 #include "xpost_object.h"
 #include "xpost_stack.h"
+#include "xpost_free.h"
 
 #include "xpost_suite.h"
 
@@ -69,11 +71,17 @@ START_TEST(xpost_stack)
 }
 END_TEST
 
+static int
+_xpost_test_stack_initializing(void)
+{
+    return 1;
+}
+
 START_TEST(xpost_stack_push_pop)
 {
     Xpost_Memory_File mem;
     unsigned int stack;
-    int segsize = XPOST_STACK_SEGMENT_SIZE;
+    int size = XPOST_STACK_INITIAL_SIZE;
     int i;
     Xpost_Object obj;
     int ret;
@@ -81,20 +89,32 @@ START_TEST(xpost_stack_push_pop)
     xpost_init();
 
     memset(&mem, 0, sizeof(Xpost_Memory_File));
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL,
+                                 _xpost_test_stack_initializing, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
+    /* growing the stack frees the old array */
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_free_init(&mem);
+    ck_assert_int_eq (ret, 1);
 
     ret = xpost_stack_init(&mem, &stack);
     ck_assert_int_eq (ret, 1);
 
-    for (i = 0; i < 5 + segsize; i++)
+    for (i = 0; i < 5 + 2 * size; i++)
     {
         ret = xpost_stack_push(&mem, stack, xpost_int_cons(i));
         XPOST_LOG_INFO("test push integer %d", i);
         ck_assert_int_eq (ret, 1);
     }
 
+    ck_assert_int_eq (xpost_stack_count(&mem, stack), 5 + 2 * size);
+    obj = xpost_stack_topdown_fetch(&mem, stack, 5 + size);
+    ck_assert_int_eq (obj.int_.val, size - 1);
+    obj = xpost_stack_bottomup_fetch(&mem, stack, size + 1);
+    ck_assert_int_eq (obj.int_.val, size + 1);
+
     for (i--; i >= 0; i--)
     {
         obj = xpost_stack_pop(&mem, stack);
@@ -111,8 +131,87 @@ START_TEST(xpost_stack_push_pop)
 }
 END_TEST
 
+START_TEST(xpost_stack_n_ary)
+{
+    Xpost_Memory_File mem;
+    unsigned int stack;
+    int size = XPOST_STACK_INITIAL_SIZE;
+    Xpost_Object objs[5];
+    Xpost_Object *big;
+    int i;
+    int ret;
+
+    xpost_init();
+
+    memset(&mem, 0, sizeof(Xpost_Memory_File));
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL,
+                                 _xpost_test_stack_initializing, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_free_init(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    ret = xpost_stack_init(&mem, &stack);
+    ck_assert_int_eq (ret, 1);
+
+    /* a push past several doublings at once */
+    big = malloc(3 * size * sizeof *big);
+    ck_assert(big != NULL);
+    for (i = 0; i < 3 * size; i++)
+        big[i] = xpost_int_cons(i);
+    ret = xpost_stack_push_n(&mem, stack, big, 3 * size);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_count(&mem, stack), 3 * size);
+    ck_assert_int_eq (xpost_stack_bottomup_fetch(&mem, stack, 2 * size).int_.val, 2 * size);
+    free(big);
+    xpost_stack_clear(&mem, stack);
+
+    for (i = 0; i < 5; i++)
+        objs[i] = xpost_int_cons(i + 1);
+    ret = xpost_stack_push_n(&mem, stack, objs, 5);
+    ck_assert_int_eq (ret, 1);
+
+    /* 1 2 3 4 5  5 2 roll  ->  4 5 1 2 3 */
+    ret = xpost_stack_roll(&mem, stack, 5, 2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_bottomup_fetch(&mem, stack, 0).int_.val, 4);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 0).int_.val, 3);
+
+    /* 4 5 1 2 3  5 -2 roll  ->  1 2 3 4 5 */
+    ret = xpost_stack_roll(&mem, stack, 5, -2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_bottomup_fetch(&mem, stack, 0).int_.val, 1);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 0).int_.val, 5);
+    ret = xpost_stack_roll(&mem, stack, 6, 1);
+    ck_assert_int_eq (ret, 0);
+
+    ret = xpost_stack_copy(&mem, stack, 2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_count(&mem, stack), 7);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 1).int_.val, 4);
+
+    ret = xpost_stack_pop_n(&mem, stack, objs, 3);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (objs[0].int_.val, 5);
+    ck_assert_int_eq (objs[1].int_.val, 4);
+    ck_assert_int_eq (objs[2].int_.val, 5);
+    ret = xpost_stack_pop_n(&mem, stack, NULL, 5);
+    ck_assert_int_eq (ret, 0);
+    ret = xpost_stack_pop_n(&mem, stack, NULL, 4);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_count(&mem, stack), 0);
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
 void xpost_test_stack(TCase *tc)
 {
     tcase_add_test(tc, xpost_stack);
     tcase_add_test(tc, xpost_stack_push_pop);
+    tcase_add_test(tc, xpost_stack_n_ary);
 }